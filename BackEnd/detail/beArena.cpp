@@ -0,0 +1,60 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beArena.h"
+#include "beConsts.h"
+
+namespace be
+{
+
+void KArena::reset()
+{
+	d_blocks.clear();
+	d_current = nullptr;
+	d_available = 0;
+	d_nextBlockSize = 0;
+	d_size = 0;
+}
+
+std::size_t KArena::getSize() const
+{
+	return d_size;
+}
+
+void* KArena::allocate(
+	const std::size_t size,
+	const std::size_t alignment )
+{
+	std::size_t padding = reinterpret_cast< std::uintptr_t >( d_current ) % alignment;
+	if ( padding != 0 )
+		padding = alignment - padding;
+
+	if ( d_available < padding + size )
+	{
+		// new blocks are aligned for any type
+		addBlock( size );
+		padding = 0;
+	}
+
+	char* result = d_current + padding;
+	d_current = result + size;
+	d_available -= padding + size;
+	return result;
+}
+
+// the blocks grow, so the number of allocations is logarithmic in the size
+// of the indexes
+void KArena::addBlock( const std::size_t minSize )
+{
+	if ( d_nextBlockSize == 0 )
+		d_nextBlockSize = consts::ArenaInitialBlockSize;
+
+	const std::size_t blockSize = std::max( d_nextBlockSize, minSize );
+	d_blocks.emplace_back( new char[ blockSize ] );
+	d_current = d_blocks.back().get();
+	d_available = blockSize;
+	d_size += blockSize;
+
+	d_nextBlockSize = std::min( d_nextBlockSize * 2, consts::ArenaMaxBlockSize );
+}
+
+} // namespace be
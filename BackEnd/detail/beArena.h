@@ -0,0 +1,64 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_BE_ARENA_H
+#define INC_BE_ARENA_H
+
+#include <type_traits>
+
+namespace be
+{
+
+/*
+	monotonic arena owning the nodes of the spatial indexes of a document,
+	the memory is taken in a few large blocks and released all at once, so
+	building the trees doesn't hit the heap per node and dropping them
+	costs nothing
+
+	the destructors of the objects are never called, so only trivially
+	destructible types may be created in the arena
+*/
+class KArena
+{
+	public:
+		KArena() = default;
+		KArena( const KArena& ) = delete;
+		KArena& operator=( const KArena& ) = delete;
+
+	public:
+		template< typename T, typename... Args >
+		T* create( Args&&... args );
+
+		// releases all the objects at once
+		void reset();
+
+		// bytes of all the blocks, including their unused tails
+		std::size_t getSize() const;
+
+	private:
+		void* allocate(
+			std::size_t size,
+			std::size_t alignment );
+		void addBlock( std::size_t minSize );
+
+	private:
+		std::vector< std::unique_ptr< char[] > > d_blocks;
+		char* d_current = nullptr;
+		std::size_t d_available = 0;
+		std::size_t d_nextBlockSize = 0;
+		std::size_t d_size = 0;
+
+};
+
+// ----------------------------------------------------------------------------
+
+template< typename T, typename... Args >
+T* KArena::create( Args&&... args )
+{
+	static_assert( std::is_trivially_destructible< T >::value, "arena never calls destructors" );
+	void* memory = allocate( sizeof( T ), alignof( T ) );
+	T* result = new ( memory ) T( std::forward< Args >( args )... );
+	return result;
+}
+
+} // namespace be
+
+#endif
@@ -10,4 +10,25 @@
 // #define BRUTE_FORCE_SELECT_SECTIONS_CHECKER
 #endif
 
+// points stored as 16-bit offsets within fixed tiles (vide STiledPoint),
+// it saves a quarter of the geometry memory for the cost of decoding the
+// points on the fly, but the coords of the map are limited
+// #define ENABLE_TILED_POINTS
+
+// vectorized decoders of the delta encoded maps (vide beDeltaCodec.cpp),
+// NEON is a part of all the 64-bit ARMs, the other targets (e.g. 32-bit ARM
+// of Android) use the portable one
+#if defined( __SSSE3__ ) || ( defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) ) )
+#define ENABLE_SSSE3_DELTA_DECODER
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+#define ENABLE_NEON_DELTA_DECODER
+#endif
+
+// streams of compressed maps (vide IMapStream::createCompressed) need zlib,
+// it is a part of NDK, on other targets it has to be added to the project
+// before the macro is defined
+#ifdef ANDROID
+#define ENABLE_COMPRESSED_MAP_STREAM
+#endif
+
 #endif
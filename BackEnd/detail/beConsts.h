@@ -40,19 +40,21 @@ const coord_t OutlineDefaultThickness = 1;
 
 const int MaxRoadClassIndex = 7;
 
-const std::size_t BitsForSegmentId = 16;
-const std::size_t MaxSegmentId = ( 1 << BitsForSegmentId ) - 1;
+/*
+	the ids are just the positions in the arrays, so neither the number of
+	segments nor the number of points in a segment is limited, only the
+	total number of points is (vide MaxPointsCount)
+*/
 
-const std::size_t BitsForSectionId = section_id_t::size_of() * 8 - BitsForSegmentId;
-const std::size_t MaxSectionId = ( std::size_t(1) << BitsForSectionId ) - 1;
+/*
+	section_id_t
+	31-00 - index of the beginning point of section in SSegments::d_points
+*/
 
 /*
 	point_pos_id_t
-	31-16 - segment id
-	15-00 - point id
+	31-00 - index of the point in SSegments::d_points
 */
-const std::size_t BitsForPointPosId = point_pos_id_t::size_of() * 8 - BitsForSegmentId;
-const std::size_t MaxPointPosId = ( std::size_t(1) << BitsForPointPosId ) - 1;
 
 /*
 	sect_pos_id_t
@@ -65,8 +67,41 @@ const std::size_t BitsForIsBeginOrEndOfSectionFlag = 1;
 const std::size_t BitsForIntervalSectionId = section_id_t::size_of() * 8 - BitsForIsBeginOrEndOfSectionFlag;
 const std::size_t MaxIntervalSectionId = ( std::size_t(1) << BitsForIntervalSectionId ) - 1U;
 
+// limit of the map checked while reading it (vide KMapReader), each section
+// makes up to four interval sections (vide KIntervalSectionsCreator), so it
+// is about 512M points
+const std::size_t MaxIntervalSectionsPerSection = 4;
+const std::size_t MaxPointsCount = MaxIntervalSectionId / MaxIntervalSectionsPerSection;
+
 const coord_t MaxSectionLength = MaxCoord >> 2;
 
+/*
+	indexed map file (version 2) starts with the negative magic number, so
+	it can't be mistaken for the number of segments of the plain map file
+*/
+const int IndexedMapMagic = -0x324D4D41;
+const int IndexedMapVersion = 2;
+
+// flags of the indexed map file
+const int IndexedMapDeltaEncoding = 1; // points are delta encoded (vide beDeltaCodec.h)
+
+// the segments of the map kept in memory are parsed in parallel, but each
+// thread gets at least as many of them
+const std::size_t MinSegmentsPerLoadingThread = 16 * 1024;
+
+// number of the most important road classes indexed before the rest in case
+// the map is loaded progressively (vide SInstance::initAsync)
+const std::size_t MajorRoadClassesCount = 1;
+
+// image of the spatial indexes persisted next to the map (vide beIndexImage.h)
+const int IndexImageMagic = -0x58444941;
+const int IndexImageVersion = 4;
+
+// blocks of the arena holding the nodes of the spatial indexes (vide KArena),
+// they double up to the max size
+const std::size_t ArenaInitialBlockSize = 64 * 1024;
+const std::size_t ArenaMaxBlockSize = 16 * 1024 * 1024;
+
 // ----------------------------------------------------------------------------
 // colors
 
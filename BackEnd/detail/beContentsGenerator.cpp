@@ -104,11 +104,14 @@ int calcRoadClassFilter( const SContentsGeneratorData* generatorData )
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
+// the pixels are kept in the buffer of the caller (vide SContentsGeneratorBuffers)
 class KPixelArray
 {
 	public:
-		KPixelArray( const SSize& deviceSize, color_t bkColor );
-		~KPixelArray();
+		KPixelArray(
+			const SSize& deviceSize,
+			color_t bkColor,
+			std::vector< color_t >* pixels );
 
 	public:
 		void putPixel( coord_t x, coord_t y );
@@ -145,24 +148,24 @@ class KPixelArray
 
 KPixelArray::KPixelArray(
 	const SSize& deviceSize,
-	const color_t bkColor )
+	const color_t bkColor,
+	std::vector< color_t >* pixels )
 	: d_deviceRows( deviceSize.height )
 	, d_deviceColumns( deviceSize.width )
 	, d_deviceRowShift( calcRowShift( d_deviceColumns ) )
 	, d_alignedColumns( 1 << d_deviceRowShift )
-	, d_pixels( new color_t[ d_deviceRows * d_alignedColumns ] )
+	, d_pixels( nullptr )
 	, d_bkColor( bkColor )
 	, d_color( 0 )
 	, d_outlineColor( 0 )
 {
 	assert( d_deviceRowShift < ( sizeof( d_deviceRows ) * 8 ) );
 	assert( d_deviceColumns <= d_alignedColumns );
-	memset( d_pixels, 0, d_deviceRows * d_alignedColumns * sizeof( color_t ) );
-}
-
-KPixelArray::~KPixelArray()
-{
-	delete[] d_pixels;
+	// it grows only when the device does
+	const std::size_t pixelsCount = d_deviceRows * d_alignedColumns;
+	pixels->resize( pixelsCount );
+	d_pixels = pixels->data();
+	memset( d_pixels, 0, pixelsCount * sizeof( color_t ) );
 }
 
 // ----------------------------------------------------------------------------
@@ -263,7 +266,8 @@ class KPainter
 		KPainter(
 			const SSize& deviceSize,
 			const SSize& screenSize,
-			color_t bkColor );
+			color_t bkColor,
+			std::vector< color_t >* pixels );
 
 	public:
 		void dump( IBitmap* bitmap );
@@ -393,10 +397,11 @@ orientations2junction_t KPainter::s_orientations2junction;
 KPainter::KPainter(
 	const SSize& deviceSize,
 	const SSize& screenSize,
-	const color_t bkColor )
+	const color_t bkColor,
+	std::vector< color_t >* pixels )
 	: d_screenWidth( screenSize.width )
 	, d_screenHeight( screenSize.height )
-	, d_pixelArray( deviceSize, bkColor )
+	, d_pixelArray( deviceSize, bkColor, pixels )
 	, d_x0( 0 )
 	, d_y0( 0 )
 	, d_x1( 0 )
@@ -1333,11 +1338,12 @@ class KContentsGenerator
 {
 	public:
 		explicit KContentsGenerator( SContentsGeneratorData* generatorData );
-		~KContentsGenerator();
 
 	private:
-		void prepareRoadClasses( const road_classes_t& baseRoadClasses );
-		SRoadClass* prepareRoadClass( const SRoadClass* baseRoadClass ) const;
+		void prepareRoadClasses(
+			const road_classes_t& baseRoadClasses,
+			SContentsGeneratorBuffers* buffers ) const;
+		SRoadClass prepareRoadClass( const SRoadClass& baseRoadClass ) const;
 		coord_t prepareRoadClassThickness( coord_t defaultThickness ) const;
 		coord_t prepareRoadClassOutlineThickness( coord_t defaultThickness ) const;
 
@@ -1387,7 +1393,7 @@ class KContentsGenerator
 		const SRect d_clipScreenRect;
 		const int d_zoomFactor;
 		const bool d_isZoomIn;
-		road_classes_t d_roadClasses;
+		const road_classes_t& d_roadClasses;
 		const int d_roadClassFilter;
 		KPainter d_painter;
 
@@ -1410,60 +1416,65 @@ KContentsGenerator::KContentsGenerator( SContentsGeneratorData* generatorData )
 	, d_clipScreenRect( prepareClipScreenRect( generatorData ) )
 	, d_zoomFactor( generatorData->d_viewData.d_zoomFactor )
 	, d_isZoomIn( d_zoomFactor < 0 )
+	, d_roadClasses( generatorData->d_buffers->d_roadClasses )
 	, d_roadClassFilter( calcRoadClassFilter( generatorData ) )
 	, d_painter(
 		generatorData->d_viewData.d_deviceSize,
 		generatorData->d_viewData.d_screenSize,
-		consts::BackgroundColor )
+		consts::BackgroundColor,
+		&generatorData->d_buffers->d_pixels )
 	, d_roadClass(nullptr )
 	, d_orientation( UnknownOrientation )
 {
 	const IInternalDocument& document = generatorData->d_document;
 	const road_classes_t& baseRoadClasses = document.getBaseRoadClasses();
-	prepareRoadClasses( baseRoadClasses );
-}
-
-KContentsGenerator::~KContentsGenerator()
-{
-	utils::delete_container( d_roadClasses.begin(), d_roadClasses.end() );
+	prepareRoadClasses( baseRoadClasses, generatorData->d_buffers );
 }
 
 void KContentsGenerator::prepareRoadClasses(
-	const road_classes_t& baseRoadClasses )
+	const road_classes_t& baseRoadClasses,
+	SContentsGeneratorBuffers* buffers ) const
 {
+	// reserved up front, so the pointers to the values stay valid
+	std::vector< SRoadClass >& roadClassValues = buffers->d_roadClassValues;
+	roadClassValues.clear();
+	roadClassValues.reserve( baseRoadClasses.size() );
+
+	road_classes_t& roadClasses = buffers->d_roadClasses;
+	roadClasses.clear();
 	for ( const SRoadClass* baseRoadClass : baseRoadClasses )
 	{
-		SRoadClass* roadClass = prepareRoadClass( baseRoadClass );
-		d_roadClasses.push_back( roadClass );
+		SRoadClass* roadClass = nullptr;
+		if ( baseRoadClass != nullptr )
+		{
+			roadClassValues.push_back( prepareRoadClass( *baseRoadClass ) );
+			roadClass = &roadClassValues.back();
+		}
+		roadClasses.push_back( roadClass );
 	}
 }
 
-SRoadClass* KContentsGenerator::prepareRoadClass(
-	const SRoadClass* baseRoadClass ) const
+SRoadClass KContentsGenerator::prepareRoadClass(
+	const SRoadClass& baseRoadClass ) const
 {
-	SRoadClass* roadClass = nullptr;
-	if ( baseRoadClass != nullptr )
+	const coord_t thickness
+		= prepareRoadClassThickness( baseRoadClass.d_thickness );
+	const coord_t outlineThickness
+		= prepareRoadClassOutlineThickness( baseRoadClass.d_outlineThickness );
+	if ( 0 < outlineThickness )
 	{
-		const coord_t thickness
-			= prepareRoadClassThickness( baseRoadClass->d_thickness );
-		const coord_t outlineThickness
-			= prepareRoadClassOutlineThickness( baseRoadClass->d_outlineThickness );
-		if ( 0 < outlineThickness )
-		{
-			roadClass = new SRoadClass(
-				thickness,
-				baseRoadClass->d_color,
-				outlineThickness,
-				baseRoadClass->d_outlineColor );
-		}
-		else
-		{
-			roadClass = new SRoadClass(
-				thickness,
-				baseRoadClass->d_color );
-		}
+		return SRoadClass(
+			thickness,
+			baseRoadClass.d_color,
+			outlineThickness,
+			baseRoadClass.d_outlineColor );
+	}
+	else
+	{
+		return SRoadClass(
+			thickness,
+			baseRoadClass.d_color );
 	}
-	return roadClass;
 }
 
 coord_t KContentsGenerator::prepareRoadClassThickness( coord_t defaultThickness ) const
@@ -1647,18 +1658,18 @@ bool KContentsGenerator::postZoomStep()
 
 void KContentsGenerator::initScreenPoints()
 {
-	const SPoint* begin = d_section.d_begin;
-	const SPoint* end = d_section.d_end;
+	const SPoint& begin = d_section.d_begin;
+	const SPoint& end = d_section.d_end;
 
-	if ( isSectionNormalized( *begin, *end ) )
+	if ( isSectionNormalized( begin, end ) )
 	{
-		d_begin = *begin;
-		d_end = *end;
+		d_begin = begin;
+		d_end = end;
 	}
 	else
 	{
-		d_begin = *end;
-		d_end = *begin;
+		d_begin = end;
+		d_end = begin;
 	}
 
 	assert( isSectionNormalized( d_begin, d_end ) );
@@ -1776,11 +1787,13 @@ SContentsGeneratorData::SContentsGeneratorData(
 	const SViewData& viewData,
 	const SRect& viewportRect,
 	const section_ids_t& sectionids,
+	SContentsGeneratorBuffers* buffers,
 	IBitmap* bitmap )
 	: d_document( document )
 	, d_viewData( viewData )
 	, d_viewportRect( viewportRect )
 	, d_sections( sectionids )
+	, d_buffers( buffers )
 	, d_bitmap( bitmap )
 {
 }
@@ -10,6 +10,16 @@ namespace be
 struct IInternalDocument;
 struct IBitmap;
 
+// reused by the frames like SSelectionBuffers
+struct SContentsGeneratorBuffers
+{
+	std::vector< color_t > d_pixels;
+	// the road classes adjusted to the zoom factor, the base ones missing
+	// in the map are null
+	std::vector< SRoadClass > d_roadClassValues;
+	road_classes_t d_roadClasses;
+};
+
 struct SContentsGeneratorData
 {
 	SContentsGeneratorData(
@@ -17,12 +27,14 @@ struct SContentsGeneratorData
 		const SViewData& viewData,
 		const SRect& viewportRect,
 		const section_ids_t& sectionids,
+		SContentsGeneratorBuffers* buffers,
 		IBitmap* bitmap );
 
 	const IInternalDocument& d_document;
 	const SViewData& d_viewData;
 	const SRect& d_viewportRect;
 	const section_ids_t& d_sections;
+	SContentsGeneratorBuffers* d_buffers;
 	IBitmap* d_bitmap;
 };
 
@@ -54,6 +54,7 @@ class KController : public IController
 		bool resetView() override;
 
 		bool generateContents( IBitmap* bitmap ) override;
+		bool isLoading() const override;
 
 		std::string getParamsDescription() const override;
 
@@ -128,6 +129,10 @@ class KController : public IController
 
 	private:
 		IInternalDocument* d_document;
+		// reused by the frames, so a frame of a view similar to the
+		// previous ones doesn't allocate
+		SSelectionBuffers d_selectionBuffers;
+		SContentsGeneratorBuffers d_generatorBuffers;
 
 };
 
@@ -277,17 +282,26 @@ bool KController::generateContents( IBitmap* bitmap )
 {
 	bool result = false;
 
+	// the contents loaded in the background meanwhile
+	d_document->updateContents();
+
 	const SViewData& viewData = d_document->getViewData();
 	if ( canGenerateContents( viewData ) )
 	{
 		const SRect& viewportRect = calcViewportRect( viewData );
-		section_ids_t sectionids;
-		if ( d_document->selectSections( viewportRect, &sectionids ) )
+		if ( d_document->selectSections( viewportRect, &d_selectionBuffers ) )
 		{
+			const section_ids_t& sectionids = d_selectionBuffers.d_sections;
 			#ifdef ENABLE_LOGGING
 			diag::dumpSections( d_document, sectionids );
 			#endif
-			SContentsGeneratorData generatorData( *d_document, viewData, viewportRect, sectionids, bitmap );
+			SContentsGeneratorData generatorData(
+				*d_document,
+				viewData,
+				viewportRect,
+				sectionids,
+				&d_generatorBuffers,
+				bitmap );
 			result = be::generateViewContents( &generatorData );
 		}
 	}
@@ -295,6 +309,12 @@ bool KController::generateContents( IBitmap* bitmap )
 	return result;
 }
 
+bool KController::isLoading() const
+{
+	const bool result = d_document->isLoading();
+	return result;
+}
+
 std::string KController::getParamsDescription() const
 {
 	const SViewData& viewData = d_document->getViewData();
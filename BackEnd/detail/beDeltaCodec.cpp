@@ -0,0 +1,487 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beDeltaCodec.h"
+#include "beConfig.h"
+
+#ifdef ENABLE_SSSE3_DELTA_DECODER
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef ENABLE_NEON_DELTA_DECODER
+#include <arm_neon.h>
+#endif
+
+namespace be
+{
+
+namespace delta_codec
+{
+
+namespace
+{
+
+const std::size_t GroupSize = 4;
+
+// tag byte + from one to four bytes per value
+const std::size_t MinGroupBytes = 1 + GroupSize;
+const std::size_t MaxGroupBytes = 1 + GroupSize * sizeof( std::uint32_t );
+
+void throwMalformedData()
+{
+	throw std::runtime_error( "malformed delta encoded points" );
+}
+
+std::size_t calcGroupsCount( const std::size_t pointsCount )
+{
+	const std::size_t valuesCount = 2 * pointsCount;
+	const std::size_t result = ( valuesCount + GroupSize - 1 ) / GroupSize;
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+inline std::uint32_t zigzagEncode( const std::uint32_t value )
+{
+	const std::uint32_t sign = ( value & 0x80000000U ) ? 0xFFFFFFFFU : 0U;
+	const std::uint32_t result = ( value << 1 ) ^ sign;
+	return result;
+}
+
+inline std::uint32_t zigzagDecode( const std::uint32_t value )
+{
+	const std::uint32_t result = ( value >> 1 ) ^ ( 0U - ( value & 1U ) );
+	return result;
+}
+
+std::size_t calcValueBytes( const std::uint32_t value )
+{
+	std::size_t result = 1;
+	if ( 0xFFU < value )
+		++result;
+	if ( 0xFFFFU < value )
+		++result;
+	if ( 0xFFFFFFU < value )
+		++result;
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+class KEncoder
+{
+	public:
+		explicit KEncoder( bytes_t* output );
+
+	public:
+		void putPoint( const SPoint& point );
+		void flush();
+
+	private:
+		void putValue( std::uint32_t value );
+		void putGroup();
+
+	private:
+		bytes_t& d_output;
+		std::uint32_t d_group[ GroupSize ];
+		std::size_t d_groupSize;
+		std::uint32_t d_prevX;
+		std::uint32_t d_prevY;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KEncoder::KEncoder( bytes_t* output )
+	: d_output( *output )
+	, d_groupSize( 0 )
+	, d_prevX( 0 )
+	, d_prevY( 0 )
+{
+}
+
+void KEncoder::putPoint( const SPoint& point )
+{
+	// deltas are counted modulo 2^32, so they never overflow
+	const std::uint32_t x = static_cast< std::uint32_t >( point.x );
+	const std::uint32_t y = static_cast< std::uint32_t >( point.y );
+	putValue( zigzagEncode( x - d_prevX ) );
+	putValue( zigzagEncode( y - d_prevY ) );
+	d_prevX = x;
+	d_prevY = y;
+}
+
+void KEncoder::flush()
+{
+	if ( d_groupSize != 0 )
+	{
+		while ( d_groupSize != GroupSize )
+			d_group[ d_groupSize++ ] = 0;
+		putGroup();
+	}
+}
+
+void KEncoder::putValue( const std::uint32_t value )
+{
+	d_group[ d_groupSize++ ] = value;
+	if ( d_groupSize == GroupSize )
+		putGroup();
+}
+
+void KEncoder::putGroup()
+{
+	const std::size_t tagPos = d_output.size();
+	d_output.push_back( 0 );
+
+	unsigned tag = 0;
+	for ( std::size_t i = 0
+		; i < GroupSize
+		; ++i )
+	{
+		const std::uint32_t value = d_group[ i ];
+		const std::size_t valueBytes = calcValueBytes( value );
+		tag |= ( valueBytes - 1 ) << ( 2 * i );
+		for ( std::size_t j = 0
+			; j < valueBytes
+			; ++j )
+		{
+			d_output.push_back( static_cast< std::uint8_t >( value >> ( 8 * j ) ) );
+		}
+	}
+
+	d_output[ tagPos ] = static_cast< std::uint8_t >( tag );
+	d_groupSize = 0;
+}
+
+#if defined( ENABLE_SSSE3_DELTA_DECODER ) || defined( ENABLE_NEON_DELTA_DECODER )
+
+/*
+	for each tag there is a mask of bytes for _mm_shuffle_epi8 (or
+	vqtbl1q_u8) which moves the packed values into four 32-bit lanes (0x80
+	zeroes the byte), and the number of the packed bytes
+*/
+struct SGroupShuffles
+{
+	SGroupShuffles();
+
+	std::uint8_t d_masks[ 256 ][ 16 ];
+	std::uint8_t d_lengths[ 256 ];
+};
+
+SGroupShuffles::SGroupShuffles()
+{
+	for ( unsigned tag = 0
+		; tag < 256
+		; ++tag )
+	{
+		std::uint8_t* mask = d_masks[ tag ];
+		unsigned length = 0;
+		for ( unsigned i = 0
+			; i < GroupSize
+			; ++i )
+		{
+			const unsigned valueBytes = ( ( tag >> ( 2 * i ) ) & 3U ) + 1;
+			for ( unsigned j = 0
+				; j < sizeof( std::uint32_t )
+				; ++j )
+			{
+				mask[ 4 * i + j ] = static_cast< std::uint8_t >(
+					( j < valueBytes ) ? ( length + j ) : 0x80U );
+			}
+			length += valueBytes;
+		}
+		d_lengths[ tag ] = static_cast< std::uint8_t >( length );
+	}
+}
+
+const SGroupShuffles& getGroupShuffles()
+{
+	static const SGroupShuffles groupShuffles;
+	return groupShuffles;
+}
+
+#endif
+
+#ifdef ENABLE_SSSE3_DELTA_DECODER
+
+bool hasSsse3()
+{
+#ifdef __SSSE3__
+	return true;
+#else
+	int cpuInfo[ 4 ] = { 0 };
+	__cpuid( cpuInfo, 1 );
+	const bool result = ( cpuInfo[ 2 ] & ( 1 << 9 ) ) != 0;
+	return result;
+#endif
+}
+
+const bool Ssse3Supported = hasSsse3();
+
+#endif // ENABLE_SSSE3_DELTA_DECODER
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KDecoder
+{
+	public:
+		KDecoder(
+			const std::uint8_t* input,
+			std::size_t inputSize );
+
+	public:
+		std::size_t run(
+			std::size_t groupsCount,
+			int* coords );
+
+	private:
+		void decodeGroups( std::size_t groupsCount );
+#ifdef ENABLE_SSSE3_DELTA_DECODER
+		std::size_t decodeGroupsSsse3( std::size_t groupsCount );
+#endif
+#ifdef ENABLE_NEON_DELTA_DECODER
+		std::size_t decodeGroupsNeon( std::size_t groupsCount );
+#endif
+		void decodeGroup();
+		std::uint32_t getValue( std::size_t valueBytes );
+		void putCoord( std::uint32_t value, std::uint32_t* prevCoord );
+
+	private:
+		const std::uint8_t* const d_begin;
+		const std::uint8_t* const d_end;
+		const std::uint8_t* d_input;
+		int* d_coords;
+		std::uint32_t d_prevX;
+		std::uint32_t d_prevY;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KDecoder::KDecoder(
+	const std::uint8_t* input,
+	const std::size_t inputSize )
+	: d_begin( input )
+	, d_end( input + inputSize )
+	, d_input( input )
+	, d_coords( nullptr )
+	, d_prevX( 0 )
+	, d_prevY( 0 )
+{
+}
+
+std::size_t KDecoder::run(
+	const std::size_t groupsCount,
+	int* coords )
+{
+	d_coords = coords;
+	decodeGroups( groupsCount );
+	const std::size_t result = d_input - d_begin;
+	return result;
+}
+
+void KDecoder::decodeGroups( std::size_t groupsCount )
+{
+#ifdef ENABLE_SSSE3_DELTA_DECODER
+	groupsCount -= decodeGroupsSsse3( groupsCount );
+#endif
+#ifdef ENABLE_NEON_DELTA_DECODER
+	groupsCount -= decodeGroupsNeon( groupsCount );
+#endif
+
+	for ( std::size_t i = 0
+		; i < groupsCount
+		; ++i )
+	{
+		decodeGroup();
+	}
+}
+
+#ifdef ENABLE_SSSE3_DELTA_DECODER
+
+// returns the number of decoded groups, it reads whole 16 bytes after each
+// tag, so the last groups of the input are left for the scalar decoder
+std::size_t KDecoder::decodeGroupsSsse3( const std::size_t groupsCount )
+{
+	if ( !Ssse3Supported )
+		return 0;
+
+	const SGroupShuffles& shuffles = getGroupShuffles();
+	const __m128i one = _mm_set1_epi32( 1 );
+	const __m128i zero = _mm_setzero_si128();
+
+	// the lanes are (x1, y1, x2, y2), prev keeps the last point in both halves
+	__m128i prev = _mm_set_epi32(
+		static_cast< int >( d_prevY ),
+		static_cast< int >( d_prevX ),
+		static_cast< int >( d_prevY ),
+		static_cast< int >( d_prevX ) );
+	const std::uint8_t* input = d_input;
+	__m128i* coords = reinterpret_cast< __m128i* >( d_coords );
+	std::size_t result = 0;
+	for ( ; ( result < groupsCount )
+			&& ( MaxGroupBytes <= static_cast< std::size_t >( d_end - input ) )
+		; ++result )
+	{
+		const unsigned tag = *input++;
+		const __m128i packed = _mm_loadu_si128( reinterpret_cast< const __m128i* >( input ) );
+		const __m128i mask = _mm_loadu_si128( reinterpret_cast< const __m128i* >( shuffles.d_masks[ tag ] ) );
+		input += shuffles.d_lengths[ tag ];
+
+		const __m128i values = _mm_shuffle_epi8( packed, mask );
+		const __m128i deltas = _mm_xor_si128(
+			_mm_srli_epi32( values, 1 ),
+			_mm_sub_epi32( zero, _mm_and_si128( values, one ) ) );
+
+		// prefix sums of both points
+		__m128i points = _mm_add_epi32( deltas, _mm_slli_si128( deltas, 8 ) );
+		points = _mm_add_epi32( points, prev );
+		prev = _mm_shuffle_epi32( points, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		_mm_storeu_si128( coords++, points );
+	}
+
+	if ( result != 0 )
+	{
+		d_input = input;
+		d_coords = reinterpret_cast< int* >( coords );
+		d_prevX = static_cast< std::uint32_t >( d_coords[ -2 ] );
+		d_prevY = static_cast< std::uint32_t >( d_coords[ -1 ] );
+	}
+	return result;
+}
+
+#endif // ENABLE_SSSE3_DELTA_DECODER
+
+#ifdef ENABLE_NEON_DELTA_DECODER
+
+// the same as decodeGroupsSsse3, vqtbl1q_u8 zeroes the lanes of the
+// indexes out of range, like _mm_shuffle_epi8 does for 0x80
+std::size_t KDecoder::decodeGroupsNeon( const std::size_t groupsCount )
+{
+	const SGroupShuffles& shuffles = getGroupShuffles();
+	const uint32x4_t one = vdupq_n_u32( 1 );
+	const uint32x4_t zero = vdupq_n_u32( 0 );
+
+	// the lanes are (x1, y1, x2, y2), prev keeps the last point in both halves
+	const std::uint32_t prevPoint[ 4 ] = { d_prevX, d_prevY, d_prevX, d_prevY };
+	uint32x4_t prev = vld1q_u32( prevPoint );
+	const std::uint8_t* input = d_input;
+	std::uint32_t* coords = reinterpret_cast< std::uint32_t* >( d_coords );
+	std::size_t result = 0;
+	for ( ; ( result < groupsCount )
+			&& ( MaxGroupBytes <= static_cast< std::size_t >( d_end - input ) )
+		; ++result )
+	{
+		const unsigned tag = *input++;
+		const uint8x16_t packed = vld1q_u8( input );
+		const uint8x16_t mask = vld1q_u8( shuffles.d_masks[ tag ] );
+		input += shuffles.d_lengths[ tag ];
+
+		const uint32x4_t values = vreinterpretq_u32_u8( vqtbl1q_u8( packed, mask ) );
+		const uint32x4_t deltas = veorq_u32(
+			vshrq_n_u32( values, 1 ),
+			vsubq_u32( zero, vandq_u32( values, one ) ) );
+
+		// prefix sums of both points
+		uint32x4_t points = vaddq_u32( deltas, vextq_u32( zero, deltas, 2 ) );
+		points = vaddq_u32( points, prev );
+		prev = vcombine_u32( vget_high_u32( points ), vget_high_u32( points ) );
+		vst1q_u32( coords, points );
+		coords += GroupSize;
+	}
+
+	if ( result != 0 )
+	{
+		d_input = input;
+		d_coords = reinterpret_cast< int* >( coords );
+		d_prevX = static_cast< std::uint32_t >( d_coords[ -2 ] );
+		d_prevY = static_cast< std::uint32_t >( d_coords[ -1 ] );
+	}
+	return result;
+}
+
+#endif // ENABLE_NEON_DELTA_DECODER
+
+void KDecoder::decodeGroup()
+{
+	if ( d_input == d_end )
+		throwMalformedData();
+
+	const unsigned tag = *d_input++;
+	for ( std::size_t i = 0
+		; i < GroupSize
+		; i += 2 )
+	{
+		const std::size_t xBytes = ( ( tag >> ( 2 * i ) ) & 3U ) + 1;
+		putCoord( getValue( xBytes ), &d_prevX );
+		const std::size_t yBytes = ( ( tag >> ( 2 * i + 2 ) ) & 3U ) + 1;
+		putCoord( getValue( yBytes ), &d_prevY );
+	}
+}
+
+std::uint32_t KDecoder::getValue( const std::size_t valueBytes )
+{
+	if ( static_cast< std::size_t >( d_end - d_input ) < valueBytes )
+		throwMalformedData();
+
+	std::uint32_t result = 0;
+	for ( std::size_t j = 0
+		; j < valueBytes
+		; ++j )
+	{
+		result |= static_cast< std::uint32_t >( d_input[ j ] ) << ( 8 * j );
+	}
+	d_input += valueBytes;
+	return result;
+}
+
+inline void KDecoder::putCoord(
+	const std::uint32_t value,
+	std::uint32_t* prevCoord )
+{
+	*prevCoord += zigzagDecode( value );
+	*d_coords++ = static_cast< int >( *prevCoord );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+void encode(
+	const points_t& points,
+	bytes_t* output )
+{
+	KEncoder encoder( output );
+	for ( const SPoint& point : points )
+	{
+		encoder.putPoint( point );
+	}
+	encoder.flush();
+}
+
+std::size_t decode(
+	const std::uint8_t* input,
+	const std::size_t inputSize,
+	const std::size_t pointsCount,
+	ints_t* coords )
+{
+	// each group takes at least the tag and one byte per value
+	const std::size_t groupsCount = calcGroupsCount( pointsCount );
+	if ( ( inputSize / MinGroupBytes ) < groupsCount )
+		throwMalformedData();
+
+	// the last group may be padded, so there is room for the whole one
+	coords->resize( groupsCount * GroupSize );
+
+	KDecoder decoder( input, inputSize );
+	const std::size_t result = decoder.run( groupsCount, coords->data() );
+	coords->resize( 2 * pointsCount );
+	return result;
+}
+
+} // namespace delta_codec
+
+} // namespace be
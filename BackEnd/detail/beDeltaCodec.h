@@ -0,0 +1,48 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_BE_DELTA_CODEC_H
+#define INC_BE_DELTA_CODEC_H
+
+#include "beInternalTypes.h"
+
+namespace be
+{
+
+using bytes_t = std::vector< std::uint8_t >;
+using ints_t = std::vector< int >;
+
+/*
+	compressed encoding of the segment points, consecutive points lie close
+	to each other, so instead of the coords there are stored their deltas
+	(the first point is a delta from (0, 0))
+
+	each delta is zig-zag encoded (0, -1, 1, -2, ... => 0, 1, 2, 3, ...),
+	then the values (dx1, dy1, dx2, dy2, ...) are packed in groups of four:
+
+	byte tag (bits 2i+1..2i - number of bytes of i-th value minus 1)
+	byte value[ 4 ][ 1..4 ] (little endian)
+
+	the last group is padded with zeros if the number of values isn't
+	divisible by four
+*/
+namespace delta_codec
+{
+
+// appends the encoded points to the output
+void encode(
+	const points_t& points,
+	bytes_t* output );
+
+// decodes 'pointsCount' points from [input, input + inputSize) into
+// consecutive (x, y) coords and returns the number of consumed bytes,
+// throws std::runtime_error if data is malformed
+std::size_t decode(
+	const std::uint8_t* input,
+	std::size_t inputSize,
+	std::size_t pointsCount,
+	ints_t* coords );
+
+} // namespace delta_codec
+
+} // namespace be
+
+#endif
@@ -81,41 +81,43 @@ void dumpPoints( const points_t& points )
 	}
 }
 
-void dumpSegment( const SRawSegment& segment )
+void dumpSegment(
+	const SSegments& segments,
+	const std::size_t segmentIndex )
 {
-	std::cout << "class: " << segment.d_roadClass << std::endl;
-	const points_t& points = segment.d_points;
-	dumpPoints( points );
+	std::cout << "class: " << segments.getRoadClassIndex( segmentIndex ) << std::endl;
+	const SPointPos* end = segments.getPointsEnd( segmentIndex );
+	for ( const SPointPos* it = segments.getPointsBegin( segmentIndex )
+		; it != end
+		; ++it )
+	{
+		dumpPoint( it->getPoint() );
+		std::cout << std::endl;
+	}
 }
 
 } // anonymous namespace
 
-void dumpRawSegments( const raw_segments_t& segments )
+void dumpSegments( const SSegments& segments )
 {
-	int index = 0;
-	for ( auto it = segments.begin()
-		; it != segments.end()
-		; ++it, ++index )
+	for ( std::size_t index = 0
+		; index < segments.size()
+		; ++index )
 	{
 		std::cout << index << std::endl;
-		const SRawSegment& segment = *it;
-		dumpSegment( segment );
+		dumpSegment( segments, index );
 	}
 }
 
 // ----------------------------------------------------------------------------
 
-void dumpPoints( const raw_segments_t& segments )
+void dumpPoints( const SSegments& segments )
 {
 	points_t points;
 
-	for ( const SRawSegment& segment : segments )
+	for ( const SPointPos& pointPos : segments.d_points )
 	{
-		const points_t& segmentPoints = segment.d_points;
-		points.insert(
-			points.end(),
-			segmentPoints.begin(),
-			segmentPoints.end() );
+		points.push_back( pointPos.getPoint() );
 	}
 
 	std::sort( points.begin(), points.end(), compare_by_x() );
@@ -167,9 +169,9 @@ void dumpSections(
 		{
 			std::cout << sectid << ' ';
 			document->getSection( sectid, &section );
-			dumpPoint( *section.d_begin );
+			dumpPoint( section.d_begin );
 			std::cout << ' ' ;
-			dumpPoint( *section.d_end );
+			dumpPoint( section.d_end );
 			std::cout << std::endl;
 		}
 	}
@@ -12,9 +12,9 @@ struct IInternalDocument;
 namespace diag
 {
 
-void dumpRawSegments( const raw_segments_t& segments );
+void dumpSegments( const SSegments& segments );
 
-void dumpPoints( const raw_segments_t& segments );
+void dumpPoints( const SSegments& segments );
 
 void dumpRect( const SRect& rect );
 
@@ -6,6 +6,10 @@
 #include "beMapReader.h"
 #include "beRangeTree.h"
 #include "beIntervalTree.h"
+#include "beSectionsRTree.h"
+#include "beIndexImage.h"
+#include "beArena.h"
+#include "beMapStream.h"
 #include "beViewportArea.h"
 #include "beUtils.h"
 #include "beConsts.h"
@@ -18,12 +22,112 @@ namespace be
 namespace
 {
 
+// the map as it is read, before the segments and indexes are created
+struct SMapContents
+{
+	SMapContents();
+
+	void read( IMapStream* mapStream );
+	void readMajorRoadClasses( const IProgressiveMapReader& mapReader );
+	void readWholeMap( const IProgressiveMapReader& mapReader );
+	void extractMajorRoadClasses( SMapContents* majorContents ) const;
+	bool hasMinorRoadClasses() const;
+
+	SReaderData getReaderData( IMapStream* mapStream );
+
+	SRect d_mapRect;
+	bools_t d_roadClassFlags;
+	SSegments d_segments;
+	std::size_t d_pointsCount;
+};
+
+// ----------------------------------------------------------------------------
+
+SMapContents::SMapContents()
+	: d_pointsCount( 0 )
+{
+}
+
+void SMapContents::read( IMapStream* mapStream )
+{
+	be::readMap( getReaderData( mapStream ) );
+}
+
+void SMapContents::readMajorRoadClasses( const IProgressiveMapReader& mapReader )
+{
+	mapReader.readMajorRoadClasses( getReaderData( nullptr ) );
+}
+
+void SMapContents::readWholeMap( const IProgressiveMapReader& mapReader )
+{
+	mapReader.readWholeMap( getReaderData( nullptr ) );
+}
+
+/*
+	gets the segments of the most important road classes only, the map rect
+	and road classes are left as they are, so the road classes are painted
+	the same way and the view doesn't change once the rest is loaded
+*/
+void SMapContents::extractMajorRoadClasses( SMapContents* majorContents ) const
+{
+	int minMajorRoadClass = static_cast< int >( d_roadClassFlags.size() );
+	std::size_t majorRoadClassesCount = 0;
+	while ( ( 0 < minMajorRoadClass ) && ( majorRoadClassesCount < consts::MajorRoadClassesCount ) )
+	{
+		--minMajorRoadClass;
+		if ( d_roadClassFlags[ minMajorRoadClass ] )
+			++majorRoadClassesCount;
+	}
+
+	// the segments are sorted by road class, so the major ones are at the end
+	const road_class_indexes_t& roadClassIndexes = d_segments.d_roadClassIndexes;
+	auto majorBegin = std::find_if(
+		roadClassIndexes.begin(),
+		roadClassIndexes.end(),
+		[ minMajorRoadClass ]( const int roadClassIndex )
+		{
+			return minMajorRoadClass <= roadClassIndex;
+		} );
+
+	majorContents->d_mapRect = d_mapRect;
+	majorContents->d_roadClassFlags = d_roadClassFlags;
+	majorContents->d_segments.append(
+		d_segments,
+		std::distance( roadClassIndexes.begin(), majorBegin ) );
+	majorContents->d_pointsCount = majorContents->d_segments.getPointsCount();
+}
+
+// the road classes are those of the whole map (vide readMajorRoadClasses)
+bool SMapContents::hasMinorRoadClasses() const
+{
+	const std::size_t roadClassesCount = std::count( d_roadClassFlags.begin(), d_roadClassFlags.end(), true );
+	const bool result = ( consts::MajorRoadClassesCount < roadClassesCount );
+	return result;
+}
+
+SReaderData SMapContents::getReaderData( IMapStream* mapStream )
+{
+	const SReaderData result(
+		mapStream,
+		&d_mapRect,
+		&d_roadClassFlags,
+		&d_segments,
+		&d_pointsCount );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
 class KDocument :
 	public IInternalDocument,
 	public KSegmentsManager
 {
 	public:
-		explicit KDocument( IMapStream* mapStream );
+		KDocument(
+			SMapContents* contents,
+			const std::string& indexFname,
+			EIndexMode indexMode );
 		~KDocument() override = default;
 
 	public:
@@ -33,6 +137,8 @@ class KDocument :
 
 		color32_t getBkColor() const override;
 
+		SMemoryUsage getMemoryUsage() const override;
+
 	public:
 		// IInternalDocument
 		const SViewData& getViewData() const override;
@@ -42,45 +148,58 @@ class KDocument :
 
 		bool selectSections(
 			const SRect& viewportRect,
-			section_ids_t* sections ) const override;
+			SSelectionBuffers* buffers ) const override;
 
 		void getSection(
 			section_id_t sectid,
 			SSection* section ) const override;
 
+		bool updateContents() override;
+		bool isLoading() const override;
+
 	private:
 		void initRoadClasses( const bools_t& roadClassFlags );
 		void initViewport();
+		void createIndexes( const std::string& indexFname );
 		void createRangeTree();
 		void createIntervalTree();
+		void createSectionsRTree();
+		bool loadIndexImage( const std::string& indexFname );
+		void storeIndexImage( const std::string& indexFname ) const;
+
+		void resetIndexes();
 
 	private:
 		SViewData d_viewData;
+		const EIndexMode d_indexMode;
+		// own the nodes of the trees, so they are declared before them, each
+		// tree has its own arena, so their sizes are reported separately
+		KArena d_rangeTreeArena;
+		KArena d_intervalTreeArena;
 		std::unique_ptr< KRangeTree > d_rangeTree;
 		std::unique_ptr< KIntervalTree > d_intervalTree;
+		// replaces both the trees above (vide RTreeIndexes)
+		std::unique_ptr< KSectionsRTree > d_sectionsRTree;
 
 };
 
 // ----------------------------------------------------------------------------
 
-KDocument::KDocument( IMapStream* mapStream )
+KDocument::KDocument(
+	SMapContents* contents,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+	: d_indexMode( indexMode )
 {
-	bools_t roadClassFlags;
-	raw_segments_t rawSegments;
-	SReaderData readerData(
-		mapStream,
-		&d_viewData.d_mapRect,
-		&roadClassFlags,
-		&rawSegments );
-	if ( be::readMap( readerData ) )
+	d_viewData.d_mapRect = contents->d_mapRect;
+	if ( !contents->d_segments.empty() )
 	{
 		#ifdef ENABLE_LOGGING
-		//diag::dumpPoints( rawSegments );
+		//diag::dumpPoints( contents->d_segments );
 		#endif
-		initRoadClasses( roadClassFlags );
-		init( &rawSegments );
-		createRangeTree();
-		createIntervalTree();
+		initRoadClasses( contents->d_roadClassFlags );
+		init( &contents->d_segments, contents->d_pointsCount );
+		createIndexes( indexFname );
 		initViewport();
 	}
 }
@@ -110,6 +229,21 @@ color32_t KDocument::getBkColor() const
 	return consts::BackgroundColor32;
 }
 
+SMemoryUsage KDocument::getMemoryUsage() const
+{
+	SMemoryUsage result;
+	result.d_segments = KSegmentsManager::getMemorySize();
+	result.d_rangeTreeNodes = d_rangeTreeArena.getSize();
+	if ( d_rangeTree )
+		result.d_rangeTreeLists = d_rangeTree->getListsMemorySize();
+	result.d_intervalTrees = d_intervalTreeArena.getSize();
+	if ( d_intervalTree )
+		result.d_intervalTrees += d_intervalTree->getHeapsMemorySize();
+	if ( d_sectionsRTree )
+		result.d_sectionsRTree = d_sectionsRTree->getMemorySize();
+	return result;
+}
+
 // ----------------------------------------------------------------------------
 
 const SViewData& KDocument::getViewData() const
@@ -146,17 +280,25 @@ const road_classes_t& KDocument::getBaseRoadClasses() const
 
 bool KDocument::selectSections(
 	const SRect& viewportRect,
-	section_ids_t* sections ) const
+	SSelectionBuffers* buffers ) const
 {
-	const KViewportArea viewportArea( viewportRect );
-	point_ids_t pointids;
-	if ( d_rangeTree )
-		d_rangeTree->selectPoints( viewportArea, &pointids );
-	sect_pos_ids_t sectposids;
-	if ( d_intervalTree )
-		d_intervalTree->selectSectPositions( viewportArea, &sectposids );
-	const bool result = prepareSections( viewportRect, pointids, sectposids, sections );
-	assert( compareBruteForceSelectSections( viewportRect, *sections ) );
+	buffers->clear();
+	section_ids_t& sections = buffers->d_sections;
+	bool result = false;
+	if ( d_sectionsRTree )
+	{
+		result = d_sectionsRTree->selectSections( viewportRect, &sections );
+	}
+	else
+	{
+		const KViewportArea viewportArea( viewportRect );
+		if ( d_rangeTree )
+			d_rangeTree->selectPoints( viewportArea, &buffers->d_pointids );
+		if ( d_intervalTree )
+			d_intervalTree->selectSectPositions( viewportArea, &buffers->d_crosssectposids, &buffers->d_sectposids );
+		result = prepareSections( viewportRect, buffers->d_pointids, buffers->d_sectposids, &sections );
+	}
+	assert( compareBruteForceSelectSections( viewportRect, sections ) );
 	return result;
 }
 
@@ -167,6 +309,16 @@ void KDocument::getSection(
 	KSegmentsManager::getSection( sectid, section );
 }
 
+bool KDocument::updateContents()
+{
+	return false;
+}
+
+bool KDocument::isLoading() const
+{
+	return false;
+}
+
 // ----------------------------------------------------------------------------
 
 void KDocument::initRoadClasses( const bools_t& roadClassFlags )
@@ -213,14 +365,349 @@ void KDocument::initViewport()
 	d_viewData.d_zoomFactor = consts::InitZoomFactor;
 }
 
+void KDocument::createIndexes( const std::string& indexFname )
+{
+	if ( d_indexMode == RTreeIndexes )
+	{
+		// it is built several times faster than the trees, so it is not
+		// cached in the index image
+		createSectionsRTree();
+	}
+	else if ( indexFname.empty() )
+	{
+		createRangeTree();
+		createIntervalTree();
+	}
+	else if ( !loadIndexImage( indexFname ) )
+	{
+		createRangeTree();
+		createIntervalTree();
+		storeIndexImage( indexFname );
+	}
+}
+
 void KDocument::createRangeTree()
 {
-	d_rangeTree = std::make_unique<KRangeTree>( *this );
+	d_rangeTree = std::make_unique<KRangeTree>( *this, &d_rangeTreeArena, d_indexMode );
 }
 
 void KDocument::createIntervalTree()
 {
-	d_intervalTree = std::make_unique<KIntervalTree>( *this );
+	d_intervalTree = std::make_unique<KIntervalTree>( *this, &d_intervalTreeArena );
+}
+
+void KDocument::createSectionsRTree()
+{
+	d_sectionsRTree = std::make_unique< KSectionsRTree >( *this );
+}
+
+/*
+	the image is mapped only to be read, the trees are copied into the arenas
+	and their buffers like the built ones, so the queries don't depend on the
+	image; the nodes are not in the image, the lists of the fast mode get
+	their ranks and the ones of the compact mode get packed, and the mapping
+	is released only then, so the pages of the image read so far add to the
+	peak memory, still the load is several times faster than the build
+*/
+bool KDocument::loadIndexImage( const std::string& indexFname )
+{
+	bool result = false;
+	std::unique_ptr< IMapStream > imageStream( IMapStream::createMapped( indexFname ) );
+	if ( !imageStream )
+		imageStream.reset( IMapStream::create( indexFname ) );
+
+	if ( imageStream )
+	{
+		try
+		{
+			KIndexImageReader image( imageStream.get(), *this );
+			image.checkHeader( calcFingerprint() );
+			d_rangeTree = std::make_unique< KRangeTree >( *this, &d_rangeTreeArena, d_indexMode, &image );
+			d_intervalTree = std::make_unique< KIntervalTree >( *this, &d_intervalTreeArena, &image );
+			image.checkTrailer();
+			result = true;
+		}
+		catch ( std::exception& )
+		{
+			// stale or damaged image, the indexes will be built from scratch
+			resetIndexes();
+		}
+	}
+	return result;
+}
+
+void KDocument::resetIndexes()
+{
+	d_rangeTree.reset();
+	d_intervalTree.reset();
+	d_rangeTreeArena.reset();
+	d_intervalTreeArena.reset();
+}
+
+void KDocument::storeIndexImage( const std::string& indexFname ) const
+{
+	bool stored = false;
+	{
+		std::ofstream output( indexFname, std::ios::binary | std::ios::trunc );
+		if ( output )
+		{
+			KIndexImageWriter image( &output );
+			image.putHeader( calcFingerprint() );
+			d_rangeTree->store( &image );
+			d_intervalTree->store( &image );
+			image.putTrailer();
+			stored = image.isGood();
+		}
+	}
+
+	// it is only a cache, so don't fail if it can't be written
+	if ( !stored )
+		std::remove( indexFname.c_str() );
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	at first only the major road classes are read and indexed, so there is
+	something to show almost at once, meanwhile the whole map is read and
+	indexed in the background; once it is ready, it replaces the major road
+	classes at the next updateContents (called by the controller before the
+	contents is generated, so the sections never change during the
+	generation); the document waits for the background loading to finish
+	when destroyed
+*/
+class KProgressiveDocument : public IInternalDocument
+{
+	public:
+		KProgressiveDocument(
+			std::unique_ptr< IMapStream > mapStream,
+			const std::string& indexFname,
+			EIndexMode indexMode );
+		~KProgressiveDocument() override = default;
+
+	public:
+		// IDocument
+		std::string getState() const override;
+		void setState( const std::string& stateString ) override;
+
+		color32_t getBkColor() const override;
+
+		SMemoryUsage getMemoryUsage() const override;
+
+	public:
+		// IInternalDocument
+		const SViewData& getViewData() const override;
+		bool setViewData( const SViewData& viewData ) override;
+
+		const road_classes_t& getBaseRoadClasses() const override;
+
+		bool selectSections(
+			const SRect& viewportRect,
+			SSelectionBuffers* buffers ) const override;
+
+		void getSection(
+			section_id_t sectid,
+			SSection* section ) const override;
+
+		bool updateContents() override;
+		bool isLoading() const override;
+
+	private:
+		void loadProgressively(
+			const std::string& indexFname,
+			EIndexMode indexMode );
+		void loadAtOnce(
+			const std::string& indexFname,
+			EIndexMode indexMode );
+		void releaseMap();
+
+		static std::unique_ptr< KDocument > loadWholeMap(
+			const IProgressiveMapReader* mapReader,
+			const std::string& indexFname,
+			EIndexMode indexMode );
+		static std::unique_ptr< KDocument > loadContents(
+			std::shared_ptr< SMapContents > contents,
+			const std::string& indexFname,
+			EIndexMode indexMode );
+
+	private:
+		// the whole map is read from them in the background, so they are
+		// declared before the loaded contents (which waits for it)
+		std::unique_ptr< IMapStream > d_mapStream;
+		std::unique_ptr< IProgressiveMapReader > d_mapReader;
+
+		std::unique_ptr< KDocument > d_contents;
+		std::future< std::unique_ptr< KDocument > > d_loadedContents;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KProgressiveDocument::KProgressiveDocument(
+	std::unique_ptr< IMapStream > mapStream,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+	: d_mapStream( std::move( mapStream ) )
+	, d_mapReader( IProgressiveMapReader::create( d_mapStream.get() ) )
+{
+	if ( d_mapReader )
+		loadProgressively( indexFname, indexMode );
+	else
+		loadAtOnce( indexFname, indexMode );
+}
+
+// ----------------------------------------------------------------------------
+
+std::string KProgressiveDocument::getState() const
+{
+	return d_contents->getState();
+}
+
+void KProgressiveDocument::setState( const std::string& stateString )
+{
+	d_contents->setState( stateString );
+}
+
+color32_t KProgressiveDocument::getBkColor() const
+{
+	return d_contents->getBkColor();
+}
+
+SMemoryUsage KProgressiveDocument::getMemoryUsage() const
+{
+	return d_contents->getMemoryUsage();
+}
+
+// ----------------------------------------------------------------------------
+
+const SViewData& KProgressiveDocument::getViewData() const
+{
+	return d_contents->getViewData();
+}
+
+bool KProgressiveDocument::setViewData( const SViewData& viewData )
+{
+	return d_contents->setViewData( viewData );
+}
+
+const road_classes_t& KProgressiveDocument::getBaseRoadClasses() const
+{
+	return d_contents->getBaseRoadClasses();
+}
+
+bool KProgressiveDocument::selectSections(
+	const SRect& viewportRect,
+	SSelectionBuffers* buffers ) const
+{
+	return d_contents->selectSections( viewportRect, buffers );
+}
+
+void KProgressiveDocument::getSection(
+	const section_id_t sectid,
+	SSection* section ) const
+{
+	d_contents->getSection( sectid, section );
+}
+
+bool KProgressiveDocument::updateContents()
+{
+	bool result = false;
+	if ( d_loadedContents.valid()
+		&& ( d_loadedContents.wait_for( std::chrono::seconds( 0 ) ) == std::future_status::ready ) )
+	{
+		try
+		{
+			std::unique_ptr< KDocument > loadedContents = d_loadedContents.get();
+			loadedContents->setViewData( d_contents->getViewData() );
+			d_contents = std::move( loadedContents );
+			result = true;
+		}
+		catch ( std::exception& )
+		{
+			// the major road classes are still shown, it is better than nothing
+		}
+		releaseMap();
+	}
+	return result;
+}
+
+bool KProgressiveDocument::isLoading() const
+{
+	return d_loadedContents.valid();
+}
+
+// ----------------------------------------------------------------------------
+
+// only the segments of the major road classes are read before the first frame
+void KProgressiveDocument::loadProgressively(
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	SMapContents majorContents;
+	majorContents.readMajorRoadClasses( *d_mapReader );
+	if ( majorContents.hasMinorRoadClasses() )
+	{
+		// the index image (if any) is valid for the whole map only
+		d_contents = std::make_unique< KDocument >( &majorContents, std::string(), indexMode );
+		d_loadedContents = std::async( std::launch::async, loadWholeMap, d_mapReader.get(), indexFname, indexMode );
+	}
+	else
+	{
+		d_contents = std::make_unique< KDocument >( &majorContents, indexFname, indexMode );
+		releaseMap();
+	}
+}
+
+// the stream can be read only once in order, so the major road classes are
+// extracted from the whole map
+void KProgressiveDocument::loadAtOnce(
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	auto contents = std::make_shared< SMapContents >();
+	contents->read( d_mapStream.get() );
+	releaseMap();
+
+	SMapContents majorContents;
+	contents->extractMajorRoadClasses( &majorContents );
+	if ( majorContents.d_pointsCount != contents->d_pointsCount )
+	{
+		// the index image (if any) is valid for the whole map only
+		d_contents = std::make_unique< KDocument >( &majorContents, std::string(), indexMode );
+		d_loadedContents = std::async( std::launch::async, loadContents, contents, indexFname, indexMode );
+	}
+	else
+	{
+		d_contents = loadContents( contents, indexFname, indexMode );
+	}
+}
+
+// the segments are copied from the map, so it is released once it is read
+void KProgressiveDocument::releaseMap()
+{
+	d_mapReader.reset();
+	d_mapStream.reset();
+}
+
+std::unique_ptr< KDocument > KProgressiveDocument::loadWholeMap(
+	const IProgressiveMapReader* mapReader,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	SMapContents contents;
+	contents.readWholeMap( *mapReader );
+	auto result = std::make_unique< KDocument >( &contents, indexFname, indexMode );
+	return result;
+}
+
+std::unique_ptr< KDocument > KProgressiveDocument::loadContents(
+	std::shared_ptr< SMapContents > contents,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	auto result = std::make_unique< KDocument >( contents.get(), indexFname, indexMode );
+	return result;
 }
 
 } // anonymous namespace
@@ -228,9 +715,22 @@ void KDocument::createIntervalTree()
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
-IInternalDocument* createDocument( IMapStream* mapStream )
+IInternalDocument* createDocument(
+	IMapStream* mapStream,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	SMapContents contents;
+	contents.read( mapStream );
+	return new KDocument( &contents, indexFname, indexMode );
+}
+
+IInternalDocument* createProgressiveDocument(
+	std::unique_ptr< IMapStream > mapStream,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
 {
-	return new KDocument( mapStream );
+	return new KProgressiveDocument( std::move( mapStream ), indexFname, indexMode );
 }
 
 } // namespace be
@@ -2,13 +2,34 @@
 #ifndef INC_BE_DOCUMENT_IMPL_H
 #define INC_BE_DOCUMENT_IMPL_H
 
+#include "beTypes.h"
+
 namespace be
 {
 
 struct IMapStream;
 struct IInternalDocument;
 
-IInternalDocument* createDocument( IMapStream* mapStream );
+/*
+	if indexFname is not empty, then the spatial indexes are loaded from that
+	image (if it is valid for the map), else they are built and stored there
+*/
+IInternalDocument* createDocument(
+	IMapStream* mapStream,
+	const std::string& indexFname,
+	EIndexMode indexMode );
+
+/*
+	only the major road classes are read and indexed before it returns, the
+	whole map is read and indexed in the background from the stream taken
+	over by the document, it is shown once it is ready (vide
+	IInternalDocument::updateContents); if the stream doesn't hand out direct
+	views (vide IMapStream::viewInts), the whole map is read at once
+*/
+IInternalDocument* createProgressiveDocument(
+	std::unique_ptr< IMapStream > mapStream,
+	const std::string& indexFname,
+	EIndexMode indexMode );
 
 } // namespace be
 
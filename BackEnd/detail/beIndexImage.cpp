@@ -0,0 +1,198 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beIndexImage.h"
+#include "beSegmentsManager.h"
+#include "beMapStream.h"
+#include "beConsts.h"
+
+namespace be
+{
+
+namespace
+{
+
+void throwInvalidImage()
+{
+	throw std::runtime_error( "invalid index image" );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+KIndexImageReader::KIndexImageReader(
+	IMapStream* stream,
+	const KSegmentsManager& segmentsManager )
+	: d_stream( *stream )
+	, d_segmentsManager( segmentsManager )
+{
+}
+
+void KIndexImageReader::checkHeader( const std::uint32_t fingerprint )
+{
+	if ( ( getInt() != consts::IndexImageMagic )
+		|| ( getInt() != consts::IndexImageVersion )
+		|| ( getInt() != static_cast< int >( id_handle_t::size_of() * 8 ) )
+		|| ( static_cast< std::uint32_t >( getInt() ) != fingerprint ) )
+	{
+		throwInvalidImage();
+	}
+}
+
+void KIndexImageReader::checkTrailer()
+{
+	if ( getInt() != consts::IndexImageMagic )
+		throwInvalidImage();
+}
+
+void KIndexImageReader::checkItem( const bool valid )
+{
+	if ( !valid )
+		throwInvalidImage();
+}
+
+int KIndexImageReader::getInt()
+{
+	int result = 0;
+	if ( !d_stream.getInt( &result ) )
+		throwInvalidImage();
+	return result;
+}
+
+std::size_t KIndexImageReader::getCount()
+{
+	const int count = getInt();
+	if ( count < 0 )
+		throwInvalidImage();
+	const std::size_t result = count;
+	return result;
+}
+
+EImageItemTag KIndexImageReader::getTag()
+{
+	const int tag = getInt();
+	if ( ( tag != NoImageItem ) && ( tag != NodeImageItem ) && ( tag != LeafImageItem ) )
+		throwInvalidImage();
+	const EImageItemTag result = static_cast< EImageItemTag >( tag );
+	return result;
+}
+
+const SPointPos* KIndexImageReader::getPointPos()
+{
+	const point_pos_id_t pointid( static_cast< id_handle_t::value_t >( getInt() ) );
+	const SPointPos* result = d_segmentsManager.findPointPos( pointid );
+	if ( result == nullptr )
+		throwInvalidImage();
+	return result;
+}
+
+void KIndexImageReader::getPointPositions(
+	const std::size_t count,
+	point_positions_t* point_positions )
+{
+	point_positions->reserve( point_positions->size() + count );
+	const int* ids = getBlock( count );
+	const int* idsEnd = ids + count;
+	for ( const int* it = ids
+		; it != idsEnd
+		; ++it )
+	{
+		const point_pos_id_t pointid( static_cast< id_handle_t::value_t >( *it ) );
+		const SPointPos* pointPos = d_segmentsManager.findPointPos( pointid );
+		if ( pointPos == nullptr )
+			throwInvalidImage();
+		point_positions->push_back( pointPos );
+	}
+}
+
+void KIndexImageReader::getPointIndexes(
+	const std::size_t count,
+	point_offsets_t* point_indexes )
+{
+	point_indexes->reserve( point_indexes->size() + count );
+	const int* ids = getBlock( count );
+	const int* idsEnd = ids + count;
+	for ( const int* it = ids
+		; it != idsEnd
+		; ++it )
+	{
+		const point_pos_id_t pointid( static_cast< id_handle_t::value_t >( *it ) );
+		if ( d_segmentsManager.findPointPos( pointid ) == nullptr )
+			throwInvalidImage();
+		point_indexes->push_back( pointid.get() );
+	}
+}
+
+const SSectionPos* KIndexImageReader::getSectionPos()
+{
+	const sect_pos_id_t sectposid( static_cast< id_handle_t::value_t >( getInt() ) );
+	const SSectionPos* result = d_segmentsManager.findSectionPos( sectposid );
+	if ( result == nullptr )
+		throwInvalidImage();
+	return result;
+}
+
+const int* KIndexImageReader::getBlock( const std::size_t count )
+{
+	// mapped image is used directly, else the block is read at once
+	const int* result = d_stream.viewInts( count );
+	if ( result == nullptr )
+	{
+		if ( d_buffer.size() < count )
+			d_buffer.resize( count );
+		if ( !d_stream.getInts( d_buffer.data(), count ) )
+			throwInvalidImage();
+		result = d_buffer.data();
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+KIndexImageWriter::KIndexImageWriter( std::ostream* output )
+	: d_output( *output )
+{
+}
+
+void KIndexImageWriter::putHeader( const std::uint32_t fingerprint )
+{
+	putInt( consts::IndexImageMagic );
+	putInt( consts::IndexImageVersion );
+	putInt( static_cast< int >( id_handle_t::size_of() * 8 ) );
+	putInt( static_cast< int >( fingerprint ) );
+}
+
+void KIndexImageWriter::putTrailer()
+{
+	putInt( consts::IndexImageMagic );
+}
+
+void KIndexImageWriter::putInt( const int value )
+{
+	d_output.write( reinterpret_cast< const char* >( &value ), sizeof( value ) );
+}
+
+void KIndexImageWriter::putCount( const std::size_t count )
+{
+	assert( count <= static_cast< std::size_t >( std::numeric_limits< int >::max() ) );
+	putInt( static_cast< int >( count ) );
+}
+
+void KIndexImageWriter::putTag( const EImageItemTag tag )
+{
+	putInt( tag );
+}
+
+void KIndexImageWriter::putId( const id_handle_t& id )
+{
+	putInt( static_cast< int >( id.get() ) );
+}
+
+bool KIndexImageWriter::isGood() const
+{
+	const bool result = d_output.good();
+	return result;
+}
+
+} // namespace be
@@ -0,0 +1,106 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_BE_INDEX_IMAGE_H
+#define INC_BE_INDEX_IMAGE_H
+
+#include "beInternalTypes.h"
+
+namespace be
+{
+
+struct IMapStream;
+class KSegmentsManager;
+
+/*
+	image of the spatial indexes persisted next to the map, it is
+	relocatable - there are no pointers inside, the trees are stored in
+	preorder and refer to the positions by their ids (assumption int == 4
+	bytes):
+
+	int magic (consts::IndexImageMagic)
+	int version (consts::IndexImageVersion)
+	int bits of ids (id_handle_t::size_of)
+	int fingerprint of the map (KSegmentsManager::calcFingerprint)
+	range tree (vide KRangeTree::store)
+	horizontal and vertical interval trees (vide KIntervalTree::store)
+	int magic (consts::IndexImageMagic)
+
+	the image is valid only for the map it was built from, any mismatch
+	throws std::runtime_error while reading, as well as the damage that
+	breaks the structure, i.e. ids out of range or out of order (vide
+	checkItem), there is no checksum of the body
+*/
+
+enum EImageItemTag
+{
+	NoImageItem,
+	NodeImageItem,
+	LeafImageItem
+};
+
+// ----------------------------------------------------------------------------
+
+class KIndexImageReader
+{
+	public:
+		KIndexImageReader(
+			IMapStream* stream,
+			const KSegmentsManager& segmentsManager );
+
+	public:
+		void checkHeader( std::uint32_t fingerprint );
+		void checkTrailer();
+		// throws if the item read breaks the rules of its structure, e.g. the
+		// points are out of order
+		void checkItem( bool valid );
+
+		int getInt();
+		std::size_t getCount();
+		EImageItemTag getTag();
+
+		const SPointPos* getPointPos();
+		void getPointPositions(
+			std::size_t count,
+			point_positions_t* point_positions );
+		// appends the ids of the points, i.e. their indexes
+		void getPointIndexes(
+			std::size_t count,
+			point_offsets_t* point_indexes );
+
+		const SSectionPos* getSectionPos();
+
+	private:
+		const int* getBlock( std::size_t count );
+
+	private:
+		IMapStream& d_stream;
+		const KSegmentsManager& d_segmentsManager;
+		std::vector< int > d_buffer;
+
+};
+
+// ----------------------------------------------------------------------------
+
+class KIndexImageWriter
+{
+	public:
+		explicit KIndexImageWriter( std::ostream* output );
+
+	public:
+		void putHeader( std::uint32_t fingerprint );
+		void putTrailer();
+
+		void putInt( int value );
+		void putCount( std::size_t count );
+		void putTag( EImageItemTag tag );
+		void putId( const id_handle_t& id );
+
+		bool isGood() const;
+
+	private:
+		std::ostream& d_output;
+
+};
+
+} // namespace be
+
+#endif
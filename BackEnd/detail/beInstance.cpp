@@ -5,10 +5,35 @@
 #include "beInternalDocument.h"
 #include "beControllerImpl.h"
 #include "beController.h"
+#include "beMapStream.h"
 
 namespace be
 {
 
+namespace
+{
+
+bool attachDocument(
+	std::unique_ptr< IInternalDocument > internalDocument,
+	SInstance* instance )
+{
+	bool result = false;
+	if ( internalDocument )
+	{
+		instance->d_controller = createController( internalDocument.get() );
+		if ( instance->d_controller )
+		{
+			instance->d_document = internalDocument.release();
+			result = true;
+		}
+	}
+	return result;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
 SInstance::SInstance()
 	: d_document(nullptr )
 	, d_controller( nullptr )
@@ -22,20 +47,36 @@ SInstance::~SInstance()
 }
 
 bool SInstance::init( IMapStream* mapStream )
+{
+	const bool result = init( mapStream, std::string() );
+	return result;
+}
+
+bool SInstance::init(
+	IMapStream* mapStream,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
 {
 	bool result = false;
 	if ( mapStream != nullptr )
 	{
-		std::unique_ptr< IInternalDocument > internalDocument( createDocument( mapStream ) );
-		if ( internalDocument )
-		{
-			d_controller = createController( internalDocument.get() );
-			if ( d_controller )
-			{
-				d_document = internalDocument.release();
-				result = true;
-			}
-		}
+		std::unique_ptr< IInternalDocument > internalDocument( createDocument( mapStream, indexFname, indexMode ) );
+		result = attachDocument( std::move( internalDocument ), this );
+	}
+	return result;
+}
+
+bool SInstance::initAsync(
+	std::unique_ptr< IMapStream > mapStream,
+	const std::string& indexFname,
+	const EIndexMode indexMode )
+{
+	bool result = false;
+	if ( mapStream != nullptr )
+	{
+		std::unique_ptr< IInternalDocument > internalDocument(
+			createProgressiveDocument( std::move( mapStream ), indexFname, indexMode ) );
+		result = attachDocument( std::move( internalDocument ), this );
 	}
 	return result;
 }
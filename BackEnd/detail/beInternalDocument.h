@@ -18,14 +18,22 @@ struct IInternalDocument : public IDocument
 
 		virtual const road_classes_t& getBaseRoadClasses() const = 0;
 
+		// the sections are returned in buffers->d_sections
 		virtual bool selectSections(
 			const SRect& viewportRect,
-			section_ids_t* sections ) const = 0;
+			SSelectionBuffers* buffers ) const = 0;
 
 		virtual void getSection(
 			const section_id_t sectid,
 			SSection* section ) const = 0;
 
+		// adopts the contents loaded in the background meanwhile (if any),
+		// returns true if it has changed
+		virtual bool updateContents() = 0;
+
+		// true until all the contents loaded in the background is adopted
+		virtual bool isLoading() const = 0;
+
 };
 
 } // namespace be
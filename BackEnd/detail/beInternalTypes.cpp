@@ -1,6 +1,7 @@
 // author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
 #include "ph.h"
 #include "beInternalTypes.h"
+#include "beUtils.h"
 
 namespace be
 {
@@ -19,13 +20,6 @@ std::ostream& operator<<(std::ostream& os, const id_handle_t& handle)
 
 // ----------------------------------------------------------------------------
 
-SRawSegment::SRawSegment( int roadClass )
-	: d_roadClass( roadClass )
-{
-}
-
-// ----------------------------------------------------------------------------
-
 SRoadClass::SRoadClass(
 	coord_t thickness,
 	color_t color )
@@ -60,70 +54,175 @@ bool SRoadClass::hasOutline() const
 
 // ----------------------------------------------------------------------------
 
-SPointPos::SPointPos(
-	const point_pos_id_t pointposid,
-	const SPoint& point )
-	: d_id( pointposid )
-	, d_point( point )
+#ifdef ENABLE_TILED_POINTS
+
+// the tile is the floor of coord / TileSize, so the offset is never negative
+STiledPoint::STiledPoint( const SPoint& point )
+	: d_offsetX( static_cast< std::uint16_t >( point.x & ( TileSize - 1 ) ) )
+	, d_offsetY( static_cast< std::uint16_t >( point.y & ( TileSize - 1 ) ) )
+	, d_tileX( static_cast< std::int8_t >( point.x >> 16 ) )
+	, d_tileY( static_cast< std::int8_t >( point.y >> 16 ) )
+{
+	assert( isInRange( point ) );
+	assert( decode() == point );
+}
+
+bool STiledPoint::isInRange( const SPoint& point )
 {
+	const bool result = utils::isValueInRange( MinCoord, point.x, MaxCoord, true )
+		&& utils::isValueInRange( MinCoord, point.y, MaxCoord, true );
+	return result;
 }
 
+#endif
+
 // ----------------------------------------------------------------------------
 
-SSegment::SSegment( const int roadClassIndex )
-	: d_roadClassIndex( roadClassIndex )
+SPointPos::SPointPos( const SPoint& point )
+	: d_point( point )
 {
 }
 
 // ----------------------------------------------------------------------------
 
-SSectionPos::SSectionPos(
-	const sect_pos_id_t sectposid,
-	const SPoint& point )
-	: d_id( sectposid )
-	, d_point( point )
+SSegments::SSegments()
+	: d_offsets( 1, 0 )
 {
 }
 
-// ----------------------------------------------------------------------------
+std::size_t SSegments::size() const
+{
+	return d_roadClassIndexes.size();
+}
 
-SIntervalSection::SIntervalSection(
-	const section_id_t sectid,
-	const SSectionPos& begin,
-	const SSectionPos& end )
-	: d_sectid( sectid )
-	, d_begin( begin )
-	, d_end( end )
+bool SSegments::empty() const
 {
+	return d_roadClassIndexes.empty();
 }
 
-bool SIntervalSection::hasOrientation( EOrientation orientation ) const
+std::size_t SSegments::getPointsCount() const
 {
-	bool result = false;
-	if ( orientation == Horizontal )
-	{
-		const coord_t y0 = d_begin.d_point.y;
-		const coord_t y1 = d_end.d_point.y;
-		if ( y0 == y1 )
-			result = true;
-	}
-	else
+	return d_offsets.back();
+}
+
+void SSegments::reserve(
+	const std::size_t segmentsCount,
+	const std::size_t pointsCount )
+{
+	d_points.reserve( pointsCount );
+	d_offsets.reserve( segmentsCount + 1 );
+	d_roadClassIndexes.reserve( segmentsCount );
+}
+
+// releases the memory too
+void SSegments::clear()
+{
+	SSegments().swap( *this );
+}
+
+void SSegments::swap( SSegments& segments )
+{
+	d_points.swap( segments.d_points );
+	d_offsets.swap( segments.d_offsets );
+	d_roadClassIndexes.swap( segments.d_roadClassIndexes );
+}
+
+int SSegments::getRoadClassIndex( const std::size_t segmentIndex ) const
+{
+	assert( segmentIndex < size() );
+	return d_roadClassIndexes[ segmentIndex ];
+}
+
+std::size_t SSegments::getPointsCount( const std::size_t segmentIndex ) const
+{
+	assert( segmentIndex < size() );
+	const std::size_t result = d_offsets[ segmentIndex + 1 ] - d_offsets[ segmentIndex ];
+	return result;
+}
+
+const SPointPos* SSegments::getPointsBegin( const std::size_t segmentIndex ) const
+{
+	assert( segmentIndex < size() );
+	return d_points.data() + d_offsets[ segmentIndex ];
+}
+
+const SPointPos* SSegments::getPointsEnd( const std::size_t segmentIndex ) const
+{
+	assert( segmentIndex < size() );
+	return d_points.data() + d_offsets[ segmentIndex + 1 ];
+}
+
+SPointPos* SSegments::getPointsBegin( const std::size_t segmentIndex )
+{
+	assert( segmentIndex < size() );
+	return d_points.data() + d_offsets[ segmentIndex ];
+}
+
+SPointPos* SSegments::getPointsEnd( const std::size_t segmentIndex )
+{
+	assert( segmentIndex < size() );
+	return d_points.data() + d_offsets[ segmentIndex + 1 ];
+}
+
+std::size_t SSegments::getOpenPointsCount() const
+{
+	return d_points.size() - d_offsets.back();
+}
+
+void SSegments::closeSegment( const int roadClassIndex )
+{
+	assert( ( 0 <= roadClassIndex ) && ( roadClassIndex <= std::numeric_limits< std::uint8_t >::max() ) );
+	assert( d_points.size() <= std::numeric_limits< std::uint32_t >::max() );
+	d_offsets.push_back( static_cast< std::uint32_t >( d_points.size() ) );
+	d_roadClassIndexes.push_back( static_cast< std::uint8_t >( roadClassIndex ) );
+}
+
+void SSegments::dropOpenPoints()
+{
+	d_points.erase( d_points.begin() + d_offsets.back(), d_points.end() );
+}
+
+void SSegments::append(
+	const SSegments& segments,
+	const std::size_t firstSegment )
+{
+	assert( getOpenPointsCount() == 0 );
+	const std::size_t segmentsCount = segments.size();
+	if ( segmentsCount <= firstSegment )
+		return;
+
+	const std::size_t firstPoint = segments.d_offsets[ firstSegment ];
+	d_points.insert(
+		d_points.end(),
+		segments.d_points.begin() + firstPoint,
+		segments.d_points.begin() + segments.getPointsCount() );
+
+	// offsets are relative to the beginning of the points
+	const std::uint32_t shift = d_offsets.back();
+	for ( std::size_t i = firstSegment + 1
+		; i <= segmentsCount
+		; ++i )
 	{
-		assert( orientation == Vertical );
-		const coord_t x0 = d_begin.d_point.x;
-		const coord_t x1 = d_end.d_point.x;
-		if ( x0 == x1 )
-			result = true;
+		d_offsets.push_back( shift + ( segments.d_offsets[ i ] - static_cast< std::uint32_t >( firstPoint ) ) );
 	}
-	return result;
+
+	d_roadClassIndexes.insert(
+		d_roadClassIndexes.end(),
+		segments.d_roadClassIndexes.begin() + firstSegment,
+		segments.d_roadClassIndexes.end() );
+}
+
+// ----------------------------------------------------------------------------
+
+SSectionPos::SSectionPos( const SPoint& point )
+	: d_point( point )
+{
 }
 
 // ----------------------------------------------------------------------------
 
 SSection::SSection()
 	: d_roadClassIndex( 0 )
-	, d_begin( nullptr )
-	, d_end( nullptr )
 {
 }
 
@@ -145,4 +244,14 @@ bool SViewData::operator!=( const SViewData& rhs ) const
 	return result;
 }
 
+// ----------------------------------------------------------------------------
+
+void SSelectionBuffers::clear()
+{
+	d_pointids.clear();
+	d_sectposids.clear();
+	d_crosssectposids.clear();
+	d_sections.clear();
+}
+
 } // namespace be
@@ -3,6 +3,7 @@
 #define INC_BE_INTERNAL_TYPES_H
 
 #include "beTypes.h"
+#include "beConfig.h"
 
 namespace be
 {
@@ -65,20 +66,6 @@ std::ostream& operator<<(std::ostream& os, const id_handle_t& handle);
 
 // ----------------------------------------------------------------------------
 
-struct SRawSegment
-{
-	SRawSegment( int roadClass );
-
-	int d_roadClass;
-	points_t d_points;
-};
-
-using raw_segments_t = std::vector< SRawSegment >;
-using raw_segments_it = raw_segments_t::iterator;
-using raw_segments_cit = raw_segments_t::const_iterator;
-
-// ----------------------------------------------------------------------------
-
 struct SRoadClass
 {
 	SRoadClass(
@@ -110,6 +97,7 @@ using road_classes_cit = road_classes_t::const_iterator;
 class point_pos_id_t : public id_handle_t
 {
 	public:
+		point_pos_id_t() = default;
 		explicit point_pos_id_t(id_handle_t::value_t handle) : id_handle_t(handle) {}
 		explicit point_pos_id_t(std::uint64_t handle) : id_handle_t(handle) {}
 };
@@ -120,17 +108,75 @@ using point_ids_cit = point_ids_t::const_iterator;
 
 // ----------------------------------------------------------------------------
 
+#ifdef ENABLE_TILED_POINTS
+
+/*
+	the map is split into fixed tiles of TileSize x TileSize, the point is
+	stored as 16-bit offset from the origin of its tile and 8-bit coords of
+	the tile, so it takes 6 bytes instead of 8, but the coords of the map
+	have to fit in MinCoord..MaxCoord (vide KSegmentsBuilder)
+*/
+struct STiledPoint
+{
+	explicit STiledPoint( const SPoint& point );
+
+	SPoint decode() const;
+
+	static bool isInRange( const SPoint& point );
+
+	static constexpr coord_t TileSize = coord_t( 1 ) << 16;
+	static constexpr coord_t MinCoord = -128 * TileSize;
+	static constexpr coord_t MaxCoord = 128 * TileSize - 1;
+
+	std::uint16_t d_offsetX;
+	std::uint16_t d_offsetY;
+	std::int8_t d_tileX;
+	std::int8_t d_tileY;
+};
+
+inline SPoint STiledPoint::decode() const
+{
+	const SPoint result(
+		d_tileX * TileSize + d_offsetX,
+		d_tileY * TileSize + d_offsetY );
+	return result;
+}
+
+using stored_point_t = STiledPoint;
+using decoded_point_t = SPoint;
+
+#else
+
+using stored_point_t = SPoint;
+using decoded_point_t = const SPoint&;
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+/*
+	there is no id stored, it is implied by the position of the point in
+	SSegments::d_points (vide KSegmentsManager::getPointPosId)
+*/
 struct SPointPos
 {
-	SPointPos(
-		const point_pos_id_t pointposid,
-		const SPoint& point );
+	explicit SPointPos( const SPoint& point );
 
-	point_pos_id_t d_id;
-	SPoint d_point;
+	decoded_point_t getPoint() const;
+
+	stored_point_t d_point;
 
 };
 
+inline decoded_point_t SPointPos::getPoint() const
+{
+#ifdef ENABLE_TILED_POINTS
+	return d_point.decode();
+#else
+	return d_point;
+#endif
+}
+
 using point_positions_t = std::vector< const SPointPos* >;
 using point_positions_it = point_positions_t::iterator;
 using point_positions_cit = point_positions_t::const_iterator;
@@ -141,18 +187,50 @@ using segment_points_t = std::vector< SPointPos >;
 using segment_points_it = segment_points_t::iterator;
 using segment_points_cit = segment_points_t::const_iterator;
 
-struct SSegment
+using point_offsets_t = std::vector< std::uint32_t >;
+using road_class_indexes_t = std::vector< std::uint8_t >;
+
+/*
+	all the segments stored in three arrays (CSR layout), so there are just
+	a few allocations regardless of the size of the map: points of the
+	segment i are d_points[ d_offsets[ i ] ] .. d_points[ d_offsets[ i + 1 ] - 1 ]
+	and its road class is d_roadClassIndexes[ i ]
+
+	the points are appended to d_points first, then closeSegment turns
+	the ones following the last segment into the new segment
+*/
+struct SSegments
 {
-	SSegment( const int roadClassIndex );
+	SSegments();
+
+	std::size_t size() const;
+	bool empty() const;
+	std::size_t getPointsCount() const;
+
+	void reserve( std::size_t segmentsCount, std::size_t pointsCount );
+	void clear();
+	void swap( SSegments& segments );
+
+	int getRoadClassIndex( std::size_t segmentIndex ) const;
+	std::size_t getPointsCount( std::size_t segmentIndex ) const;
+	const SPointPos* getPointsBegin( std::size_t segmentIndex ) const;
+	const SPointPos* getPointsEnd( std::size_t segmentIndex ) const;
+	SPointPos* getPointsBegin( std::size_t segmentIndex );
+	SPointPos* getPointsEnd( std::size_t segmentIndex );
+
+	// points appended since the last segment was closed
+	std::size_t getOpenPointsCount() const;
+	void closeSegment( int roadClassIndex );
+	void dropOpenPoints();
+
+	// appends the segments starting from firstSegment
+	void append( const SSegments& segments, std::size_t firstSegment = 0 );
 
-	int d_roadClassIndex;
 	segment_points_t d_points;
+	point_offsets_t d_offsets;
+	road_class_indexes_t d_roadClassIndexes;
 };
 
-using segments_t = std::vector< SSegment >;
-using segments_it = segments_t::iterator;
-using segments_cit = segments_t::const_iterator;
-
 class segment_id_t : public id_handle_t
 {
 	public:
@@ -189,40 +267,40 @@ using sect_pos_ids_cit = sect_pos_ids_t::const_iterator;
 
 // ----------------------------------------------------------------------------
 
+/*
+	like SPointPos there is no id stored, it is implied by the position in
+	interval_section_positions_t (vide KSegmentsManager::getSectPosId)
+*/
 struct SSectionPos
 {
-	SSectionPos(
-		const sect_pos_id_t sectposid,
-		const SPoint& point );
+	explicit SSectionPos( const SPoint& point );
 
-	sect_pos_id_t d_id;
-	SPoint d_point;
+	decoded_point_t getPoint() const;
+
+	stored_point_t d_point;
 
 };
 
+inline decoded_point_t SSectionPos::getPoint() const
+{
+#ifdef ENABLE_TILED_POINTS
+	return d_point.decode();
+#else
+	return d_point;
+#endif
+}
+
 using section_positions_t = std::vector< const SSectionPos* >;
 using section_positions_it = section_positions_t::iterator;
 using section_positions_cit = section_positions_t::const_iterator;
 
-// ----------------------------------------------------------------------------
-
-struct SIntervalSection
-{
-	SIntervalSection(
-		const section_id_t sectid,
-		const SSectionPos& begin,
-		const SSectionPos& end );
-
-	bool hasOrientation( EOrientation orientation ) const;
-
-	section_id_t d_sectid;
-	SSectionPos d_begin;
-	SSectionPos d_end;
-};
-
-using interval_sections_t = std::vector< SIntervalSection >;
-using interval_sections_it = interval_sections_t::iterator;
-using interval_sections_cit = interval_sections_t::const_iterator;
+/*
+	the beginning and the end of each interval section one after another,
+	so the index of the position is just its sect_pos_id_t
+*/
+using interval_section_positions_t = std::vector< SSectionPos >;
+using interval_section_positions_it = interval_section_positions_t::iterator;
+using interval_section_positions_cit = interval_section_positions_t::const_iterator;
 
 // ----------------------------------------------------------------------------
 
@@ -243,8 +321,8 @@ struct SSection
 {
 	SSection();
 	int d_roadClassIndex;
-	const SPoint* d_begin;
-	const SPoint* d_end;
+	SPoint d_begin;
+	SPoint d_end;
 };
 
 // ----------------------------------------------------------------------------
@@ -262,6 +340,26 @@ struct SViewData
 	int d_zoomFactor;
 };
 
+// ----------------------------------------------------------------------------
+
+/*
+	buffers of the selection owned by its caller and reused by the frames,
+	once they have grown to the size of the views they don't allocate
+	anymore (vide KController)
+*/
+struct SSelectionBuffers
+{
+	void clear();
+
+	point_ids_t d_pointids;
+	sect_pos_ids_t d_sectposids;
+	// the horizontal interval sections passing the left axis above the
+	// viewport (vide KIntervalTree::selectSectPositions)
+	sect_pos_ids_t d_crosssectposids;
+	// the result
+	section_ids_t d_sections;
+};
+
 } // namespace be
 
 #endif
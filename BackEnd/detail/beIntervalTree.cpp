@@ -4,6 +4,8 @@
 #include "beSegmentsManager.h"
 #include "beViewportArea.h"
 #include "beTreeUtils.h"
+#include "beIndexImage.h"
+#include "beArena.h"
 #include "beUtils.h"
 #include "beConfig.h"
 
@@ -13,167 +15,136 @@ namespace be
 namespace
 {
 
-struct SHeapItem;
-struct SHeapNode;
-struct SHeapLeaf;
-
-class KHeapItemVisitor
+/*
+	the heaps (priority search trees) of the nodes of the interval trees are
+	implicit, the items of all of them lie in one array (vide SHeaps) in
+	preorder; the shape of a heap is implied by its size: the root takes
+	the first item and the rest is split at the median (vide KHeapBuilder),
+	the left child starts right after the root and takes the greater half
+	of the rest, the right child follows it, so each subtree is a continuous
+	range of the array
+*/
+struct SHeapItem
 {
-	protected:
-		KHeapItemVisitor() = default;
-
-	public:
-		virtual ~KHeapItemVisitor() = default;
-
-	public:
-		virtual void visitNode( SHeapNode* node );
-		virtual void visitLeaf( SHeapLeaf* leaf );
-		virtual void visitDefault( SHeapItem* item );
-
+	// ids of the position and of the median of the children (vide
+	// KSegmentsManager::getSectPosId), the median of a leaf is not used
+	std::uint32_t d_sectPosId;
+	std::uint32_t d_medianId;
 };
 
+using heap_items_t = std::vector< SHeapItem >;
+
 // ----------------------------------------------------------------------------
 
-struct SHeapItem
+// subtree of a heap, the index of its root and the count of its items
+struct SHeapRange
 {
-	protected:
-		explicit SHeapItem( const SSectionPos* sectpos );
+	SHeapRange();
+	SHeapRange(
+		std::size_t begin,
+		std::size_t count );
 
-	public:
-		virtual ~SHeapItem() = default;
+	bool isEmpty() const;
+	bool isLeaf() const;
 
-	public:
-		virtual SHeapItem* getLeftChild() = 0;
-		virtual SHeapItem* getRightChild() = 0;
-		virtual const SSectionPos* getMedian() = 0;
+	SHeapRange getLeftChild() const;
+	SHeapRange getRightChild() const;
 
-		virtual void accept( KHeapItemVisitor* visitor ) = 0;
+	std::size_t getEnd() const;
 
-	public:
-		const SSectionPos* d_sectpos;
+	std::uint32_t d_begin;
+	std::uint32_t d_count;
 };
 
-SHeapItem::SHeapItem( const SSectionPos* sectpos )
-	: d_sectpos( sectpos )
+SHeapRange::SHeapRange()
+	: d_begin( 0 )
+	, d_count( 0 )
 {
 }
 
-// ----------------------------------------------------------------------------
-
-struct SHeapNode : public SHeapItem
-{
-	public:
-		SHeapNode(
-			const SSectionPos* sectpos,
-			const SSectionPos* median );
-		~SHeapNode() override;
-
-	public:
-		SHeapItem* getLeftChild() override;
-		SHeapItem* getRightChild() override;
-		const SSectionPos* getMedian() override;
-
-		void accept( KHeapItemVisitor* visitor ) override;
-
-	public:
-		const SSectionPos* d_median;
-		SHeapItem* d_leftChild;
-		SHeapItem* d_rightChild;
-
-};
-
-SHeapNode::SHeapNode(
-	const SSectionPos* sectpos,
-	const SSectionPos* median )
-	: SHeapItem( sectpos )
-	, d_median( median )
-	, d_leftChild( nullptr )
-	, d_rightChild( nullptr )
+SHeapRange::SHeapRange(
+	const std::size_t begin,
+	const std::size_t count )
+	: d_begin( static_cast< std::uint32_t >( begin ) )
+	, d_count( static_cast< std::uint32_t >( count ) )
 {
 }
 
-SHeapNode::~SHeapNode()
+inline bool SHeapRange::isEmpty() const
 {
-	delete d_leftChild;
-	delete d_rightChild;
+	return d_count == 0;
 }
 
-SHeapItem* SHeapNode::getLeftChild()
+inline bool SHeapRange::isLeaf() const
 {
-	return d_leftChild;
+	return d_count == 1;
 }
 
-SHeapItem* SHeapNode::getRightChild()
+inline SHeapRange SHeapRange::getLeftChild() const
 {
-	return d_rightChild;
+	assert( !isEmpty() );
+	const std::size_t childrenCount = d_count - 1;
+	const SHeapRange result( d_begin + 1, ( childrenCount + 1 ) / 2 );
+	return result;
 }
 
-const SSectionPos* SHeapNode::getMedian()
+inline SHeapRange SHeapRange::getRightChild() const
 {
-	return d_median;
+	assert( !isEmpty() );
+	const std::size_t childrenCount = d_count - 1;
+	const std::size_t leftCount = ( childrenCount + 1 ) / 2;
+	const SHeapRange result( d_begin + 1 + leftCount, childrenCount - leftCount );
+	return result;
 }
 
-void SHeapNode::accept( KHeapItemVisitor* visitor )
+inline std::size_t SHeapRange::getEnd() const
 {
-	visitor->visitNode( this );
+	return d_begin + d_count;
 }
 
 // ----------------------------------------------------------------------------
 
-struct SHeapLeaf : public SHeapItem
+// the heaps of both interval trees, the positions are kept as ids, so they
+// take half of the memory of pointers on 64-bit targets
+struct SHeaps
 {
-	public:
-		explicit SHeapLeaf( const SSectionPos* sectpos );
+	explicit SHeaps( const KSegmentsManager& segmentsManager );
 
-	public:
-		SHeapItem* getLeftChild() override;
-		SHeapItem* getRightChild() override;
-		const SSectionPos* getMedian() override;
+	const SSectionPos* getSectPos( const SHeapRange& heap ) const;
+	const SSectionPos* getMedian( const SHeapRange& heap ) const;
+	std::uint32_t getSectPosId( const SSectionPos* sectpos ) const;
 
-		void accept( KHeapItemVisitor* visitor ) override;
+	std::size_t getMemorySize() const;
 
+	const SSectionPos* d_sectPositions;
+	heap_items_t d_items;
 };
 
-SHeapLeaf::SHeapLeaf( const SSectionPos* sectpos )
-	: SHeapItem( sectpos )
-{
-}
-
-SHeapItem* SHeapLeaf::getLeftChild()
-{
-	return nullptr;
-}
-
-SHeapItem* SHeapLeaf::getRightChild()
+SHeaps::SHeaps( const KSegmentsManager& segmentsManager )
+	: d_sectPositions( segmentsManager.getSectionPosArray() )
 {
-	return nullptr;
 }
 
-const SSectionPos* SHeapLeaf::getMedian()
+inline const SSectionPos* SHeaps::getSectPos( const SHeapRange& heap ) const
 {
-	return nullptr;
+	return d_sectPositions + d_items[ heap.d_begin ].d_sectPosId;
 }
 
-void SHeapLeaf::accept( KHeapItemVisitor* visitor )
-{
-	visitor->visitLeaf( this );
-}
-
-// ----------------------------------------------------------------------------
-
-void KHeapItemVisitor::visitNode( SHeapNode* node )
+inline const SSectionPos* SHeaps::getMedian( const SHeapRange& heap ) const
 {
-	visitDefault( node );
+	assert( !heap.isEmpty() && !heap.isLeaf() );
+	return d_sectPositions + d_items[ heap.d_begin ].d_medianId;
 }
 
-void KHeapItemVisitor::visitLeaf( SHeapLeaf* leaf )
+inline std::uint32_t SHeaps::getSectPosId( const SSectionPos* sectpos ) const
 {
-	visitDefault( leaf );
+	return static_cast< std::uint32_t >( sectpos - d_sectPositions );
 }
 
-void KHeapItemVisitor::visitDefault( SHeapItem* /*item*/ )
+std::size_t SHeaps::getMemorySize() const
 {
-	assert( !"unsupported item" );
+	const std::size_t result = utils::get_memory_size( d_items );
+	return result;
 }
 
 // ----------------------------------------------------------------------------
@@ -215,7 +186,7 @@ struct find_max_element
 
 // ----------------------------------------------------------------------------
 
-// returns true if 'item' is on the left/top side according to 'position'
+// returns true if 'sectpos' is on the left/top side according to 'position'
 template< typename comparator, typename position_t >
 struct is_in_left_top_side_range
 {
@@ -224,9 +195,8 @@ struct is_in_left_top_side_range
 	{
 	}
 
-	bool operator()( const SHeapItem* item ) const
+	bool operator()( const SSectionPos* sectpos ) const
 	{
-		const SSectionPos* sectpos = item->d_sectpos;
 		const bool result = comparator()( sectpos, d_position );
 		return result;
 	}
@@ -234,7 +204,7 @@ struct is_in_left_top_side_range
 	const position_t& d_position;
 };
 
-// returns true if 'item' is on the right/bottom side according to 'position'
+// returns true if 'sectpos' is on the right/bottom side according to 'position'
 template< typename comparator, typename position_t >
 struct is_in_right_bottom_side_range
 {
@@ -243,9 +213,8 @@ struct is_in_right_bottom_side_range
 	{
 	}
 
-	bool operator()( const SHeapItem* item ) const
+	bool operator()( const SSectionPos* sectpos ) const
 	{
-		const SSectionPos* sectpos = item->d_sectpos;
 		const bool result = comparator()( d_position, sectpos );
 		return result;
 	}
@@ -281,31 +250,32 @@ struct SCheckResult
 };
 
 template< typename traits >
-class KCheckHeapConsistency : public KHeapItemVisitor
+class KCheckHeapConsistency
 {
 	public:
 		KCheckHeapConsistency(
-			const SHeapNode* parent,
-			EChildSide childSide,
+			const SHeaps& heaps,
 			SCheckResult* result );
 
 	public:
 		static bool run(
-			SHeapItem* heapRoot,
+			const SHeaps& heaps,
+			const SHeapRange& heapRoot,
 			const section_positions_t& sect_positions );
 
-	public:
-		void visitNode( SHeapNode* node ) override;
-		void visitDefault( SHeapItem* item ) override;
-
 	private:
-		void checkPosAgainstParent( SHeapItem* item );
-		void updatePointPosSet( SHeapItem* item );
+		void checkItem(
+			const SHeapRange& item,
+			const SHeapRange& parent,
+			EChildSide childSide );
+		void checkPosAgainstParent(
+			const SHeapRange& item,
+			const SHeapRange& parent,
+			EChildSide childSide );
+		void updatePointPosSet( const SHeapRange& item );
 
 	private:
-		const SHeapNode* d_parent;
-		const EChildSide d_childSide;
-
+		const SHeaps& d_heaps;
 		SCheckResult* d_result;
 
 };
@@ -314,27 +284,26 @@ class KCheckHeapConsistency : public KHeapItemVisitor
 
 template< typename traits >
 KCheckHeapConsistency< traits >::KCheckHeapConsistency(
-	const SHeapNode* parent,
-	EChildSide childSide,
+	const SHeaps& heaps,
 	SCheckResult* result )
-	: d_parent( parent )
-	, d_childSide( childSide )
+	: d_heaps( heaps )
 	, d_result( result )
 {
 }
 
 template< typename traits >
 bool KCheckHeapConsistency< traits >::run(
-	SHeapItem* heapRoot,
+	const SHeaps& heaps,
+	const SHeapRange& heapRoot,
 	const section_positions_t& sect_positions )
 {
 	bool result = true;
 	#ifdef ENABLE_TREE_CHECKERS
-	if ( heapRoot != nullptr )
+	if ( !heapRoot.isEmpty() )
 	{
 		SCheckResult checkResult( sect_positions );
-		KCheckHeapConsistency< traits > checkConsistency( nullptr, NoParent, &checkResult );
-		heapRoot->accept( &checkConsistency );
+		KCheckHeapConsistency< traits > checkConsistency( heaps, &checkResult );
+		checkConsistency.checkItem( heapRoot, SHeapRange(), NoParent );
 		result = checkResult.d_consistent && checkResult.d_sectpos_set.empty();
 		assert( result ); // stopping assertion
 	}
@@ -343,51 +312,45 @@ bool KCheckHeapConsistency< traits >::run(
 }
 
 template< typename traits >
-void KCheckHeapConsistency< traits >::visitNode( SHeapNode* node )
+void KCheckHeapConsistency< traits >::checkItem(
+	const SHeapRange& item,
+	const SHeapRange& parent,
+	const EChildSide childSide )
 {
-	visitDefault( node );
-
-	SHeapItem* leftChild = node->getLeftChild();
-	if ( leftChild )
-	{
-		KCheckHeapConsistency< traits > checkConsistency( node, LeftChild, d_result );
-		leftChild->accept( &checkConsistency );
-	}
+	checkPosAgainstParent( item, parent, childSide );
+	updatePointPosSet( item );
 
-	SHeapItem* rightChild = node->getRightChild();
-	if ( rightChild )
-	{
-		KCheckHeapConsistency< traits > checkConsistency( node, RightChild, d_result );
-		rightChild->accept( &checkConsistency );
-	}
-}
+	const SHeapRange leftChild = item.getLeftChild();
+	if ( !leftChild.isEmpty() )
+		checkItem( leftChild, item, LeftChild );
 
-template< typename traits >
-void KCheckHeapConsistency< traits >::visitDefault( SHeapItem* item )
-{
-	checkPosAgainstParent( item );
-	updatePointPosSet( item );
+	const SHeapRange rightChild = item.getRightChild();
+	if ( !rightChild.isEmpty() )
+		checkItem( rightChild, item, RightChild );
 }
 
 template< typename traits >
-void KCheckHeapConsistency< traits >::checkPosAgainstParent( SHeapItem* item )
+void KCheckHeapConsistency< traits >::checkPosAgainstParent(
+	const SHeapRange& item,
+	const SHeapRange& parent,
+	const EChildSide childSide )
 {
-	if ( d_parent )
+	if ( childSide != NoParent )
 	{
 		bool consistent = true;
-		const SSectionPos* parentPos = d_parent->d_sectpos;
-		if ( typename traits::is_in_1st_dim_range( parentPos )( item ) )
+		const SSectionPos* parentPos = d_heaps.getSectPos( parent );
+		const SSectionPos* itemPos = d_heaps.getSectPos( item );
+		if ( typename traits::is_in_1st_dim_range( parentPos )( itemPos ) )
 		{
-			const SSectionPos* median = d_parent->d_median;
-			const SSectionPos* itemPos = item->d_sectpos;
-			if ( d_childSide == LeftChild )
+			const SSectionPos* median = d_heaps.getMedian( parent );
+			if ( childSide == LeftChild )
 			{
 				if ( ! typename traits::compare_by_2nd_dim()( itemPos, median ) && ( itemPos != median ) )
 					consistent = false;
 			}
 			else
 			{
-				assert( d_childSide == RightChild );
+				assert( childSide == RightChild );
 				if ( ! typename traits::compare_by_2nd_dim()( median, itemPos ) )
 					consistent = false;
 			}
@@ -406,10 +369,10 @@ void KCheckHeapConsistency< traits >::checkPosAgainstParent( SHeapItem* item )
 }
 
 template< typename traits >
-void KCheckHeapConsistency< traits >::updatePointPosSet( SHeapItem* item )
+void KCheckHeapConsistency< traits >::updatePointPosSet( const SHeapRange& item )
 {
 	sectpos_set_t& sectpos_set = d_result->d_sectpos_set;
-	const SSectionPos* sectPos = item->d_sectpos;
+	const SSectionPos* sectPos = d_heaps.getSectPos( item );
 	auto it = d_result->d_sectpos_set.find( sectPos );
 	assert( it != sectpos_set.end() );
 	sectpos_set.erase( it );
@@ -427,27 +390,28 @@ struct SHeapBuilderTraits
 	using compare_by_2nd_dim = compare_by_2nd_dim_t;
 };
 
+// appends the heap to SHeaps in preorder
 template< typename traits >
 class KHeapBuilder
 {
 	public:
-		KHeapBuilder() = default;
+		explicit KHeapBuilder( SHeaps* heaps );
 
 	public:
-		SHeapItem* run(
+		SHeapRange run(
 			section_positions_it begin,
 			section_positions_it end );
 
 	private:
-		SHeapItem* createItem(
+		void createItem(
 			section_positions_it begin,
 			section_positions_it end );
 
-		SHeapItem* createNode(
+		void createNode(
 			section_positions_it begin,
 			section_positions_it end );
 
-		SHeapItem* createLeaf(
+		void createLeaf(
 			const SSectionPos* sectpos );
 
 	private:
@@ -458,45 +422,55 @@ class KHeapBuilder
 			section_positions_it* begin,
 			section_positions_it* end );
 
+	private:
+		SHeaps& d_heaps;
+
 };
 
 // ----------------------------------------------------------------------------
 
 template< typename traits >
-SHeapItem* KHeapBuilder< traits >::run(
+KHeapBuilder< traits >::KHeapBuilder( SHeaps* heaps )
+	: d_heaps( *heaps )
+{
+}
+
+template< typename traits >
+SHeapRange KHeapBuilder< traits >::run(
 	section_positions_it begin,
 	section_positions_it end )
 {
 	std::sort( begin, end, typename traits::compare_by_2nd_dim() );
 	assert( std::adjacent_find( begin, end ) == end ); // items should be unique
 
-	SHeapItem* root = createItem( begin, end );
-	return root;
+	const std::size_t rootIndex = d_heaps.d_items.size();
+	createItem( begin, end );
+	const SHeapRange result( rootIndex, d_heaps.d_items.size() - rootIndex );
+	assert( result.d_count == static_cast< std::size_t >( std::distance( begin, end ) ) );
+	return result;
 }
 
 // ----------------------------------------------------------------------------
 
 template< typename traits >
-SHeapItem* KHeapBuilder< traits >::createItem(
+void KHeapBuilder< traits >::createItem(
 	section_positions_it begin,
 	section_positions_it end )
 {
-	SHeapItem* result = nullptr;
 	const std::size_t sectPosCount = std::distance( begin, end );
 	if ( 1 < sectPosCount )
 	{
-		result = createNode( begin, end);
+		createNode( begin, end);
 	}
 	else if ( sectPosCount == 1 )
 	{
 		const SSectionPos* sectpos = *begin;
-		result = createLeaf( sectpos );
+		createLeaf( sectpos );
 	}
-	return result;
 }
 
 template< typename traits >
-SHeapItem* KHeapBuilder< traits >::createNode(
+void KHeapBuilder< traits >::createNode(
 	section_positions_it raw_begin,
 	section_positions_it raw_end )
 {
@@ -511,24 +485,26 @@ SHeapItem* KHeapBuilder< traits >::createNode(
 
 	assert( utils::is_sorted( begin, end, typename traits::compare_by_2nd_dim() ) );
 
+	// the left child takes the greater half (vide SHeapRange::getLeftChild)
 	auto median_it = utils::get_median( begin, end );
 	const SSectionPos* medianSectPos = *median_it;
 
-	auto node = new SHeapNode( subtreeRootSectPos, medianSectPos );
+	const SHeapItem node{ d_heaps.getSectPosId( subtreeRootSectPos ), d_heaps.getSectPosId( medianSectPos ) };
+	d_heaps.d_items.push_back( node );
 
 	auto lend = median_it + 1;
-	node->d_leftChild = createItem( begin, lend );
+	createItem( begin, lend );
 
 	auto rbegin = lend;
-	node->d_rightChild = createItem( rbegin, end );
-
-	return node;
+	createItem( rbegin, end );
 }
 
 template< typename traits >
-SHeapItem* KHeapBuilder< traits >::createLeaf( const SSectionPos* sectpos )
+void KHeapBuilder< traits >::createLeaf( const SSectionPos* sectpos )
 {
-	return new SHeapLeaf( sectpos );
+	const std::uint32_t sectPosId = d_heaps.getSectPosId( sectpos );
+	const SHeapItem leaf{ sectPosId, sectPosId };
+	d_heaps.d_items.push_back( leaf );
 }
 
 // ----------------------------------------------------------------------------
@@ -591,9 +567,6 @@ struct SIntervalTreeItem
 	protected:
 		SIntervalTreeItem() = default;
 
-	public:
-		virtual ~SIntervalTreeItem() = default;
-
 	public:
 		virtual SIntervalTreeItem* getLeftChild() = 0;
 		virtual SIntervalTreeItem* getRightChild() = 0;
@@ -608,7 +581,6 @@ struct SIntervalTreeNode : public SIntervalTreeItem
 {
 	public:
 		explicit SIntervalTreeNode( const SSectionPos* medSectPos );
-		~SIntervalTreeNode() override;
 
 	public:
 		SIntervalTreeItem* getLeftChild() override;
@@ -618,8 +590,8 @@ struct SIntervalTreeNode : public SIntervalTreeItem
 
 	public:
 		const SSectionPos* d_medSectPos;
-		SHeapItem* d_medSectPositionsOnLeftTop;
-		SHeapItem* d_medSectPositionsOnRightBottom;
+		SHeapRange d_medSectPositionsOnLeftTop;
+		SHeapRange d_medSectPositionsOnRightBottom;
 		SIntervalTreeItem* d_leftChild;
 		SIntervalTreeItem* d_rightChild;
 
@@ -627,21 +599,11 @@ struct SIntervalTreeNode : public SIntervalTreeItem
 
 SIntervalTreeNode::SIntervalTreeNode( const SSectionPos* medSectPos )
 	: d_medSectPos( medSectPos )
-	, d_medSectPositionsOnLeftTop(nullptr )
-	, d_medSectPositionsOnRightBottom( nullptr )
 	, d_leftChild( nullptr )
 	, d_rightChild( nullptr )
 {
 }
 
-SIntervalTreeNode::~SIntervalTreeNode()
-{
-	delete d_medSectPositionsOnLeftTop;
-	delete d_medSectPositionsOnRightBottom;
-	delete d_leftChild;
-	delete d_rightChild;
-}
-
 SIntervalTreeItem* SIntervalTreeNode::getLeftChild()
 {
 	return d_leftChild;
@@ -684,7 +646,6 @@ SIntervalTreeLeaf::SIntervalTreeLeaf(
 	: d_beginSectPos( beginSectPos )
 	, d_endSectPos( endSectPos )
 {
-	assert( KSegmentsManager::isSection( beginSectPos, endSectPos ) );
 }
 
 SIntervalTreeItem* SIntervalTreeLeaf::getLeftChild()
@@ -722,46 +683,19 @@ void KIntervalTreeItemVisitor::visitDefault( SIntervalTreeItem* /*item*/ )
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
-class KTraverseHeap : public KHeapItemVisitor
+// the items of the heaps are continuous, so no need to traverse them like trees
+void eraseHeapItems(
+	const SHeaps& heaps,
+	const SHeapRange& heap,
+	sectpos_set_t* sectpos_set )
 {
-	public:
-		explicit KTraverseHeap( sectpos_set_t* sectpos_set );
-
-	public:
-		void visitNode( SHeapNode* node ) override;
-		void visitDefault( SHeapItem* item ) override;
-
-	private:
-		sectpos_set_t* d_sectpos_set;
-
-};
-
-// ----------------------------------------------------------------------------
-
-KTraverseHeap::KTraverseHeap( sectpos_set_t* sectpos_set )
-	: d_sectpos_set( sectpos_set )
-{
-}
-
-void KTraverseHeap::visitNode( SHeapNode* node )
-{
-	visitDefault( node );
-
-	SHeapItem* leftChild = node->getLeftChild();
-	if ( leftChild )
-		leftChild->accept( this );
-
-	SHeapItem* rightChild = node->getRightChild();
-	if ( rightChild )
-		rightChild->accept( this );
-}
-
-void KTraverseHeap::visitDefault( SHeapItem* item )
-{
-	const SSectionPos* itemPos = item->d_sectpos;
-	auto it = d_sectpos_set->find( itemPos );
-	assert( it != d_sectpos_set->end() );
-	d_sectpos_set->erase( it );
+	for ( std::size_t i = heap.d_begin; i != heap.getEnd(); ++i )
+	{
+		const SSectionPos* itemPos = heaps.getSectPos( SHeapRange( i, 1 ) );
+		auto it = sectpos_set->find( itemPos );
+		assert( it != sectpos_set->end() );
+		sectpos_set->erase( it );
+	}
 }
 
 // ----------------------------------------------------------------------------
@@ -781,12 +715,14 @@ class KCheckIntervalTreeConsistency : public KIntervalTreeItemVisitor
 {
 	public:
 		KCheckIntervalTreeConsistency(
+			const SHeaps& heaps,
 			const SIntervalTreeNode* parent,
 			EChildSide childSide,
 			SCheckResult* result );
 
 	public:
 		static bool run(
+			const SHeaps& heaps,
 			SIntervalTreeItem* root,
 			const section_positions_t& sect_positions );
 
@@ -800,6 +736,7 @@ class KCheckIntervalTreeConsistency : public KIntervalTreeItemVisitor
 		void updatePointPosSet( const SSectionPos* sectPos );
 
 	private:
+		const SHeaps& d_heaps;
 		const SIntervalTreeNode* d_parent;
 		const EChildSide d_childSide;
 
@@ -811,10 +748,12 @@ class KCheckIntervalTreeConsistency : public KIntervalTreeItemVisitor
 
 template< typename traits >
 KCheckIntervalTreeConsistency< traits >::KCheckIntervalTreeConsistency(
+	const SHeaps& heaps,
 	const SIntervalTreeNode* parent,
 	EChildSide childSide,
 	SCheckResult* result )
-	: d_parent( parent )
+	: d_heaps( heaps )
+	, d_parent( parent )
 	, d_childSide( childSide )
 	, d_result( result )
 {
@@ -822,6 +761,7 @@ KCheckIntervalTreeConsistency< traits >::KCheckIntervalTreeConsistency(
 
 template< typename traits >
 bool KCheckIntervalTreeConsistency< traits >::run(
+	const SHeaps& heaps,
 	SIntervalTreeItem* root,
 	const section_positions_t& sect_positions )
 {
@@ -830,7 +770,7 @@ bool KCheckIntervalTreeConsistency< traits >::run(
 	if ( root != nullptr )
 	{
 		SCheckResult checkResult( sect_positions );
-		KCheckIntervalTreeConsistency< traits > checkConsistency( nullptr, NoParent, &checkResult );
+		KCheckIntervalTreeConsistency< traits > checkConsistency( heaps, nullptr, NoParent, &checkResult );
 		root->accept( &checkConsistency );
 		result = checkResult.d_consistent && checkResult.d_sectpos_set.empty();
 		assert( result ); // stopping assertion
@@ -849,14 +789,14 @@ void KCheckIntervalTreeConsistency< traits >::visitNode( SIntervalTreeNode* node
 	SIntervalTreeItem* leftChild = node->getLeftChild();
 	if ( leftChild )
 	{
-		KCheckIntervalTreeConsistency< traits > checkConsistency( node, LeftChild, d_result );
+		KCheckIntervalTreeConsistency< traits > checkConsistency( d_heaps, node, LeftChild, d_result );
 		leftChild->accept( &checkConsistency );
 	}
 
 	SIntervalTreeItem* rightChild = node->getRightChild();
 	if ( rightChild )
 	{
-		KCheckIntervalTreeConsistency< traits > checkConsistency( node, RightChild, d_result );
+		KCheckIntervalTreeConsistency< traits > checkConsistency( d_heaps, node, RightChild, d_result );
 		rightChild->accept( &checkConsistency );
 	}
 }
@@ -903,15 +843,8 @@ void KCheckIntervalTreeConsistency< traits >::checkPosAgainstParent( const SSect
 template< typename traits >
 void KCheckIntervalTreeConsistency< traits >::checkNodeHeaps( SIntervalTreeNode* node )
 {
-	KTraverseHeap traverseHeap( &d_result->d_sectpos_set );
-
-	SHeapItem* medSectPositionsOnLeftTop = node->d_medSectPositionsOnLeftTop;
-	if ( medSectPositionsOnLeftTop )
-		medSectPositionsOnLeftTop->accept( &traverseHeap );
-
-	SHeapItem* medSectPositionsOnRightBottom = node->d_medSectPositionsOnRightBottom;
-	if ( medSectPositionsOnRightBottom )
-		medSectPositionsOnRightBottom->accept( &traverseHeap );
+	eraseHeapItems( d_heaps, node->d_medSectPositionsOnLeftTop, &d_result->d_sectpos_set );
+	eraseHeapItems( d_heaps, node->d_medSectPositionsOnRightBottom, &d_result->d_sectpos_set );
 }
 
 template< typename traits >
@@ -940,7 +873,10 @@ template< typename traits >
 class KIntervalTreeBuilder
 {
 	public:
-		explicit KIntervalTreeBuilder( const KSegmentsManager& segmentsManager );
+		KIntervalTreeBuilder(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena,
+			SHeaps* heaps );
 
 	public:
 		SIntervalTreeItem* run( const section_positions_t& sect_positions_by_1st_dim );
@@ -963,7 +899,7 @@ class KIntervalTreeBuilder
 			const SSectionPos* medianSectPos,
 			section_positions_t* medSectPositionsOnLeftTop,
 			section_positions_t* sectPositionsOutOnLeftTop ) const;
-		SHeapItem* createHeapMedSectPositionsOnLeftTop(
+		SHeapRange createHeapMedSectPositionsOnLeftTop(
 			section_positions_t* medSectPositionsOnLeftTop ) const;
 
 		void prepareNodeRightSide(
@@ -972,19 +908,26 @@ class KIntervalTreeBuilder
 			const SSectionPos* medianSectPos,
 			section_positions_t* medSectPositionsOnRightBottom,
 			section_positions_t* sectPositionsOutOnRightBottom ) const;
-		SHeapItem* createHeapMedSectPositionsOnRightBottom(
+		SHeapRange createHeapMedSectPositionsOnRightBottom(
 			section_positions_t* medSectPositionsOnRightBottom ) const;
 
 	private:
 		const KSegmentsManager& d_segmentsManager;
+		KArena* d_arena;
+		SHeaps* d_heaps;
 
 };
 
 // ----------------------------------------------------------------------------
 
 template< typename traits >
-KIntervalTreeBuilder< traits >::KIntervalTreeBuilder( const KSegmentsManager& segmentsManager )
+KIntervalTreeBuilder< traits >::KIntervalTreeBuilder(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena,
+	SHeaps* heaps )
 	: d_segmentsManager( segmentsManager )
+	, d_arena( arena )
+	, d_heaps( heaps )
 {
 }
 
@@ -1029,7 +972,7 @@ SIntervalTreeItem* KIntervalTreeBuilder< traits >::createNode( const section_pos
 	assert( median_node_it != sect_positions_by_1st_dim.end() );
 
 	const SSectionPos* medianSectPos = *median_node_it;
-	auto node = new SIntervalTreeNode( medianSectPos );
+	auto node = d_arena->create< SIntervalTreeNode >( medianSectPos );
 
 	auto lbegin = begin;
 	auto lend = median_node_it;
@@ -1065,7 +1008,8 @@ SIntervalTreeItem* KIntervalTreeBuilder< traits >::createLeaf(
 	const SSectionPos* beginSectPos,
 	const SSectionPos* endSectPos )
 {
-	return new SIntervalTreeLeaf( beginSectPos, endSectPos );
+	assert( d_segmentsManager.isSection( beginSectPos, endSectPos ) );
+	return d_arena->create< SIntervalTreeLeaf >( beginSectPos, endSectPos );
 }
 
 // ----------------------------------------------------------------------------
@@ -1092,7 +1036,7 @@ void KIntervalTreeBuilder< traits >::prepareNodeLeftSide(
 }
 
 template< typename traits >
-SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnLeftTop(
+SHeapRange KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnLeftTop(
 	section_positions_t* medSectPositionsOnLeftTop ) const
 {
 	#ifndef NDEBUG
@@ -1105,10 +1049,10 @@ SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnLeftTop(
 		find_min_element< typename traits::compare_by_1st_dim >
 		, typename traits::compare_by_2nd_dim
 		>;
-	KHeapBuilder< builder_traits_t > heapBuilder;
+	KHeapBuilder< builder_traits_t > heapBuilder( d_heaps );
 	section_positions_it begin = medSectPositionsOnLeftTop->begin();
 	section_positions_it end = medSectPositionsOnLeftTop->end();
-	SHeapItem* heapRoot = heapBuilder.run( begin, end );
+	const SHeapRange heapRoot = heapBuilder.run( begin, end );
 
 	using is_behind_parent_t = is_in_right_bottom_side_range<
 		typename traits::compare_by_1st_dim,
@@ -1116,7 +1060,7 @@ SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnLeftTop(
 	using checker_traits_t = SCheckHeapConsistencyTraits<
 		is_behind_parent_t,
 		typename traits::compare_by_2nd_dim >;
-	assert( KCheckHeapConsistency< checker_traits_t >::run( heapRoot, medSectPositionsOnLeftTopCopy ) );
+	assert( KCheckHeapConsistency< checker_traits_t >::run( *d_heaps, heapRoot, medSectPositionsOnLeftTopCopy ) );
 
 	return heapRoot;
 }
@@ -1143,7 +1087,7 @@ void KIntervalTreeBuilder< traits >::prepareNodeRightSide(
 }
 
 template< typename traits >
-SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnRightBottom(
+SHeapRange KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnRightBottom(
 	section_positions_t* medSectPositionsOnRightBottom ) const
 {
 	#ifndef NDEBUG
@@ -1156,10 +1100,10 @@ SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnRightBott
 		find_max_element< typename traits::compare_by_1st_dim >
 		, typename traits::compare_by_2nd_dim
 		>;
-	KHeapBuilder< builder_traits_t > heapBuilder;
+	KHeapBuilder< builder_traits_t > heapBuilder( d_heaps );
 	section_positions_it begin = medSectPositionsOnRightBottom->begin();
 	section_positions_it end = medSectPositionsOnRightBottom->end();
-	SHeapItem* heapRoot = heapBuilder.run( begin, end );
+	const SHeapRange heapRoot = heapBuilder.run( begin, end );
 
 	using is_in_front_of_parent_t = is_in_left_top_side_range<
 		typename traits::compare_by_1st_dim,
@@ -1167,7 +1111,7 @@ SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnRightBott
 	using checker_traits_t = SCheckHeapConsistencyTraits<
 		is_in_front_of_parent_t,
 		typename traits::compare_by_2nd_dim >;
-	assert( KCheckHeapConsistency< checker_traits_t >::run( heapRoot, medSectPositionsOnRightBottomCopy ) );
+	assert( KCheckHeapConsistency< checker_traits_t >::run( *d_heaps, heapRoot, medSectPositionsOnRightBottomCopy ) );
 
 	return heapRoot;
 }
@@ -1178,395 +1122,227 @@ SHeapItem* KIntervalTreeBuilder< traits >::createHeapMedSectPositionsOnRightBott
 template<
 	typename is_in_1st_dim_range_t,
 	typename compare_by_2nd_dim_t >
-struct SFindSplitNodeTraits
+struct SSelectHeapSectPositionsTraits
 {
 	using is_in_1st_dim_range = is_in_1st_dim_range_t;
 	using compare_by_2nd_dim = compare_by_2nd_dim_t;
 };
 
+/*
+	selects the positions of the heap within the range of the 2nd dim and in
+	front of (or behind) the axis: it looks for the split node of the range
+	by the medians, then goes down both sides of it, the subtrees between
+	them are within the range, so they are just dumped; all the loops are
+	over SHeapRange, without calls through pointers
+*/
 template< typename traits >
-class KFindSplitNode : public KHeapItemVisitor
+class KSelectHeapSectPositions
 {
 	public:
-		KFindSplitNode(
-			const KViewportArea& viewportArea,
+		KSelectHeapSectPositions(
+			const SHeaps& heaps,
 			const SViewportBorder& axis,
 			const SViewportBorder& min2ndDimEdge,
 			const SViewportBorder& max2ndDimEdge,
 			sect_pos_ids_t* sectposids );
 
-		SHeapItem* getResult();
-
 	public:
-		void visitNode( SHeapNode* node ) override;
-		void visitLeaf( SHeapLeaf* leaf ) override;
+		void run( const SHeapRange& heapRoot );
 
 	private:
-		bool isIn1stDimRange( const SHeapItem* item ) const;
+		SHeapRange findSplitNode( const SHeapRange& heapRoot );
+		void traverseLeftSubtree( const SHeapRange& subtreeRoot );
+		void traverseRightSubtree( const SHeapRange& subtreeRoot );
+		void dumpSubtree( const SHeapRange& subtreeRoot );
+
+		bool isIn1stDimRange( const SSectionPos* sectpos ) const;
 		bool isIn2ndDimRange( const SSectionPos* sectpos ) const;
-		void tryAddItem( const SHeapNode* node );
+		void addItem( const SHeapRange& item );
 
 	private:
-		const KViewportArea& d_viewportArea;
+		const SHeaps& d_heaps;
 		const SViewportBorder& d_axis;
 		const SViewportBorder& d_min2ndDimEdge;
 		const SViewportBorder& d_max2ndDimEdge;
 		sect_pos_ids_t& d_sectposids;
-		SHeapItem* d_result;
 
 };
 
 // ----------------------------------------------------------------------------
 
 template< typename traits >
-KFindSplitNode< traits >::KFindSplitNode(
-	const KViewportArea& viewportArea,
+KSelectHeapSectPositions< traits >::KSelectHeapSectPositions(
+	const SHeaps& heaps,
 	const SViewportBorder& axis,
 	const SViewportBorder& min2ndDimEdge,
 	const SViewportBorder& max2ndDimEdge,
 	sect_pos_ids_t* sectposids )
-	: d_viewportArea( viewportArea )
+	: d_heaps( heaps )
 	, d_axis( axis )
 	, d_min2ndDimEdge( min2ndDimEdge )
 	, d_max2ndDimEdge( max2ndDimEdge )
 	, d_sectposids( *sectposids )
-	, d_result( nullptr )
 {
 }
 
 template< typename traits >
-SHeapItem* KFindSplitNode< traits >::getResult()
+void KSelectHeapSectPositions< traits >::run( const SHeapRange& heapRoot )
 {
-	return d_result;
+	const SHeapRange splitNode = findSplitNode( heapRoot );
+	if ( !splitNode.isEmpty() )
+	{
+		const SSectionPos* sectpos = d_heaps.getSectPos( splitNode );
+		if ( isIn1stDimRange( sectpos ) && isIn2ndDimRange( sectpos ) )
+			addItem( splitNode );
+		traverseLeftSubtree( splitNode );
+		traverseRightSubtree( splitNode );
+	}
 }
 
+/*
+	the root of each subtree is the minimal (for left/top side) or maximal
+	(for right/bottom side) x/y-coord in it, so the split node can be found
+	only if the root is in range [root, axis] for left/top or [axis, root]
+	for right/bottom, if not then all the other items aren't in the range
+	either; the roots passed on the way to the split node may be in the
+	area even if their medians are not
+*/
 template< typename traits >
-void KFindSplitNode< traits >::visitNode( SHeapNode* node )
+SHeapRange KSelectHeapSectPositions< traits >::findSplitNode( const SHeapRange& heapRoot )
 {
-	if ( isIn1stDimRange( node ) )
+	SHeapRange result;
+	SHeapRange item = heapRoot;
+	while ( !item.isEmpty() )
 	{
-		const SSectionPos* median = node->d_median;
+		const SSectionPos* sectpos = d_heaps.getSectPos( item );
+		if ( !isIn1stDimRange( sectpos ) )
+			break;
+
+		if ( item.isLeaf() )
+		{
+			if ( isIn2ndDimRange( sectpos ) )
+				result = item;
+			break;
+		}
+
+		const SSectionPos* median = d_heaps.getMedian( item );
 		if ( typename traits::compare_by_2nd_dim()( median, d_min2ndDimEdge ) )
 		{
-			SHeapItem* rightChild = node->getRightChild();
-			if ( rightChild )
-				rightChild->accept( this );
+			if ( isIn2ndDimRange( sectpos ) )
+				addItem( item );
+			item = item.getRightChild();
 		}
 		else if ( typename traits::compare_by_2nd_dim()( d_max2ndDimEdge, median ) )
 		{
-			SHeapItem* leftChild = node->getLeftChild();
-			if ( leftChild )
-				leftChild->accept( this );
+			if ( isIn2ndDimRange( sectpos ) )
+				addItem( item );
+			item = item.getLeftChild();
 		}
 		else
 		{
 			assert( isIn2ndDimRange( median ) );
-			d_result = node;
-		}
-
-		// even if median is not within 2nd dim range, then the subtree root
-		// may be in viewport area
-		if ( d_result != node )
-			tryAddItem( node );
-	}
-}
-
-template< typename traits >
-void KFindSplitNode< traits >::visitLeaf( SHeapLeaf* leaf )
-{
-	if ( isIn1stDimRange( leaf ) )
-	{
-		const SSectionPos* sectpos = leaf->d_sectpos;
-		if ( isIn2ndDimRange( sectpos ) )
-		{
-			d_result = leaf;
+			result = item;
+			break;
 		}
 	}
-}
-
-template< typename traits >
-bool KFindSplitNode< traits >::isIn1stDimRange( const SHeapItem* item ) const
-{
-	/*
-		item as subtree-root it is the minimal (for left/top side)
-		or maximal (for right/bottom side) x/y-coord in this heap,
-		so can find split-node only if it is range [item-root, axis]
-		for left/top or [axis, item-root] for right/bottom, if not
-		then we know for sure that all other nodes also aren't in
-		the range
-	*/
-	const bool result = typename traits::is_in_1st_dim_range( d_axis )( item );
-	return result;
-}
-
-template< typename traits >
-bool KFindSplitNode< traits >::isIn2ndDimRange( const SSectionPos* sectpos ) const
-{
-	const bool result = typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, sectpos )
-		&& typename traits::compare_by_2nd_dim()( sectpos, d_max2ndDimEdge );
 	return result;
 }
 
 template< typename traits >
-void KFindSplitNode< traits >::tryAddItem( const SHeapNode* node )
-{
-	const SSectionPos* nodepos = node->d_sectpos;
-	if ( isIn2ndDimRange( nodepos ) )
-	{
-		const sect_pos_id_t sectid = nodepos->d_id;
-		d_sectposids.push_back( sectid );
-	}
-}
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-template< typename is_in_1st_dim_range_t >
-struct SDumpSectPositionsTraits
-{
-	using is_in_1st_dim_range = is_in_1st_dim_range_t;
-};
-
-
-template< typename traits >
-class KDumpSectPositions : public KHeapItemVisitor
-{
-	public:
-		KDumpSectPositions(
-			const SViewportBorder& axis,
-			sect_pos_ids_t* sectposids );
-
-	public:
-		void visitNode( SHeapNode* node ) override;
-		void visitDefault( SHeapItem* item ) override;
-
-	private:
-		const SViewportBorder& d_axis;
-		sect_pos_ids_t& d_sectposids;
-
-};
-
-// ----------------------------------------------------------------------------
-
-template< typename traits >
-KDumpSectPositions< traits >::KDumpSectPositions(
-	const SViewportBorder& axis,
-	sect_pos_ids_t* sectposids )
-	: d_axis( axis )
-	, d_sectposids( *sectposids )
-{
-}
-
-template< typename traits >
-void KDumpSectPositions< traits >::visitNode( SHeapNode* node )
+void KSelectHeapSectPositions< traits >::traverseLeftSubtree( const SHeapRange& subtreeRoot )
 {
-	visitDefault( node );
-
-	SHeapItem* leftChild = node->getLeftChild();
-	if ( leftChild )
-		leftChild->accept( this );
-
-	SHeapItem* rightChild = node->getRightChild();
-	if ( rightChild )
-		rightChild->accept( this );
-}
-
-template< typename traits >
-void KDumpSectPositions< traits >::visitDefault( SHeapItem* item )
-{
-	if ( typename traits::is_in_1st_dim_range( d_axis )( item ) )
+	SHeapRange item = subtreeRoot.getLeftChild();
+	while ( !item.isEmpty() )
 	{
-		const SSectionPos* sectpos = item->d_sectpos;
-		const sect_pos_id_t sectposid = sectpos->d_id;
-		d_sectposids.push_back( sectposid );
-	}
-}
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-template<
-	typename is_in_1st_dim_range_t,
-	typename compare_by_2nd_dim_t >
-struct SSelectMedSectPositionsTraits
-{
-	using is_in_1st_dim_range = is_in_1st_dim_range_t;
-	using compare_by_2nd_dim = compare_by_2nd_dim_t;
-};
-
-
-template< typename traits >
-class KSelectMedSectPositions : public KHeapItemVisitor
-{
-	public:
-		KSelectMedSectPositions(
-			const KViewportArea& viewportArea,
-			const SViewportBorder& axis,
-			const SViewportBorder& min2ndDimEdge,
-			const SViewportBorder& max2ndDimEdge,
-			sect_pos_ids_t* sectposids );
+		const SSectionPos* sectpos = d_heaps.getSectPos( item );
+		if ( !isIn1stDimRange( sectpos ) )
+			break;
 
-	public:
-		void visitNode( SHeapNode* node ) override;
-		void visitDefault( SHeapItem* item ) override;
-
-	private:
-		void traverseLeftSubtree( SHeapNode* subtreeRoot );
-		void traverseRightSubtree( SHeapNode* subtreeRoot );
-		void dumpInnerSubtree( SHeapItem* root, EChildSide subtreeSide );
-
-		bool isIn1stDimRange( SHeapItem* item ) const;
-		bool isItemInArea( SHeapItem* item ) const;
-		void addItem( SHeapItem* item );
-
-	private:
-		const KViewportArea& d_viewportArea;
-		const SViewportBorder& d_axis;
-		const SViewportBorder& d_min2ndDimEdge;
-		const SViewportBorder& d_max2ndDimEdge;
-		using TDumpSectPositionsTraits = SDumpSectPositionsTraits< typename traits::is_in_1st_dim_range >;
-		KDumpSectPositions< TDumpSectPositionsTraits > d_dumpSectPositions;
-		sect_pos_ids_t& d_sectposids;
-
-};
-
-// ----------------------------------------------------------------------------
-
-template< typename traits >
-KSelectMedSectPositions< traits >::KSelectMedSectPositions(
-	const KViewportArea& viewportArea,
-	const SViewportBorder& axis,
-	const SViewportBorder& min2ndDimEdge,
-	const SViewportBorder& max2ndDimEdge,
-	sect_pos_ids_t* sectposids )
-	: d_viewportArea( viewportArea )
-	, d_axis( axis )
-	, d_min2ndDimEdge( min2ndDimEdge )
-	, d_max2ndDimEdge( max2ndDimEdge )
-	, d_dumpSectPositions( axis, sectposids )
-	, d_sectposids( *sectposids )
-{
-}
-
-template< typename traits >
-void KSelectMedSectPositions< traits >::visitNode( SHeapNode* node )
-{
-	if ( isItemInArea( node ) )
-		addItem( node );
-	traverseLeftSubtree( node );
-	traverseRightSubtree( node );
-}
-
-template< typename traits >
-void KSelectMedSectPositions< traits >::visitDefault( SHeapItem* item )
-{
-	if ( isItemInArea( item ) )
-		addItem( item );
-}
-
-template< typename traits >
-void KSelectMedSectPositions< traits >::traverseLeftSubtree( SHeapNode* subtreeRoot )
-{
-	SHeapItem* item = subtreeRoot->getLeftChild();
-	while ( ( item != nullptr ) && isIn1stDimRange( item ) )
-	{
-		const SSectionPos* sectpos = item->d_sectpos;
 		if ( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, sectpos ) )
 			addItem( item );
 
-		const SSectionPos* median = item->getMedian();
-		if ( median )
+		if ( item.isLeaf() )
+			break;
+
+		const SSectionPos* median = d_heaps.getMedian( item );
+		if ( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, median ) )
 		{
-			if ( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, median ) )
-			{
-				assert( typename traits::compare_by_2nd_dim()( median, d_max2ndDimEdge ) );
-				dumpInnerSubtree( item, RightChild );
-				item = item->getLeftChild();
-			}
-			else
-			{
-				item = item->getRightChild();
-			}
+			assert( typename traits::compare_by_2nd_dim()( median, d_max2ndDimEdge ) );
+			dumpSubtree( item.getRightChild() );
+			item = item.getLeftChild();
 		}
 		else
 		{
-			// it is leaf, stop the loop
-			item = nullptr;
+			item = item.getRightChild();
 		}
 	}
 }
 
 template< typename traits >
-void KSelectMedSectPositions< traits >::traverseRightSubtree( SHeapNode* subtreeRoot )
+void KSelectHeapSectPositions< traits >::traverseRightSubtree( const SHeapRange& subtreeRoot )
 {
-	SHeapItem* item = subtreeRoot->getRightChild();
-	while ( ( item != nullptr ) && isIn1stDimRange( item ) )
+	SHeapRange item = subtreeRoot.getRightChild();
+	while ( !item.isEmpty() )
 	{
-		const SSectionPos* sectpos = item->d_sectpos;
+		const SSectionPos* sectpos = d_heaps.getSectPos( item );
+		if ( !isIn1stDimRange( sectpos ) )
+			break;
+
 		if ( typename traits::compare_by_2nd_dim()( sectpos, d_max2ndDimEdge ) )
 			addItem( item );
 
-		const SSectionPos* median = item->getMedian();
-		if ( median )
+		if ( item.isLeaf() )
+			break;
+
+		const SSectionPos* median = d_heaps.getMedian( item );
+		if ( typename traits::compare_by_2nd_dim()( median, d_max2ndDimEdge ) )
 		{
-			if ( typename traits::compare_by_2nd_dim()( median, d_max2ndDimEdge ) )
-			{
-				assert( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, median ) );
-				dumpInnerSubtree( item, LeftChild );
-				item = item->getRightChild();
-			}
-			else
-			{
-				item = item->getLeftChild();
-			}
+			assert( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, median ) );
+			dumpSubtree( item.getLeftChild() );
+			item = item.getRightChild();
 		}
 		else
 		{
-			// it is leaf, stop the loop
-			item = nullptr;
+			item = item.getLeftChild();
 		}
 	}
 }
 
+// the subtree is within the range of the 2nd dim, and its items lie next to
+// each other, so it is a plain loop over them
 template< typename traits >
-void KSelectMedSectPositions< traits >::dumpInnerSubtree(
-	SHeapItem* root,
-	EChildSide subtreeSide )
+void KSelectHeapSectPositions< traits >::dumpSubtree( const SHeapRange& subtreeRoot )
 {
-	SHeapItem* subtreeRoot = subtreeSide == RightChild ? root->getRightChild() : root->getLeftChild();
-	if ( subtreeRoot )
-		subtreeRoot->accept( &d_dumpSectPositions );
+	const SHeapItem* items = d_heaps.d_items.data();
+	const SSectionPos* sectPositions = d_heaps.d_sectPositions;
+	for ( std::size_t i = subtreeRoot.d_begin; i != subtreeRoot.getEnd(); ++i )
+	{
+		const std::uint32_t sectPosId = items[ i ].d_sectPosId;
+		if ( isIn1stDimRange( sectPositions + sectPosId ) )
+			d_sectposids.push_back( sect_pos_id_t( sectPosId ) );
+	}
 }
 
 template< typename traits >
-bool KSelectMedSectPositions< traits >::isIn1stDimRange( SHeapItem* item ) const
+bool KSelectHeapSectPositions< traits >::isIn1stDimRange( const SSectionPos* sectpos ) const
 {
-	const bool result = typename traits::is_in_1st_dim_range( d_axis )( item );
+	const bool result = typename traits::is_in_1st_dim_range( d_axis )( sectpos );
 	return result;
 }
 
 template< typename traits >
-bool KSelectMedSectPositions< traits >::isItemInArea( SHeapItem* item ) const
+bool KSelectHeapSectPositions< traits >::isIn2ndDimRange( const SSectionPos* sectpos ) const
 {
-	bool result = false;
-	if ( isIn1stDimRange( item ) )
-	{
-		const SSectionPos* sectpos = item->d_sectpos;
-		if ( typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, sectpos )
-			&& typename traits::compare_by_2nd_dim()( sectpos, d_max2ndDimEdge ) )
-		{
-			result = true;
-		}
-	}
+	const bool result = typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, sectpos )
+		&& typename traits::compare_by_2nd_dim()( sectpos, d_max2ndDimEdge );
 	return result;
 }
 
 template< typename traits >
-void KSelectMedSectPositions< traits >::addItem( SHeapItem* item )
+void KSelectHeapSectPositions< traits >::addItem( const SHeapRange& item )
 {
-	assert( isItemInArea( item ) );
-	const sect_pos_id_t sectposid = item->d_sectpos->d_id;
-	d_sectposids.push_back( sectposid );
+	assert( isIn1stDimRange( d_heaps.getSectPos( item ) ) && isIn2ndDimRange( d_heaps.getSectPos( item ) ) );
+	d_sectposids.push_back( sect_pos_id_t( d_heaps.d_items[ item.d_begin ].d_sectPosId ) );
 }
 
 // ----------------------------------------------------------------------------
@@ -1592,7 +1368,8 @@ class KSelectSectPositions : public KIntervalTreeItemVisitor
 {
 	public:
 		KSelectSectPositions(
-			const KViewportArea& viewportArea,
+			const KSegmentsManager& segmentsManager,
+			const SHeaps& heaps,
 			const SViewportBorder& axis,
 			const SViewportBorder& min2ndDimEdge,
 			const SViewportBorder& max2ndDimEdge,
@@ -1603,32 +1380,41 @@ class KSelectSectPositions : public KIntervalTreeItemVisitor
 		void visitLeaf( SIntervalTreeLeaf* leaf ) override;
 
 	private:
-		void traverseLeftTopMedSectPositions( SHeapItem* medSectPositionsRoot );
-		void traverseRightBottomMedSectPositions( SHeapItem* medSectPositionsRoot );
-
-	private:
-		const KViewportArea& d_viewportArea;
+		const KSegmentsManager& d_segmentsManager;
 		const SViewportBorder& d_axis;
 		const SViewportBorder& d_min2ndDimEdge;
 		const SViewportBorder& d_max2ndDimEdge;
 		sect_pos_ids_t& d_sectposids;
 
+		using SSelectLeftTopHeapTraits = SSelectHeapSectPositionsTraits<
+			typename traits::is_in_front_of_1st_dim_axis,
+			typename traits::compare_by_2nd_dim >;
+		KSelectHeapSectPositions< SSelectLeftTopHeapTraits > d_selectLeftTopHeap;
+
+		using SSelectRightBottomHeapTraits = SSelectHeapSectPositionsTraits<
+			typename traits::is_behind_1st_dim_axis,
+			typename traits::compare_by_2nd_dim >;
+		KSelectHeapSectPositions< SSelectRightBottomHeapTraits > d_selectRightBottomHeap;
+
 };
 
 // ----------------------------------------------------------------------------
 
 template< typename traits >
 KSelectSectPositions< traits >::KSelectSectPositions(
-	const KViewportArea& viewportArea,
+	const KSegmentsManager& segmentsManager,
+	const SHeaps& heaps,
 	const SViewportBorder& axis,
 	const SViewportBorder& min2ndDimEdge,
 	const SViewportBorder& max2ndDimEdge,
 	sect_pos_ids_t* sectposids )
-	: d_viewportArea( viewportArea )
+	: d_segmentsManager( segmentsManager )
 	, d_axis( axis )
 	, d_min2ndDimEdge( min2ndDimEdge )
 	, d_max2ndDimEdge( max2ndDimEdge )
 	, d_sectposids( *sectposids )
+	, d_selectLeftTopHeap( heaps, axis, min2ndDimEdge, max2ndDimEdge, sectposids )
+	, d_selectRightBottomHeap( heaps, axis, min2ndDimEdge, max2ndDimEdge, sectposids )
 {
 }
 
@@ -1638,18 +1424,14 @@ void KSelectSectPositions< traits >::visitNode( SIntervalTreeNode* node )
 	const SSectionPos* medSectPos = node->d_medSectPos;
 	if ( typename traits::compare_by_1st_dim()( d_axis, medSectPos ) )
 	{
-		SHeapItem* medSectPositionsOnLeftTopRoot = node->d_medSectPositionsOnLeftTop;
-		if ( medSectPositionsOnLeftTopRoot )
-			traverseLeftTopMedSectPositions( medSectPositionsOnLeftTopRoot );
+		d_selectLeftTopHeap.run( node->d_medSectPositionsOnLeftTop );
 		SIntervalTreeItem* leftChild = node->d_leftChild;
 		if ( leftChild )
 			leftChild->accept( this );
 	}
 	else
 	{
-		SHeapItem* medSectPositionsOnRightBottomRoot = node->d_medSectPositionsOnRightBottom;
-		if ( medSectPositionsOnRightBottomRoot )
-			traverseRightBottomMedSectPositions( medSectPositionsOnRightBottomRoot );
+		d_selectRightBottomHeap.run( node->d_medSectPositionsOnRightBottom );
 		SIntervalTreeItem* rightChild = node->d_rightChild;
 		if ( rightChild )
 			rightChild->accept( this );
@@ -1661,7 +1443,7 @@ void KSelectSectPositions< traits >::visitLeaf( SIntervalTreeLeaf* leaf )
 {
 	const SSectionPos* beginSectPos = leaf->d_beginSectPos;
 	const SSectionPos* endSectPos = leaf->d_endSectPos;
-	assert( KSegmentsManager::isSection( beginSectPos, endSectPos ) );
+	assert( d_segmentsManager.isSection( beginSectPos, endSectPos ) );
 	if ( typename traits::compare_by_1st_dim()( beginSectPos, d_axis )
 		&& typename traits::compare_by_1st_dim()( d_axis, endSectPos )
 		&& typename traits::compare_by_2nd_dim()( d_min2ndDimEdge, beginSectPos )
@@ -1669,67 +1451,262 @@ void KSelectSectPositions< traits >::visitLeaf( SIntervalTreeLeaf* leaf )
 	{
 		// add only id of the beginning of section, it is enough to
 		// draw the whole section in the next stage
-		const sect_pos_id_t sectposid = beginSectPos->d_id;
+		const sect_pos_id_t sectposid = d_segmentsManager.getSectPosId( beginSectPos );
 		d_sectposids.push_back( sectposid );
 	}
 }
 
-template< typename traits >
-void KSelectSectPositions< traits >::traverseLeftTopMedSectPositions( SHeapItem* medSectPositionsRoot )
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	heap image in preorder:
+	node: int tag (NodeImageItem), int sect_pos_id, int median sect_pos_id,
+		left heap, right heap
+	leaf: int tag (LeafImageItem), int sect_pos_id
+	no item: int tag (NoImageItem)
+
+	the shape of the heap is implied by its size (vide SHeapRange), but the
+	image keeps the tags, so it stays the same as of the trees of pointers
+*/
+class KStoreHeap
 {
-	using SFindLeftTopSplitNodeTraits = SFindSplitNodeTraits<
-		typename traits::is_in_front_of_1st_dim_axis,
-		typename traits::compare_by_2nd_dim >;
-	KFindSplitNode< SFindLeftTopSplitNodeTraits > findSplitNode(
-		d_viewportArea,
-		d_axis,
-		d_min2ndDimEdge,
-		d_max2ndDimEdge,
-		&d_sectposids );
-	medSectPositionsRoot->accept( &findSplitNode );
-	SHeapItem* splitNode = findSplitNode.getResult();
-	if ( splitNode )
+	public:
+		KStoreHeap(
+			const SHeaps& heaps,
+			KIndexImageWriter* image );
+
+	public:
+		void run( const SHeapRange& heapRoot );
+
+	private:
+		void putSectPosId( std::uint32_t sectPosId );
+
+	private:
+		const SHeaps& d_heaps;
+		KIndexImageWriter* d_image;
+
+};
+
+KStoreHeap::KStoreHeap(
+	const SHeaps& heaps,
+	KIndexImageWriter* image )
+	: d_heaps( heaps )
+	, d_image( image )
+{
+}
+
+void KStoreHeap::run( const SHeapRange& heapRoot )
+{
+	if ( heapRoot.isEmpty() )
 	{
-		using SSelectMedLeftTopSectPositionsTraits = SSelectMedSectPositionsTraits<
-			typename traits::is_in_front_of_1st_dim_axis,
-			typename traits::compare_by_2nd_dim >;
-		KSelectMedSectPositions< SSelectMedLeftTopSectPositionsTraits > selectMedSectPositions(
-			d_viewportArea,
-			d_axis,
-			d_min2ndDimEdge,
-			d_max2ndDimEdge,
-			&d_sectposids );
-		splitNode->accept( &selectMedSectPositions );
+		d_image->putTag( NoImageItem );
+	}
+	else
+	{
+		const SHeapItem& item = d_heaps.d_items[ heapRoot.d_begin ];
+		if ( heapRoot.isLeaf() )
+		{
+			d_image->putTag( LeafImageItem );
+			putSectPosId( item.d_sectPosId );
+		}
+		else
+		{
+			d_image->putTag( NodeImageItem );
+			putSectPosId( item.d_sectPosId );
+			putSectPosId( item.d_medianId );
+			run( heapRoot.getLeftChild() );
+			run( heapRoot.getRightChild() );
+		}
 	}
 }
 
-template< typename traits >
-void KSelectSectPositions< traits >::traverseRightBottomMedSectPositions( SHeapItem* medSectPositionsRoot )
+void KStoreHeap::putSectPosId( const std::uint32_t sectPosId )
 {
-	using SFindRightBottomSplitNodeTraits = SFindSplitNodeTraits<
-		typename traits::is_behind_1st_dim_axis,
-		typename traits::compare_by_2nd_dim >;
-	KFindSplitNode< SFindRightBottomSplitNodeTraits > findSplitNode(
-		d_viewportArea,
-		d_axis,
-		d_min2ndDimEdge,
-		d_max2ndDimEdge,
-		&d_sectposids );
-	medSectPositionsRoot->accept( &findSplitNode );
-	SHeapItem* splitNode = findSplitNode.getResult();
-	if ( splitNode )
+	d_image->putId( sect_pos_id_t( sectPosId ) );
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	interval tree image in preorder:
+	node: int tag (NodeImageItem), int median sect_pos_id, left/top heap,
+		right/bottom heap, left subtree, right subtree
+	leaf: int tag (LeafImageItem), int begin sect_pos_id, int end sect_pos_id
+	no item: int tag (NoImageItem)
+*/
+class KStoreIntervalTree : public KIntervalTreeItemVisitor
+{
+	public:
+		KStoreIntervalTree(
+			const KSegmentsManager& segmentsManager,
+			const SHeaps& heaps,
+			KIndexImageWriter* image );
+
+	public:
+		void run( SIntervalTreeItem* root );
+
+	public:
+		void visitNode( SIntervalTreeNode* node ) override;
+		void visitLeaf( SIntervalTreeLeaf* leaf ) override;
+
+	private:
+		void putSectPos( const SSectionPos* sectpos );
+
+	private:
+		const KSegmentsManager& d_segmentsManager;
+		KIndexImageWriter* d_image;
+		KStoreHeap d_storeHeap;
+
+};
+
+KStoreIntervalTree::KStoreIntervalTree(
+	const KSegmentsManager& segmentsManager,
+	const SHeaps& heaps,
+	KIndexImageWriter* image )
+	: d_segmentsManager( segmentsManager )
+	, d_image( image )
+	, d_storeHeap( heaps, image )
+{
+}
+
+void KStoreIntervalTree::run( SIntervalTreeItem* root )
+{
+	if ( root != nullptr )
+		root->accept( this );
+	else
+		d_image->putTag( NoImageItem );
+}
+
+void KStoreIntervalTree::visitNode( SIntervalTreeNode* node )
+{
+	d_image->putTag( NodeImageItem );
+	putSectPos( node->d_medSectPos );
+	d_storeHeap.run( node->d_medSectPositionsOnLeftTop );
+	d_storeHeap.run( node->d_medSectPositionsOnRightBottom );
+	run( node->d_leftChild );
+	run( node->d_rightChild );
+}
+
+void KStoreIntervalTree::visitLeaf( SIntervalTreeLeaf* leaf )
+{
+	d_image->putTag( LeafImageItem );
+	putSectPos( leaf->d_beginSectPos );
+	putSectPos( leaf->d_endSectPos );
+}
+
+void KStoreIntervalTree::putSectPos( const SSectionPos* sectpos )
+{
+	d_image->putId( d_segmentsManager.getSectPosId( sectpos ) );
+}
+
+// ----------------------------------------------------------------------------
+
+// rebuilds tree stored by KStoreIntervalTree
+class KIntervalTreeLoader
+{
+	public:
+		KIntervalTreeLoader(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena,
+			SHeaps* heaps,
+			KIndexImageReader* image );
+
+	public:
+		SIntervalTreeItem* run();
+
+	private:
+		SIntervalTreeItem* loadItem();
+		SHeapRange loadHeap();
+		std::size_t loadHeapItem();
+
+	private:
+		const KSegmentsManager& d_segmentsManager;
+		KArena* d_arena;
+		SHeaps& d_heaps;
+		KIndexImageReader* d_image;
+
+};
+
+KIntervalTreeLoader::KIntervalTreeLoader(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena,
+	SHeaps* heaps,
+	KIndexImageReader* image )
+	: d_segmentsManager( segmentsManager )
+	, d_arena( arena )
+	, d_heaps( *heaps )
+	, d_image( image )
+{
+}
+
+SIntervalTreeItem* KIntervalTreeLoader::run()
+{
+	SIntervalTreeItem* root = loadItem();
+	return root;
+}
+
+SIntervalTreeItem* KIntervalTreeLoader::loadItem()
+{
+	SIntervalTreeItem* result = nullptr;
+	const EImageItemTag tag = d_image->getTag();
+	if ( tag == NodeImageItem )
 	{
-		using SSelectMedRightBottomSectPositionsTraits = SSelectMedSectPositionsTraits<
-			typename traits::is_behind_1st_dim_axis,
-			typename traits::compare_by_2nd_dim >;
-		KSelectMedSectPositions< SSelectMedRightBottomSectPositionsTraits > selectMedSectPositions(
-			d_viewportArea,
-			d_axis,
-			d_min2ndDimEdge,
-			d_max2ndDimEdge,
-			&d_sectposids );
-		splitNode->accept( &selectMedSectPositions );
+		const SSectionPos* medSectPos = d_image->getSectionPos();
+		SIntervalTreeNode* node = d_arena->create< SIntervalTreeNode >( medSectPos );
+		node->d_medSectPositionsOnLeftTop = loadHeap();
+		node->d_medSectPositionsOnRightBottom = loadHeap();
+		node->d_leftChild = loadItem();
+		node->d_rightChild = loadItem();
+		result = node;
+	}
+	else if ( tag == LeafImageItem )
+	{
+		const SSectionPos* beginSectPos = d_image->getSectionPos();
+		const SSectionPos* endSectPos = d_image->getSectionPos();
+		if ( !d_segmentsManager.isSection( beginSectPos, endSectPos ) )
+			throw std::runtime_error( "invalid index image" );
+		result = d_arena->create< SIntervalTreeLeaf >( beginSectPos, endSectPos );
+	}
+	return result;
+}
+
+SHeapRange KIntervalTreeLoader::loadHeap()
+{
+	const std::size_t rootIndex = d_heaps.d_items.size();
+	const std::size_t count = loadHeapItem();
+	const SHeapRange result( rootIndex, count );
+	return result;
+}
+
+// returns the count of the items of the subtree
+std::size_t KIntervalTreeLoader::loadHeapItem()
+{
+	std::size_t result = 0;
+	const EImageItemTag tag = d_image->getTag();
+	if ( tag == NodeImageItem )
+	{
+		const SSectionPos* sectpos = d_image->getSectionPos();
+		const SSectionPos* median = d_image->getSectionPos();
+		const SHeapItem node{ d_heaps.getSectPosId( sectpos ), d_heaps.getSectPosId( median ) };
+		d_heaps.d_items.push_back( node );
+		const std::size_t leftCount = loadHeapItem();
+		const std::size_t rightCount = loadHeapItem();
+
+		// the shape has to be the one implied by the size
+		const std::size_t childrenCount = leftCount + rightCount;
+		if ( ( childrenCount == 0 ) || ( leftCount != ( childrenCount + 1 ) / 2 ) )
+			throw std::runtime_error( "invalid index image" );
+		result = 1 + childrenCount;
+	}
+	else if ( tag == LeafImageItem )
+	{
+		const std::uint32_t sectPosId = d_heaps.getSectPosId( d_image->getSectionPos() );
+		const SHeapItem leaf{ sectPosId, sectPosId };
+		d_heaps.d_items.push_back( leaf );
+		result = 1;
 	}
+	return result;
 }
 
 } // anonymous namespace
@@ -1740,16 +1717,26 @@ void KSelectSectPositions< traits >::traverseRightBottomMedSectPositions( SHeapI
 class KIntervalTree::Impl
 {
 	public:
-		Impl( const KSegmentsManager& segmentsManager );
-		~Impl();
+		Impl(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena );
 
 	public:
 		template< typename traits >
 		SIntervalTreeItem* create( EOrientation orientation );
 
+		template< typename traits >
+		SIntervalTreeItem* load(
+			EOrientation orientation,
+			KIndexImageReader* image );
+
+		template< typename traits >
+		bool checkLoaded(
+			EOrientation orientation,
+			SIntervalTreeItem* treeRoot ) const;
+
 		template< typename traits >
 		void selectSectPositions(
-			const KViewportArea& viewportArea,
 			const SViewportBorder& axis,
 			const SViewportBorder& min2ndDimEdge,
 			const SViewportBorder& max2ndDimEdge,
@@ -1763,23 +1750,24 @@ class KIntervalTree::Impl
 
 	public:
 		const KSegmentsManager& d_segmentsManager;
+		KArena* d_arena;
+		SHeaps d_heaps;
+		// owned by the arena
 		SIntervalTreeItem* d_horzRoot;
 		SIntervalTreeItem* d_vertRoot;
 };
 
-KIntervalTree::Impl::Impl( const KSegmentsManager& segmentsManager )
+KIntervalTree::Impl::Impl(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena )
 	: d_segmentsManager( segmentsManager )
+	, d_arena( arena )
+	, d_heaps( segmentsManager )
 	, d_horzRoot( nullptr )
 	, d_vertRoot( nullptr )
 {
 }
 
-KIntervalTree::Impl::~Impl()
-{
-	delete d_horzRoot;
-	delete d_vertRoot;
-}
-
 template< typename traits >
 SIntervalTreeItem* KIntervalTree::Impl::create( EOrientation orientation )
 {
@@ -1790,18 +1778,43 @@ SIntervalTreeItem* KIntervalTree::Impl::create( EOrientation orientation )
 		std::sort( sect_positions.begin(), sect_positions.end(), typename traits::compare_by_1st_dim() );
 		assert( std::adjacent_find(
 			sect_positions.begin(), sect_positions.end() ) == sect_positions.end() ); // items should be unique
-		KIntervalTreeBuilder< traits> treeBuilder( d_segmentsManager );
+		KIntervalTreeBuilder< traits> treeBuilder( d_segmentsManager, d_arena, &d_heaps );
 		treeRoot = treeBuilder.run( sect_positions );
 		using checker_traits_t = SCheckIntervalTreeConsistencyTraits< typename traits::compare_by_1st_dim >;
-		assert( KCheckIntervalTreeConsistency< checker_traits_t >::run( treeRoot, sect_positions ) );
+		assert( KCheckIntervalTreeConsistency< checker_traits_t >::run( d_heaps, treeRoot, sect_positions ) );
 
 	}
 	return treeRoot;
 }
 
+template< typename traits >
+SIntervalTreeItem* KIntervalTree::Impl::load(
+	const EOrientation orientation,
+	KIndexImageReader* image )
+{
+	KIntervalTreeLoader treeLoader( d_segmentsManager, d_arena, &d_heaps, image );
+	SIntervalTreeItem* treeRoot = treeLoader.run();
+	assert( checkLoaded< traits >( orientation, treeRoot ) );
+	return treeRoot;
+}
+
+template< typename traits >
+bool KIntervalTree::Impl::checkLoaded(
+	const EOrientation orientation,
+	SIntervalTreeItem* treeRoot ) const
+{
+	bool result = true;
+	#ifdef ENABLE_TREE_CHECKERS
+	section_positions_t sect_positions;
+	d_segmentsManager.getSectPositions( orientation, &sect_positions );
+	using checker_traits_t = SCheckIntervalTreeConsistencyTraits< typename traits::compare_by_1st_dim >;
+	result = KCheckIntervalTreeConsistency< checker_traits_t >::run( d_heaps, treeRoot, sect_positions );
+	#endif
+	return result;
+}
+
 template< typename traits >
 void KIntervalTree::Impl::selectSectPositions(
-	const KViewportArea& viewportArea,
 	const SViewportBorder& axis,
 	const SViewportBorder& min2ndDimEdge,
 	const SViewportBorder& max2ndDimEdge,
@@ -1811,7 +1824,8 @@ void KIntervalTree::Impl::selectSectPositions(
 	if ( root )
 	{
 		KSelectSectPositions< traits > selectSectPositions(
-			viewportArea,
+			d_segmentsManager,
+			d_heaps,
 			axis,
 			min2ndDimEdge,
 			max2ndDimEdge,
@@ -1843,8 +1857,10 @@ void KIntervalTree::Impl::selectCrossSections(
 
 // ----------------------------------------------------------------------------
 
-KIntervalTree::KIntervalTree( const KSegmentsManager& segmentsManager )
-	: impl( new Impl( segmentsManager ) )
+KIntervalTree::KIntervalTree(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena )
+	: impl( new Impl( segmentsManager, arena ) )
 {
 	using SHorizontalTreeTraits = SIntervalTreeBuilderTraits< utils::compare_by_x, utils::compare_by_y >;
 	impl->d_horzRoot = impl->create< SHorizontalTreeTraits >( Horizontal );
@@ -1853,6 +1869,23 @@ KIntervalTree::KIntervalTree( const KSegmentsManager& segmentsManager )
 	impl->d_vertRoot = impl->create< SVerticalTreeTraits >( Vertical );
 }
 
+KIntervalTree::KIntervalTree(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena,
+	KIndexImageReader* image )
+	: impl( new Impl( segmentsManager, arena ) )
+{
+	std::unique_ptr< Impl > loadedImpl( impl );
+
+	using SHorizontalTreeTraits = SIntervalTreeBuilderTraits< utils::compare_by_x, utils::compare_by_y >;
+	impl->d_horzRoot = impl->load< SHorizontalTreeTraits >( Horizontal, image );
+
+	using SVerticalTreeTraits = SIntervalTreeBuilderTraits< utils::compare_by_y, utils::compare_by_x >;
+	impl->d_vertRoot = impl->load< SVerticalTreeTraits >( Vertical, image );
+
+	loadedImpl.release();
+}
+
 KIntervalTree::~KIntervalTree()
 {
 	delete impl;
@@ -1860,6 +1893,7 @@ KIntervalTree::~KIntervalTree()
 
 void KIntervalTree::selectSectPositions(
 	const KViewportArea& viewportArea,
+	sect_pos_ids_t* crosssectposids,
 	sect_pos_ids_t* sectposids ) const
 {
 	// horizontal-axis tree
@@ -1877,7 +1911,6 @@ void KIntervalTree::selectSectPositions(
 
 	const SViewportBorder& leftAxis = viewportArea.getLeftAxis();
 	impl->selectSectPositions< SSelectHorzSectPositionsTraits >(
-		viewportArea,
 		leftAxis,
 		topEdge,
 		bottomEdge,
@@ -1886,7 +1919,6 @@ void KIntervalTree::selectSectPositions(
 
 	const SViewportBorder& rightAxis = viewportArea.getRightAxis();
 	impl->selectSectPositions< SSelectHorzSectPositionsTraits >(
-		viewportArea,
 		rightAxis,
 		topEdge,
 		bottomEdge,
@@ -1904,15 +1936,14 @@ void KIntervalTree::selectSectPositions(
 		whether its right-bottom corner is behind/below of viewport rect
 	*/
 	const SViewportBorder& mapTopBorder = viewportArea.getMapTopBorder();
-	sect_pos_ids_t crosssectposids;
+	crosssectposids->clear();
 	impl->selectSectPositions< SSelectHorzSectPositionsTraits >(
-		viewportArea,
 		leftAxis,
 		mapTopBorder,
 		topEdge,
 		impl->d_horzRoot,
-		&crosssectposids );
-	impl->selectCrossSections( viewportArea, crosssectposids, sectposids );
+		crosssectposids );
+	impl->selectCrossSections( viewportArea, *crosssectposids, sectposids );
 
 	// vertical-axis tree
 	using is_in_front_of_vert_axis = is_in_left_top_side_range< utils::compare_by_y, SViewportBorder >;
@@ -1929,7 +1960,6 @@ void KIntervalTree::selectSectPositions(
 
 	const SViewportBorder& topAxis = viewportArea.getTopAxis();
 	impl->selectSectPositions< SSelectVertSectPositionsTraits >(
-		viewportArea,
 		topAxis,
 		leftEdge,
 		rightEdge,
@@ -1941,7 +1971,6 @@ void KIntervalTree::selectSectPositions(
 	// have at least one end-point inside the viewport rect
 	//const SViewportBorder& bottomAxis = viewportArea.getBottomAxis();
 	//impl->selectSectPositions< SSelectVertSectPositionsTraits >(
-	//	viewportArea,
 	//	bottomAxis,
 	//	leftEdge,
 	//	rightEdge,
@@ -1949,4 +1978,16 @@ void KIntervalTree::selectSectPositions(
 	//	sectposids );
 }
 
+std::size_t KIntervalTree::getHeapsMemorySize() const
+{
+	return impl->d_heaps.getMemorySize();
+}
+
+void KIntervalTree::store( KIndexImageWriter* image ) const
+{
+	KStoreIntervalTree storeIntervalTree( impl->d_segmentsManager, impl->d_heaps, image );
+	storeIntervalTree.run( impl->d_horzRoot );
+	storeIntervalTree.run( impl->d_vertRoot );
+}
+
 } // namespace be
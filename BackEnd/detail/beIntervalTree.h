@@ -8,19 +8,37 @@ namespace be
 {
 
 class KSegmentsManager;
+class KArena;
 class KViewportArea;
+class KIndexImageReader;
+class KIndexImageWriter;
 
 class KIntervalTree
 {
 	public:
-		KIntervalTree( const KSegmentsManager& segmentsManager );
+		// the nodes are allocated in the arena, it has to outlive the tree
+		KIntervalTree(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena );
+		KIntervalTree(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena,
+			KIndexImageReader* image );
 		~KIntervalTree();
 
 	public:
+		// crosssectposids is a scratch buffer of the caller
 		void selectSectPositions(
 			const KViewportArea& viewportArea,
+			sect_pos_ids_t* crosssectposids,
 			sect_pos_ids_t* sectposids ) const;
 
+		// bytes taken by the heaps of the positions, the nodes of the trees
+		// are in the arena
+		std::size_t getHeapsMemorySize() const;
+
+		void store( KIndexImageWriter* image ) const;
+
 	private:
 		class Impl;
 		Impl* impl;
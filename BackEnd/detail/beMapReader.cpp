@@ -2,6 +2,7 @@
 #include "ph.h"
 #include "beMapReader.h"
 #include "beSegmentsManager.h"
+#include "beDeltaCodec.h"
 #include "beUtils.h"
 #include "beMapStream.h"
 #include "beConsts.h"
@@ -19,7 +20,22 @@ class KDeserializator
 
 	public:
 		int getInt();
-		void getPoint( SPoint* point );
+		void getInts( int* values, std::size_t count );
+		std::size_t getCount();
+
+		// returns 'count' consecutive ints, either a direct view of the
+		// stream or a copy in the internal buffer
+		const int* getBlock( std::size_t count );
+
+		// returns 'count' points as consecutive (x, y) coords
+		const int* getPoints( std::size_t count );
+
+		// returns direct view of 'count' consecutive ints, or nullptr if
+		// the stream doesn't support it (vide IMapStream::viewInts)
+		const int* viewInts( std::size_t count );
+
+	private:
+		std::vector< int > d_buffer;
 
 	private:
 		IMapStream& d_mapStream;
@@ -43,18 +59,443 @@ int KDeserializator::getInt()
 	return result;
 }
 
-void KDeserializator::getPoint( SPoint* point )
+void KDeserializator::getInts( int* values, const std::size_t count )
+{
+	if ( !d_mapStream.getInts( values, count ) )
+	{
+		throw std::out_of_range( "unexpected end of map file" );
+	}
+}
+
+std::size_t KDeserializator::getCount()
+{
+	const int count = getInt();
+	if ( count < 0 )
+	{
+		throw std::out_of_range( "invalid count in map file" );
+	}
+	const std::size_t result = count;
+	return result;
+}
+
+const int* KDeserializator::getBlock( const std::size_t count )
+{
+	// if the stream keeps the whole map in memory (e.g. mapped file) then
+	// use its data directly, else read the whole block at once
+	const int* result = d_mapStream.viewInts( count );
+	if ( result == nullptr )
+	{
+		if ( d_buffer.size() < count )
+			d_buffer.resize( count );
+		getInts( d_buffer.data(), count );
+		result = d_buffer.data();
+	}
+	return result;
+}
+
+const int* KDeserializator::getPoints( const std::size_t count )
+{
+	const std::size_t coordsCount = 2 * count;
+	const int* result = getBlock( coordsCount );
+	return result;
+}
+
+const int* KDeserializator::viewInts( const std::size_t count )
+{
+	const int* result = d_mapStream.viewInts( count );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+void initMapRect( SRect* mapRect )
+{
+	*mapRect = SRect(
+		std::numeric_limits< coord_t >::max()
+		, std::numeric_limits< coord_t >::max()
+		, std::numeric_limits< coord_t >::min()
+		, std::numeric_limits< coord_t >::min() );
+}
+
+// the ids of the points and sections are 32-bit (vide consts::MaxPointsCount)
+void checkPointsCount( const std::size_t pointsCount )
+{
+	if ( KSegmentsManager::maxPointsCount() < pointsCount )
+	{
+		throw std::out_of_range( "too many points in map file" );
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// pointers to the beginnings of consecutive segments, the last one points
+// right after the last segment
+using segments_bounds_t = std::vector< const int* >;
+
+/*
+	creates the segments with the points and gathers the properties of the map
+	on the way, the segments are put straight into buckets of their road
+	classes, so they needn't be sorted later; in case the map is parsed in
+	parallel each thread has its own builder, then their results are merged;
+	the segments of the road classes below minRoadClass are skipped (vide
+	IProgressiveMapReader)
+*/
+class KSegmentsBuilder
+{
+	public:
+		KSegmentsBuilder(
+			bool indexed,
+			bool deltaEncoding,
+			int minRoadClass );
+
+	public:
+		// parses the whole segment laid out in [begin, end)
+		void parseSegment(
+			const int* begin,
+			const int* end );
+
+		void addSegment(
+			int roadClass,
+			const int* coords,
+			std::size_t pointsCount );
+
+		// returns decoded points as consecutive (x, y) coords, they are valid
+		// until the next call
+		const int* decodePoints(
+			const int* encodedPoints,
+			std::size_t encodedSize,
+			std::size_t pointsCount );
+
+	public:
+		std::size_t getPointsCount() const;
+		int getRoadClassesMask() const;
+		void mergeMapRect( SRect* mapRect ) const;
+
+		const SSegments& getSegments( int roadClass ) const;
+		void releaseSegments( int roadClass );
+
+	private:
+		void addRoadClass( int roadClass );
+		void skipPlainSegment(
+			int roadClass,
+			const int* coords,
+			std::size_t pointsCount );
+
+		void addPlainPoints(
+			const int* coords,
+			std::size_t pointsCount,
+			SSegments* segments );
+		void addIndexedPoints(
+			const int* coords,
+			std::size_t pointsCount,
+			SSegments* segments );
+		void addPoint(
+			const SPoint& point,
+			SSegments* segments );
+		void checkPoint( const SPoint& point ) const;
+
+		void updateAreaDims( const SPointPos* begin, const SPointPos* end );
+		void updateAreaDimsByPoint( const SPoint& point );
+		void updateAreaDimByPos( int pos, int* dimMin, int* dimMax );
+
+	private:
+		bool d_indexed;
+		bool d_deltaEncoding;
+		int d_minRoadClass;
+
+		std::size_t d_pointsCount;
+		int d_roadClassesMask;
+		SRect d_mapRect;
+
+		// segments of the given road class in the order they are read
+		std::vector< SSegments > d_roadClassSegments;
+
+		ints_t d_decodedCoords;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KSegmentsBuilder::KSegmentsBuilder(
+	const bool indexed,
+	const bool deltaEncoding,
+	const int minRoadClass )
+	: d_indexed( indexed )
+	, d_deltaEncoding( deltaEncoding )
+	, d_minRoadClass( minRoadClass )
+	, d_pointsCount( 0 )
+	, d_roadClassesMask( 0 )
+	, d_roadClassSegments( consts::MaxRoadClassIndex + 1 )
+{
+	initMapRect( &d_mapRect );
+}
+
+void KSegmentsBuilder::parseSegment(
+	const int* begin,
+	const int* end )
+{
+	// road class, points count and encoded size if any
+	const std::size_t headerSize = d_deltaEncoding ? 3 : 2;
+	const std::size_t segmentSize = std::distance( begin, end );
+	if ( ( segmentSize < headerSize ) || ( begin[ 1 ] < 0 ) || ( d_deltaEncoding && ( begin[ 2 ] < 0 ) ) )
+	{
+		throw std::out_of_range( "invalid segment in map file" );
+	}
+
+	const int roadClass = begin[ 0 ];
+	const std::size_t pointsCount = begin[ 1 ];
+	const std::size_t coordsSize = d_deltaEncoding ? begin[ 2 ] : 2 * pointsCount;
+	if ( segmentSize != ( headerSize + coordsSize ) )
+	{
+		throw std::out_of_range( "invalid segment in map file" );
+	}
+
+	const int* coords = begin + headerSize;
+	if ( d_minRoadClass <= roadClass )
+	{
+		if ( d_deltaEncoding )
+			coords = decodePoints( coords, coordsSize, pointsCount );
+		addSegment( roadClass, coords, pointsCount );
+	}
+	else if ( !d_indexed )
+	{
+		// the indexed map has the rect and road classes in the header
+		skipPlainSegment( roadClass, coords, pointsCount );
+	}
+}
+
+// segments with less than two unique points are dropped
+void KSegmentsBuilder::addSegment(
+	const int roadClass,
+	const int* coords,
+	const std::size_t pointsCount )
+{
+	addRoadClass( roadClass );
+	SSegments& segments = d_roadClassSegments[ roadClass ];
+	if ( d_indexed )
+		addIndexedPoints( coords, pointsCount, &segments );
+	else
+		addPlainPoints( coords, pointsCount, &segments );
+
+	const std::size_t segmentPointsCount = segments.getOpenPointsCount();
+	if ( 1 < segmentPointsCount )
+	{
+		segments.closeSegment( roadClass );
+		d_roadClassesMask |= 1 << roadClass;
+		d_pointsCount += segmentPointsCount;
+	}
+	else
+	{
+		segments.dropOpenPoints();
+	}
+}
+
+const int* KSegmentsBuilder::decodePoints(
+	const int* encodedPoints,
+	const std::size_t encodedSize,
+	const std::size_t pointsCount )
+{
+	const std::size_t encodedBytes = encodedSize * sizeof( int );
+	const std::size_t decodedBytes = delta_codec::decode(
+		reinterpret_cast< const std::uint8_t* >( encodedPoints ),
+		encodedBytes,
+		pointsCount,
+		&d_decodedCoords );
+
+	// only the alignment to int may follow the encoded points
+	if ( sizeof( int ) <= ( encodedBytes - decodedBytes ) )
+	{
+		throw std::runtime_error( "inconsistent segment of map file" );
+	}
+	const int* result = d_decodedCoords.data();
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+std::size_t KSegmentsBuilder::getPointsCount() const
+{
+	return d_pointsCount;
+}
+
+int KSegmentsBuilder::getRoadClassesMask() const
+{
+	return d_roadClassesMask;
+}
+
+void KSegmentsBuilder::mergeMapRect( SRect* mapRect ) const
+{
+	mapRect->left = std::min( mapRect->left, d_mapRect.left );
+	mapRect->top = std::min( mapRect->top, d_mapRect.top );
+	mapRect->right = std::max( mapRect->right, d_mapRect.right );
+	mapRect->bottom = std::max( mapRect->bottom, d_mapRect.bottom );
+}
+
+const SSegments& KSegmentsBuilder::getSegments( const int roadClass ) const
+{
+	return d_roadClassSegments[ roadClass ];
+}
+
+// the bucket is released as soon as it is merged, so while merging the
+// memory exceeds the final segments by one road class at most
+void KSegmentsBuilder::releaseSegments( const int roadClass )
 {
-	point->x = getInt();
-	point->y = getInt();
+	d_roadClassSegments[ roadClass ].clear();
+}
+
+// ----------------------------------------------------------------------------
+
+void KSegmentsBuilder::addRoadClass( const int roadClass )
+{
+	if ( ( roadClass < 0 ) || ( consts::MaxRoadClassIndex < roadClass ) )
+	{
+		throw std::out_of_range( "invalid road class in map file" );
+	}
+}
+
+// the road class and rect are gathered only if the segment would be added,
+// i.e. it has at least two unique points (vide addSegment)
+void KSegmentsBuilder::skipPlainSegment(
+	const int roadClass,
+	const int* coords,
+	const std::size_t pointsCount )
+{
+	addRoadClass( roadClass );
+	const int* coordsEnd = coords + 2 * pointsCount;
+	const int* it = coords;
+	while ( ( it != coordsEnd ) && ( it[ 0 ] == coords[ 0 ] ) && ( it[ 1 ] == coords[ 1 ] ) )
+		it += 2;
+
+	if ( it != coordsEnd )
+	{
+		d_roadClassesMask |= 1 << roadClass;
+		for ( it = coords
+			; it != coordsEnd
+			; it += 2 )
+		{
+			updateAreaDimsByPoint( SPoint( it[ 0 ], it[ 1 ] ) );
+		}
+	}
+}
+
+void KSegmentsBuilder::addPlainPoints(
+	const int* coords,
+	const std::size_t pointsCount,
+	SSegments* segments )
+{
+	const int* coordsEnd = coords + 2 * pointsCount;
+	for ( const int* it = coords
+		; it != coordsEnd
+		; it += 2 )
+	{
+		const SPoint point( it[ 0 ], it[ 1 ] );
+		addPoint( point, segments );
+	}
+
+	const std::size_t segmentPointsCount = segments->getOpenPointsCount();
+	if ( 1 < segmentPointsCount )
+	{
+		const SPointPos* pointsEnd = segments->d_points.data() + segments->d_points.size();
+		updateAreaDims( pointsEnd - segmentPointsCount, pointsEnd );
+	}
+}
+
+// points of the indexed map are unique and each segment has at least two
+// of them, so they are taken as they are
+void KSegmentsBuilder::addIndexedPoints(
+	const int* coords,
+	const std::size_t pointsCount,
+	SSegments* segments )
+{
+	assert( 1 < pointsCount );
+	segment_points_t& points = segments->d_points;
+	const int* coordsEnd = coords + 2 * pointsCount;
+	for ( const int* it = coords
+		; it != coordsEnd
+		; it += 2 )
+	{
+		const SPoint point( it[ 0 ], it[ 1 ] );
+		checkPoint( point );
+		points.push_back( SPointPos( point ) );
+	}
+}
+
+inline void KSegmentsBuilder::addPoint(
+	const SPoint& point,
+	SSegments* segments )
+{
+	segment_points_t& points = segments->d_points;
+	const bool isFirstPoint = ( segments->getOpenPointsCount() == 0 );
+	if ( isFirstPoint
+		|| ( point != points.back().getPoint() ) )
+	{
+		assert( isFirstPoint
+			|| utils::checkSectionLength( points.back().getPoint(), point ) );
+		checkPoint( point );
+		points.push_back( SPointPos( point ) );
+	}
+}
+
+#ifdef ENABLE_TILED_POINTS
+
+inline void KSegmentsBuilder::checkPoint( const SPoint& point ) const
+{
+	if ( !STiledPoint::isInRange( point ) )
+	{
+		throw std::out_of_range( "coords of map out of range of tiled points" );
+	}
+}
+
+#else
+
+inline void KSegmentsBuilder::checkPoint( const SPoint& /*point*/ ) const
+{
+	// any coords fit the plain points
+}
+
+#endif
+
+void KSegmentsBuilder::updateAreaDims(
+	const SPointPos* begin,
+	const SPointPos* end )
+{
+	for ( const SPointPos* it = begin
+		; it != end
+		; ++it )
+	{
+		updateAreaDimsByPoint( it->getPoint() );
+	}
+}
+
+void KSegmentsBuilder::updateAreaDimsByPoint( const SPoint& point )
+{
+	const coord_t x = point.x;
+	updateAreaDimByPos( x, &d_mapRect.left, &d_mapRect.right );
+
+	const coord_t y = point.y;
+	updateAreaDimByPos( y, &d_mapRect.top, &d_mapRect.bottom );
+}
+
+// both bounds are checked, the first point may be the min and max at once
+void KSegmentsBuilder::updateAreaDimByPos(
+	coord_t pos,
+	coord_t* dimMin,
+	coord_t* dimMax )
+{
+	if ( pos < ( *dimMin ) )
+		*dimMin = pos;
+	if ( ( *dimMax ) < pos )
+		*dimMax = pos;
 }
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
 /*
-	read binary file
-	format (assumption int == 4 bytes):
+	read binary file, there are two formats (assumption int == 4 bytes)
+
+	1) plain map file
 
 	int raw_segments_count
 	segment {
@@ -64,7 +505,236 @@ void KDeserializator::getPoint( SPoint* point )
 			int x1, y1
 		} * points_count
 	} * raw_segments_count
+
+	2) indexed map file (compiled from the plain one by MapTool)
+
+	int magic (consts::IndexedMapMagic)
+	int version (consts::IndexedMapVersion)
+	int flags (0 or consts::IndexedMapDeltaEncoding)
+	int map_left, map_top, map_right, map_bottom
+	int segments_count
+	int points_count (sum of points of all segments)
+	int road_classes (bit n is set if there is any segment of road class n)
+	int segment_offsets[ segments_count + 1 ]
+	segment {
+		int road_class
+		int points_count
+		point {
+			int x1, y1
+		} * points_count
+	} * segments_count
+
+	if the points are delta encoded, then the segment looks as follows
+
+	segment {
+		int road_class
+		int points_count
+		int encoded_size (in ints)
+		byte encoded_points[ encoded_size * 4 ] (vide beDeltaCodec.h)
+	}
+
+	segment offsets are counted in ints from the beginning of the first
+	segment, the last one is the size of the whole block of segments;
+	points of the indexed map are unique and each segment has at least
+	two of them, so they are taken as they are
+
+	if the stream keeps the whole map in memory (e.g. mapped file), then
+	the bounds of segments are known up front (from the offsets or a quick
+	scan of the plain map) and the segments are parsed in parallel
+
+	the segments are sorted by road class (and within the road class along
+	the Hilbert curve, vide appendInHilbertOrder), the ids of their points are assigned by
+	KSegmentsManager::init
 */
+
+// the header of the map and the bounds of its segments, so the map kept in
+// memory may be parsed more than once
+struct SMapLayout
+{
+	SMapLayout();
+
+	bool d_indexed;
+	bool d_deltaEncoding;
+	// the rect and points count are in the header of the indexed map only,
+	// the road classes of the plain map are gathered by the scan
+	SRect d_mapRect;
+	std::size_t d_pointsCount;
+	int d_roadClassesMask;
+	std::size_t d_segmentsCount;
+	// empty if the stream doesn't hand out direct views
+	segments_bounds_t d_bounds;
+};
+
+// ----------------------------------------------------------------------------
+
+SMapLayout::SMapLayout()
+	: d_indexed( false )
+	, d_deltaEncoding( false )
+	, d_pointsCount( 0 )
+	, d_roadClassesMask( 0 )
+	, d_segmentsCount( 0 )
+{
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+// reads the header and locates the segments of the map
+class KMapScanner
+{
+	public:
+		explicit KMapScanner( KDeserializator* input );
+
+	public:
+		// returns false if the stream doesn't hand out direct views, the
+		// segments have to be read one by one from the input then
+		bool run( SMapLayout* layout );
+
+	private:
+		bool scanPlainSegments( SMapLayout* layout );
+
+		void readIndexedHeader( SMapLayout* layout );
+		bool scanIndexedSegments( SMapLayout* layout );
+
+	private:
+		KDeserializator& d_input;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KMapScanner::KMapScanner( KDeserializator* input )
+	: d_input( *input )
+{
+}
+
+bool KMapScanner::run( SMapLayout* layout )
+{
+	bool result = true;
+	const int head = d_input.getInt();
+	if ( head == consts::IndexedMapMagic )
+	{
+		layout->d_indexed = true;
+		readIndexedHeader( layout );
+		result = scanIndexedSegments( layout );
+	}
+	else if ( 0 < head )
+	{
+		layout->d_segmentsCount = head;
+		result = scanPlainSegments( layout );
+	}
+	return result;
+}
+
+// walks through the segments of the map kept in memory and gathers their
+// bounds, returns false if the stream doesn't hand out direct views
+bool KMapScanner::scanPlainSegments( SMapLayout* layout )
+{
+	const std::size_t segmentsCount = layout->d_segmentsCount;
+	segments_bounds_t& bounds = layout->d_bounds;
+	bounds.reserve( segmentsCount + 1 );
+	for ( std::size_t i = 0
+		; i < segmentsCount
+		; ++i )
+	{
+		// road class and number of points
+		const int* segment = d_input.viewInts( 2 );
+		if ( segment == nullptr )
+		{
+			if ( i == 0 )
+				return false;
+			throw std::out_of_range( "unexpected end of map file" );
+		}
+		bounds.push_back( segment );
+
+		const int roadClass = segment[ 0 ];
+		if ( ( roadClass < 0 ) || ( consts::MaxRoadClassIndex < roadClass ) )
+		{
+			throw std::out_of_range( "invalid road class in map file" );
+		}
+		layout->d_roadClassesMask |= 1 << roadClass;
+
+		const int pointsCount = segment[ 1 ];
+		if ( pointsCount < 0 )
+		{
+			throw std::out_of_range( "invalid count in map file" );
+		}
+		const std::size_t coordsCount = 2 * static_cast< std::size_t >( pointsCount );
+		if ( ( coordsCount != 0 ) && ( d_input.viewInts( coordsCount ) == nullptr ) )
+		{
+			throw std::out_of_range( "unexpected end of map file" );
+		}
+	}
+	bounds.push_back( bounds.back() + 2 + 2 * bounds.back()[ 1 ] );
+	return true;
+}
+
+void KMapScanner::readIndexedHeader( SMapLayout* layout )
+{
+	const int version = d_input.getInt();
+	if ( version != consts::IndexedMapVersion )
+	{
+		throw std::runtime_error( "unsupported version of map file" );
+	}
+
+	const int flags = d_input.getInt();
+	if ( ( flags & ~consts::IndexedMapDeltaEncoding ) != 0 )
+	{
+		throw std::runtime_error( "unsupported encoding of map file" );
+	}
+	layout->d_deltaEncoding = ( flags & consts::IndexedMapDeltaEncoding ) != 0;
+
+	SRect& mapRect = layout->d_mapRect;
+	mapRect.left = d_input.getInt();
+	mapRect.top = d_input.getInt();
+	mapRect.right = d_input.getInt();
+	mapRect.bottom = d_input.getInt();
+
+	layout->d_segmentsCount = d_input.getCount();
+	layout->d_pointsCount = d_input.getCount();
+	checkPointsCount( layout->d_pointsCount );
+
+	layout->d_roadClassesMask = d_input.getInt();
+}
+
+// the bounds are taken from the offsets, returns false if the stream doesn't
+// hand out direct views (the offsets are skipped then)
+bool KMapScanner::scanIndexedSegments( SMapLayout* layout )
+{
+	const std::size_t segmentsCount = layout->d_segmentsCount;
+	const int* offsets = d_input.getBlock( segmentsCount + 1 );
+	const int segmentsSize = offsets[ segmentsCount ];
+	if ( segmentsSize < 0 )
+	{
+		throw std::out_of_range( "invalid offset in map file" );
+	}
+
+	const int* segments = d_input.viewInts( segmentsSize );
+	const bool result = ( segments != nullptr );
+	if ( result )
+	{
+		segments_bounds_t& bounds = layout->d_bounds;
+		bounds.reserve( segmentsCount + 1 );
+		int prevOffset = 0;
+		for ( std::size_t i = 0
+			; i <= segmentsCount
+			; ++i )
+		{
+			const int offset = offsets[ i ];
+			if ( ( offset < prevOffset ) || ( segmentsSize < offset ) )
+			{
+				throw std::out_of_range( "invalid offset in map file" );
+			}
+			bounds.push_back( segments + offset );
+			prevOffset = offset;
+		}
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
 class KMapReader
 {
 	public:
@@ -73,21 +743,44 @@ class KMapReader
 	public:
 		bool run();
 
+		// parses the located segments of the road classes from minRoadClass
+		// up, the map rect and road classes are those of the whole map
+		bool parse(
+			const SMapLayout& layout,
+			int minRoadClass );
+
 	private:
-		void readSegment();
-		bool readPoints( points_t* points );
+		void initLayout( const SMapLayout& layout );
 
-		void updateRoadClasses( int roadClass );
+		void readPlainMap( const SMapLayout& layout );
+		void readSegment( KSegmentsBuilder* builder );
 
-		void updateAreaDims( const points_t& points );
-		void updateAreaDimsByPoint( const SPoint& point );
-		void updateAreaDimByPos( int pos, int* dimMin, int* dimMax );
+		void readIndexedMap( const SMapLayout& layout );
+		void readIndexedSegment( KSegmentsBuilder* builder );
+
+		void parseSegments(
+			const segments_bounds_t& bounds,
+			int minRoadClass );
+		static std::size_t calcLoadingThreadsCount( std::size_t segmentsCount );
+
+		void initRoadClasses( int roadClassesMask );
+		void updateRoadClasses( int roadClass );
+		void applyBuilder( const KSegmentsBuilder& builder );
+		void mergeSegments( std::vector< KSegmentsBuilder >* builders );
+		void appendInHilbertOrder(
+			int roadClass,
+			const std::vector< KSegmentsBuilder >& builders );
 
 	private:
 		KDeserializator d_input;
 		SRect& d_mapRect;
 		bools_t& d_roadClasses;
-		raw_segments_t& d_segments;
+		SSegments& d_segments;
+		std::size_t& d_pointsCount;
+
+		bool d_indexed;
+		bool d_deltaEncoding;
+		int d_roadClassesMask;
 
 };
 
@@ -98,24 +791,51 @@ KMapReader::KMapReader( const SReaderData& data )
 	, d_mapRect( *data.d_mapRect )
 	, d_roadClasses( *data.d_roadClasses )
 	, d_segments( *data.d_segments )
+	, d_pointsCount( *data.d_pointsCount )
+	, d_indexed( false )
+	, d_deltaEncoding( false )
+	, d_roadClassesMask( 0 )
 {
-	d_mapRect = SRect(
-		std::numeric_limits< coord_t >::max()
-		, std::numeric_limits< coord_t >::max()
-		, std::numeric_limits< coord_t >::min()
-		, std::numeric_limits< coord_t >::min() );
+	d_pointsCount = 0;
 }
 
 bool KMapReader::run()
 {
-	const std::size_t segmentsCount = d_input.getInt();
-	assert( segmentsCount <= KSegmentsManager::maxSegmentCount() );
-	d_segments.reserve( segmentsCount );
-	for ( std::size_t i = 0
-		; i < segmentsCount
-		; ++i )
+	bool result = false;
+	SMapLayout layout;
+	KMapScanner scanner( &d_input );
+	if ( scanner.run( &layout ) )
+	{
+		result = parse( layout, 0 );
+	}
+	else
+	{
+		initLayout( layout );
+		if ( layout.d_indexed )
+			readIndexedMap( layout );
+		else
+			readPlainMap( layout );
+		result = !d_segments.empty();
+	}
+	return result;
+}
+
+bool KMapReader::parse(
+	const SMapLayout& layout,
+	const int minRoadClass )
+{
+	initLayout( layout );
+	const segments_bounds_t& bounds = layout.d_bounds;
+	if ( !bounds.empty() )
+	{
+		// the segments needn't be sorted by road class, the lesser ones are
+		// skipped without decoding
+		parseSegments( bounds, minRoadClass );
+	}
+
+	if ( d_indexed && ( minRoadClass == 0 ) && ( d_pointsCount != layout.d_pointsCount ) )
 	{
-		readSegment();
+		throw std::runtime_error( "inconsistent header of map file" );
 	}
 
 	const bool result = !d_segments.empty();
@@ -124,47 +844,153 @@ bool KMapReader::run()
 
 // ----------------------------------------------------------------------------
 
-void KMapReader::readSegment()
+void KMapReader::initLayout( const SMapLayout& layout )
+{
+	d_indexed = layout.d_indexed;
+	d_deltaEncoding = layout.d_deltaEncoding;
+	if ( d_indexed )
+	{
+		d_mapRect = layout.d_mapRect;
+		d_roadClassesMask = layout.d_roadClassesMask;
+		initRoadClasses( d_roadClassesMask );
+	}
+	else
+	{
+		initMapRect( &d_mapRect );
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void KMapReader::readPlainMap( const SMapLayout& layout )
+{
+	std::vector< KSegmentsBuilder > builders( 1, KSegmentsBuilder( false, false, 0 ) );
+	for ( std::size_t i = 0
+		; i < layout.d_segmentsCount
+		; ++i )
+	{
+		readSegment( &builders.front() );
+	}
+	mergeSegments( &builders );
+}
+
+void KMapReader::readSegment( KSegmentsBuilder* builder )
 {
 	const int roadClass = d_input.getInt();
-	assert( roadClass <= consts::MaxRoadClassIndex );
-	d_segments.push_back( SRawSegment( roadClass ) );
-	updateRoadClasses( roadClass );
+	const std::size_t pointsCount = d_input.getCount();
+	const int* coords = d_input.getPoints( pointsCount );
+	builder->addSegment( roadClass, coords, pointsCount );
+}
+
+// ----------------------------------------------------------------------------
+
+// segments are read one by one, so the offsets aren't needed here
+void KMapReader::readIndexedMap( const SMapLayout& layout )
+{
+	std::vector< KSegmentsBuilder > builders( 1, KSegmentsBuilder( true, d_deltaEncoding, 0 ) );
+	for ( std::size_t i = 0
+		; i < layout.d_segmentsCount
+		; ++i )
+	{
+		readIndexedSegment( &builders.front() );
+	}
+	mergeSegments( &builders );
 
-	SRawSegment& segment = d_segments.back();
-	points_t& segmentPoints = segment.d_points;
-	if ( readPoints( &segmentPoints ) )
+	if ( d_pointsCount != layout.d_pointsCount )
 	{
-		assert( ( 1 < segmentPoints.size() )
-			&& ( segmentPoints.size() <= KSegmentsManager::maxSegmentPointsCount() ) );
-		updateAreaDims( segmentPoints );
+		throw std::runtime_error( "inconsistent header of map file" );
 	}
 }
 
-bool KMapReader::readPoints( points_t* points )
+void KMapReader::readIndexedSegment( KSegmentsBuilder* builder )
 {
-	const int pointsCount = d_input.getInt();
-	points->reserve( pointsCount );
-	SPoint point;
-	for ( int i = 0; i < pointsCount; ++i )
+	const int roadClass = d_input.getInt();
+	const std::size_t pointsCount = d_input.getCount();
+
+	const int* coords = nullptr;
+	if ( d_deltaEncoding )
 	{
-		d_input.getPoint( &point );
-		if ( points->empty()
-			|| ( point.x != points->back().x )
-			|| ( point.y != points->back().y ) )
+		const std::size_t encodedSize = d_input.getCount();
+		const int* encodedPoints = d_input.getBlock( encodedSize );
+		coords = builder->decodePoints( encodedPoints, encodedSize, pointsCount );
+	}
+	else
+	{
+		coords = d_input.getPoints( pointsCount );
+	}
+	builder->addSegment( roadClass, coords, pointsCount );
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	the segments are split into ranges of the same size, each one is parsed
+	by a separate thread into its own buckets of road classes, then the
+	buckets are merged in the order of ranges, as well as the road classes,
+	points counts and map rects gathered by the threads
+*/
+void KMapReader::parseSegments(
+	const segments_bounds_t& bounds,
+	const int minRoadClass )
+{
+	const std::size_t segmentsCount = bounds.size() - 1;
+	const std::size_t threadsCount = calcLoadingThreadsCount( segmentsCount );
+	std::vector< KSegmentsBuilder > builders( threadsCount, KSegmentsBuilder( d_indexed, d_deltaEncoding, minRoadClass ) );
+	const auto parseRange = [ this, &bounds, &builders, segmentsCount, threadsCount ]( const std::size_t range )
+	{
+		const std::size_t first = segmentsCount * range / threadsCount;
+		const std::size_t last = segmentsCount * ( range + 1 ) / threadsCount;
+		KSegmentsBuilder& builder = builders[ range ];
+		for ( std::size_t i = first
+			; i < last
+			; ++i )
 		{
-			assert( points->empty()
-				|| utils::checkSectionLength( points->back(), point ) );
-			points->push_back( point );
+			builder.parseSegment( bounds[ i ], bounds[ i + 1 ] );
 		}
+	};
+
+	// the first range is parsed by the current thread
+	std::vector< std::future< void > > tasks;
+	tasks.reserve( threadsCount - 1 );
+	for ( std::size_t range = 1
+		; range < threadsCount
+		; ++range )
+	{
+		tasks.push_back( std::async( std::launch::async, parseRange, range ) );
+	}
+	parseRange( 0 );
+
+	// rethrows the exception if any range is malformed
+	for ( std::future< void >& task : tasks )
+	{
+		task.get();
 	}
 
-	const bool result = ( 1 < points->size() );
+	mergeSegments( &builders );
+}
+
+std::size_t KMapReader::calcLoadingThreadsCount( const std::size_t segmentsCount )
+{
+	const std::size_t hardwareThreadsCount = std::max( std::thread::hardware_concurrency(), 1U );
+	const std::size_t result = std::max< std::size_t >(
+		std::min( hardwareThreadsCount, segmentsCount / consts::MinSegmentsPerLoadingThread ),
+		1 );
 	return result;
 }
 
 // ----------------------------------------------------------------------------
 
+void KMapReader::initRoadClasses( const int roadClassesMask )
+{
+	for ( int roadClass = 0
+		; roadClass <= consts::MaxRoadClassIndex
+		; ++roadClass )
+	{
+		if ( roadClassesMask & ( 1 << roadClass ) )
+			updateRoadClasses( roadClass );
+	}
+}
+
 void KMapReader::updateRoadClasses( int roadClass )
 {
 	const std::size_t newSize = roadClass + 1;
@@ -173,32 +999,210 @@ void KMapReader::updateRoadClasses( int roadClass )
 	d_roadClasses[ roadClass ] = true;
 }
 
-void KMapReader::updateAreaDims( const points_t& points )
+void KMapReader::mergeSegments( std::vector< KSegmentsBuilder >* builders )
 {
-	for ( const SPoint& point : points )
+	std::size_t segmentsCount = 0;
+	for ( KSegmentsBuilder& builder : *builders )
+	{
+		applyBuilder( builder );
+		for ( int roadClass = 0
+			; roadClass <= consts::MaxRoadClassIndex
+			; ++roadClass )
+		{
+			segmentsCount += builder.getSegments( roadClass ).size();
+		}
+	}
+
+	checkPointsCount( d_pointsCount );
+
+	/*
+		sort by road class - at drawing the most important roads will be
+		painted at the end (over less important)
+	*/
+	d_segments.reserve( segmentsCount, d_pointsCount );
+	for ( int roadClass = 0
+		; roadClass <= consts::MaxRoadClassIndex
+		; ++roadClass )
 	{
-		updateAreaDimsByPoint( point );
+		appendInHilbertOrder( roadClass, *builders );
+		for ( KSegmentsBuilder& builder : *builders )
+		{
+			builder.releaseSegments( roadClass );
+		}
 	}
 }
 
-void KMapReader::updateAreaDimsByPoint( const SPoint& point )
+/*
+	the segments of the road class are ordered along the Hilbert curve (by
+	the centers of their bounding boxes), so the segments close on the map
+	get close ids and the sections of the viewport are gathered from a few
+	ranges of memory instead of the whole map
+*/
+void KMapReader::appendInHilbertOrder(
+	const int roadClass,
+	const std::vector< KSegmentsBuilder >& builders )
 {
-	const coord_t x = point.x;
-	updateAreaDimByPos( x, &d_mapRect.left, &d_mapRect.right );
+	// the segments are keyed in the buckets of the builders, so each one is
+	// copied only once; they are numbered through all the buckets, the first
+	// number of each bucket is its offset
+	std::vector< std::size_t > offsets;
+	offsets.reserve( builders.size() + 1 );
+	offsets.push_back( 0 );
+	for ( const KSegmentsBuilder& builder : builders )
+		offsets.push_back( offsets.back() + builder.getSegments( roadClass ).size() );
 
-	const coord_t y = point.y;
-	updateAreaDimByPos( y, &d_mapRect.top, &d_mapRect.bottom );
+	using key_t = std::pair< std::uint32_t, std::uint32_t >;
+	std::vector< key_t > keys;
+	keys.reserve( offsets.back() );
+	for ( const KSegmentsBuilder& builder : builders )
+	{
+		const SSegments& segments = builder.getSegments( roadClass );
+		for ( std::size_t segmentIndex = 0
+			; segmentIndex < segments.size()
+			; ++segmentIndex )
+		{
+			const SPointPos* begin = segments.getPointsBegin( segmentIndex );
+			const SPointPos* end = segments.getPointsEnd( segmentIndex );
+			SRect bounds( begin->getPoint().x, begin->getPoint().y, begin->getPoint().x, begin->getPoint().y );
+			for ( const SPointPos* it = begin + 1; it != end; ++it )
+			{
+				const decoded_point_t point = it->getPoint();
+				bounds.left = std::min( bounds.left, point.x );
+				bounds.top = std::min( bounds.top, point.y );
+				bounds.right = std::max( bounds.right, point.x );
+				bounds.bottom = std::max( bounds.bottom, point.y );
+			}
+
+			const SPoint center(
+				bounds.left + ( bounds.right - bounds.left ) / 2,
+				bounds.top + ( bounds.bottom - bounds.top ) / 2 );
+			const std::uint32_t hilbertIndex = utils::calcHilbertIndex( d_mapRect, center );
+			keys.emplace_back( hilbertIndex, static_cast< std::uint32_t >( keys.size() ) );
+		}
+	}
+
+	// ties keep the order of the file, the builders parse its consecutive
+	// parts
+	std::sort( keys.begin(), keys.end() );
+
+	for ( const key_t& key : keys )
+	{
+		const std::size_t builderIndex
+			= std::distance( offsets.begin(), std::upper_bound( offsets.begin(), offsets.end(), key.second ) ) - 1;
+		const SSegments& segments = builders[ builderIndex ].getSegments( roadClass );
+		const std::size_t segmentIndex = key.second - offsets[ builderIndex ];
+		d_segments.d_points.insert(
+			d_segments.d_points.end(),
+			segments.getPointsBegin( segmentIndex ),
+			segments.getPointsEnd( segmentIndex ) );
+		d_segments.closeSegment( roadClass );
+	}
 }
 
-void KMapReader::updateAreaDimByPos(
-	coord_t pos,
-	coord_t* dimMin,
-	coord_t* dimMax )
+void KMapReader::applyBuilder( const KSegmentsBuilder& builder )
 {
-	if ( pos < ( *dimMin ) )
-		*dimMin = pos;
-	else if ( ( *dimMax ) < pos )
-		*dimMax = pos;
+	d_pointsCount += builder.getPointsCount();
+
+	const int roadClassesMask = builder.getRoadClassesMask();
+	if ( d_indexed )
+	{
+		// the indexed map has the rect and road classes in the header
+		if ( ( roadClassesMask & ~d_roadClassesMask ) != 0 )
+		{
+			throw std::runtime_error( "inconsistent header of map file" );
+		}
+	}
+	else
+	{
+		builder.mergeMapRect( &d_mapRect );
+		d_roadClassesMask |= roadClassesMask;
+		initRoadClasses( d_roadClassesMask );
+	}
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KProgressiveMapReader : public IProgressiveMapReader
+{
+	public:
+		explicit KProgressiveMapReader( IMapStream* mapStream );
+
+	public:
+		// returns false if the stream doesn't hand out direct views
+		bool init();
+
+	public:
+		// IProgressiveMapReader
+		bool readMajorRoadClasses( const SReaderData& data ) const override;
+		bool readWholeMap( const SReaderData& data ) const override;
+
+	private:
+		int calcMinMajorRoadClass() const;
+		bool read(
+			const SReaderData& data,
+			int minRoadClass ) const;
+
+	private:
+		IMapStream* d_mapStream;
+		SMapLayout d_layout;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KProgressiveMapReader::KProgressiveMapReader( IMapStream* mapStream )
+	: d_mapStream( mapStream )
+{
+}
+
+bool KProgressiveMapReader::init()
+{
+	KDeserializator input( d_mapStream );
+	KMapScanner scanner( &input );
+	const bool result = scanner.run( &d_layout );
+	return result;
+}
+
+bool KProgressiveMapReader::readMajorRoadClasses( const SReaderData& data ) const
+{
+	const bool result = read( data, calcMinMajorRoadClass() );
+	return result;
+}
+
+bool KProgressiveMapReader::readWholeMap( const SReaderData& data ) const
+{
+	const bool result = read( data, 0 );
+	return result;
+}
+
+int KProgressiveMapReader::calcMinMajorRoadClass() const
+{
+	int result = consts::MaxRoadClassIndex + 1;
+	std::size_t majorRoadClassesCount = 0;
+	while ( ( 0 < result ) && ( majorRoadClassesCount < consts::MajorRoadClassesCount ) )
+	{
+		--result;
+		if ( d_layout.d_roadClassesMask & ( 1 << result ) )
+			++majorRoadClassesCount;
+	}
+	return result;
+}
+
+// the segments are parsed straight from the views, the stream isn't read
+bool KProgressiveMapReader::read(
+	const SReaderData& data,
+	const int minRoadClass ) const
+{
+	const SReaderData readerData(
+		d_mapStream,
+		data.d_mapRect,
+		data.d_roadClasses,
+		data.d_segments,
+		data.d_pointsCount );
+	KMapReader reader( readerData );
+	const bool result = reader.parse( d_layout, minRoadClass );
+	return result;
 }
 
 } // anonymous namespace
@@ -209,11 +1213,13 @@ SReaderData::SReaderData(
 	IMapStream* mapStream,
 	SRect* mapRect,
 	bools_t* roadClasses,
-	raw_segments_t* segments )
+	SSegments* segments,
+	std::size_t* pointsCount )
 	: d_mapStream( mapStream )
 	, d_mapRect( mapRect )
 	, d_roadClasses( roadClasses )
 	, d_segments( segments )
+	, d_pointsCount( pointsCount )
 {
 }
 
@@ -224,4 +1230,20 @@ bool readMap( const SReaderData& data )
 	return result;
 }
 
+// ----------------------------------------------------------------------------
+
+IProgressiveMapReader* IProgressiveMapReader::create( IMapStream* mapStream )
+{
+	// the stream which doesn't hand out views is left intact to be read at
+	// once, else the scan doesn't fail (but throws if the map is malformed)
+	IProgressiveMapReader* result = nullptr;
+	if ( mapStream->viewInts( 0 ) != nullptr )
+	{
+		auto mapReader = std::make_unique< KProgressiveMapReader >( mapStream );
+		if ( mapReader->init() )
+			result = mapReader.release();
+	}
+	return result;
+}
+
 } // namespace be
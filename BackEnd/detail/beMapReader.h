@@ -15,16 +15,44 @@ struct SReaderData
 		IMapStream* mapStream,
 		SRect* mapRect,
 		bools_t* d_roadClasses,
-		raw_segments_t* segments );
+		SSegments* segments,
+		std::size_t* pointsCount );
 
 	IMapStream* d_mapStream;
 	SRect* d_mapRect;
 	bools_t* d_roadClasses;
-	raw_segments_t* d_segments;
+	SSegments* d_segments;
+	std::size_t* d_pointsCount;
 };
 
+// the segments are sorted by road class, see the details in beMapReader.cpp
 bool readMap( const SReaderData& data );
 
+/*
+	reads the map kept in memory in two steps, at first the segments of the
+	most important road classes only (vide consts::MajorRoadClassesCount),
+	then the whole map (e.g. in the background); the map rect and road
+	classes are those of the whole map at both steps; the segments are
+	located once and parsed straight from the views of the stream passed to
+	create (the stream of SReaderData is not used), so it has to outlive
+	the reader
+*/
+struct IProgressiveMapReader
+{
+	public:
+		// returns nullptr if the stream doesn't hand out direct views (vide
+		// IMapStream::viewInts), the map has to be read at once then
+		static IProgressiveMapReader* create( IMapStream* mapStream );
+
+	public:
+		virtual ~IProgressiveMapReader() = default;
+
+	public:
+		virtual bool readMajorRoadClasses( const SReaderData& data ) const = 0;
+		virtual bool readWholeMap( const SReaderData& data ) const = 0;
+
+};
+
 } // namespace be
 
 #endif
@@ -2,6 +2,22 @@
 #include "ph.h"
 #include "beMapStream.h"
 #include "beConsts.h"
+#include "beConfig.h"
+
+#ifdef ENABLE_COMPRESSED_MAP_STREAM
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #ifndef ANDROID
 #pragma warning( disable : 4996 )
@@ -216,6 +232,13 @@ class KArrayMapStream : public IMapStream
 
 	public:
 		bool getInt( int* value ) override;
+		bool getInts( int* values, std::size_t count ) override;
+		const int* viewInts( std::size_t count ) override;
+
+	protected:
+		void setRange(
+			const int* begin,
+			const int* end );
 
 	private:
 		const int* d_it;
@@ -245,6 +268,35 @@ bool KArrayMapStream::getInt( int* value )
 	return canRead;
 }
 
+bool KArrayMapStream::getInts( int* values, const std::size_t count )
+{
+	const int* view = viewInts( count );
+	const bool canRead = ( view != nullptr );
+	if ( canRead )
+		memcpy( values, view, count * sizeof( int ) );
+	return canRead;
+}
+
+const int* KArrayMapStream::viewInts( const std::size_t count )
+{
+	const int* result = nullptr;
+	const std::size_t available = std::distance( d_it, d_end );
+	if ( count <= available )
+	{
+		result = d_it;
+		d_it += count;
+	}
+	return result;
+}
+
+void KArrayMapStream::setRange(
+	const int* begin,
+	const int* end )
+{
+	d_it = begin;
+	d_end = end;
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
@@ -260,6 +312,7 @@ class KFileMapStream : public IMapStream
 
 	public:
 		bool getInt( int* value ) override;
+		bool getInts( int* values, std::size_t count ) override;
 
 	private:
 		FILE* d_file;
@@ -302,11 +355,416 @@ bool KFileMapStream::getInt( int* value )
 	return result;
 }
 
+bool KFileMapStream::getInts( int* values, const std::size_t count )
+{
+	assert( d_file != nullptr );
+	const bool result = ( fread( values, sizeof( *values ), count, d_file ) == count );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KFileMapping
+{
+	public:
+		KFileMapping();
+		~KFileMapping();
+
+	public:
+		bool map( const std::string& fname );
+		bool map( int fileDescriptor, long offset );
+
+		const char* getData() const;
+		std::size_t getSize() const;
+
+	private:
+		void unmap();
+
+	private:
+		#ifdef _WIN32
+		HANDLE d_file;
+		HANDLE d_mapping;
+		#endif
+		void* d_view;
+		std::size_t d_viewSize;
+		std::size_t d_dataOffset;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KFileMapping::KFileMapping()
+	#ifdef _WIN32
+	: d_file( INVALID_HANDLE_VALUE )
+	, d_mapping( nullptr )
+	, d_view( nullptr )
+	#else
+	: d_view( nullptr )
+	#endif
+	, d_viewSize( 0 )
+	, d_dataOffset( 0 )
+{
+}
+
+KFileMapping::~KFileMapping()
+{
+	unmap();
+}
+
+#ifdef _WIN32
+
+bool KFileMapping::map( const std::string& fname )
+{
+	assert( d_view == nullptr );
+	d_file = ::CreateFileA(
+		fname.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr );
+	if ( d_file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if ( !::GetFileSizeEx( d_file, &fileSize ) || ( fileSize.QuadPart == 0 ) )
+		return false;
+
+	d_mapping = ::CreateFileMappingA( d_file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( d_mapping == nullptr )
+		return false;
+
+	d_view = ::MapViewOfFile( d_mapping, FILE_MAP_READ, 0, 0, 0 );
+	d_viewSize = static_cast< std::size_t >( fileSize.QuadPart );
+	const bool result = ( d_view != nullptr );
+	return result;
+}
+
+bool KFileMapping::map( int /*fileDescriptor*/, long /*offset*/ )
+{
+	// file descriptors are the Android way of passing assets, on Windows
+	// the map is always opened by name
+	return false;
+}
+
+void KFileMapping::unmap()
+{
+	if ( d_view != nullptr )
+		::UnmapViewOfFile( d_view );
+	if ( d_mapping != nullptr )
+		::CloseHandle( d_mapping );
+	if ( d_file != INVALID_HANDLE_VALUE )
+		::CloseHandle( d_file );
+}
+
+#else
+
+bool KFileMapping::map( const std::string& fname )
+{
+	bool result = false;
+	const int fileDescriptor = ::open( fname.c_str(), O_RDONLY );
+	if ( fileDescriptor != -1 )
+		result = map( fileDescriptor, 0 );
+	return result;
+}
+
+bool KFileMapping::map( const int fileDescriptor, const long offset )
+{
+	assert( d_view == nullptr );
+	bool result = false;
+	struct stat fileStat;
+	if ( ( ::fstat( fileDescriptor, &fileStat ) == 0 ) && ( offset < fileStat.st_size ) )
+	{
+		// mmap accepts only page aligned offsets, so map a bit more and skip
+		// the leading bytes
+		const long pageSize = ::sysconf( _SC_PAGESIZE );
+		const long mapOffset = offset - ( offset % pageSize );
+		d_dataOffset = offset - mapOffset;
+		d_viewSize = static_cast< std::size_t >( fileStat.st_size - mapOffset );
+		void* view = ::mmap( nullptr, d_viewSize, PROT_READ, MAP_PRIVATE, fileDescriptor, mapOffset );
+		if ( view != MAP_FAILED )
+		{
+			d_view = view;
+			// the whole map is parsed front to back just once
+			::madvise( d_view, d_viewSize, MADV_SEQUENTIAL );
+			result = true;
+		}
+	}
+	// the mapping stays valid after closing the descriptor (the ownership of
+	// descriptor is taken the same way fdopen does in KFileMapStream)
+	::close( fileDescriptor );
+	return result;
+}
+
+void KFileMapping::unmap()
+{
+	if ( d_view != nullptr )
+		::munmap( d_view, d_viewSize );
+}
+
+#endif
+
+const char* KFileMapping::getData() const
+{
+	assert( d_view != nullptr );
+	const char* result = static_cast< const char* >( d_view ) + d_dataOffset;
+	return result;
+}
+
+std::size_t KFileMapping::getSize() const
+{
+	const std::size_t result = d_viewSize - d_dataOffset;
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KMappedMapStream : public KArrayMapStream
+{
+	public:
+		KMappedMapStream();
+
+	public:
+		bool open( const std::string& fname );
+		bool open( int fileDescriptor, long offset );
+
+	private:
+		bool initRange();
+
+	private:
+		KFileMapping d_mapping;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KMappedMapStream::KMappedMapStream()
+	: KArrayMapStream( nullptr, nullptr )
+{
+}
+
+bool KMappedMapStream::open( const std::string& fname )
+{
+	const bool result = d_mapping.map( fname ) && initRange();
+	return result;
+}
+
+bool KMappedMapStream::open( const int fileDescriptor, const long offset )
+{
+	const bool result = d_mapping.map( fileDescriptor, offset ) && initRange();
+	return result;
+}
+
+bool KMappedMapStream::initRange()
+{
+	bool result = false;
+	const char* data = d_mapping.getData();
+	// views are handed out as int pointers, so they have to be properly
+	// aligned (it may not be the case for an asset placed at odd offset)
+	if ( ( reinterpret_cast< std::uintptr_t >( data ) % alignof( int ) ) == 0 )
+	{
+		const int* begin = reinterpret_cast< const int* >( data );
+		const int* end = begin + ( d_mapping.getSize() / sizeof( int ) );
+		setRange( begin, end );
+		result = true;
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+#ifdef ENABLE_COMPRESSED_MAP_STREAM
+
+// the compressed data is read and inflated in such blocks
+const std::size_t CompressedBlockSize = 256 * 1024;
+const std::size_t InflatedBlockSize = 1024 * 1024;
+
+/*
+	inflates the map block by block while it is read, the compressed data is
+	read from the file or taken straight from the memory, gzip and zlib
+	formats are recognized automatically
+*/
+class KCompressedMapStream : public IMapStream
+{
+	public:
+		KCompressedMapStream();
+		~KCompressedMapStream() override;
+
+	public:
+		bool open( const std::string& fname );
+		bool open( int fileDescriptor, long offset );
+		bool open( const void* data, std::size_t size );
+
+	public:
+		bool getInt( int* value ) override;
+		bool getInts( int* values, std::size_t count ) override;
+
+	private:
+		bool initInflate();
+		bool inflateBlock();
+		bool readCompressedBlock();
+
+	private:
+		FILE* d_file;
+		const unsigned char* d_data;
+		std::size_t d_dataSize;
+
+		z_stream d_stream;
+		bool d_streamReady;
+		bool d_streamEnd;
+
+		std::vector< unsigned char > d_compressedBlock;
+		std::vector< unsigned char > d_inflatedBlock;
+		std::size_t d_inflatedPos;
+		std::size_t d_inflatedSize;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KCompressedMapStream::KCompressedMapStream()
+	: d_file( nullptr )
+	, d_data( nullptr )
+	, d_dataSize( 0 )
+	, d_stream()
+	, d_streamReady( false )
+	, d_streamEnd( false )
+	, d_inflatedPos( 0 )
+	, d_inflatedSize( 0 )
+{
+}
+
+KCompressedMapStream::~KCompressedMapStream()
+{
+	if ( d_streamReady )
+		::inflateEnd( &d_stream );
+	if ( d_file )
+		fclose( d_file );
+}
+
+bool KCompressedMapStream::open( const std::string& fname )
+{
+	assert( d_file == nullptr );
+	d_file = fopen( fname.c_str(), "rb" );
+	const bool result = ( d_file != nullptr ) && initInflate();
+	return result;
+}
+
+bool KCompressedMapStream::open( const int fileDescriptor, const long offset )
+{
+	assert( d_file == nullptr );
+	d_file = fdopen( fileDescriptor, "rb" );
+	const bool result = ( d_file != nullptr )
+		&& ( fseek( d_file, offset, SEEK_SET ) == 0 )
+		&& initInflate();
+	return result;
+}
+
+bool KCompressedMapStream::open( const void* data, const std::size_t size )
+{
+	d_data = static_cast< const unsigned char* >( data );
+	d_dataSize = size;
+	const bool result = initInflate();
+	return result;
+}
+
+bool KCompressedMapStream::getInt( int* value )
+{
+	const bool result = getInts( value, 1 );
+	return result;
+}
+
+bool KCompressedMapStream::getInts( int* values, const std::size_t count )
+{
+	unsigned char* output = reinterpret_cast< unsigned char* >( values );
+	std::size_t outputSize = count * sizeof( int );
+	while ( outputSize != 0 )
+	{
+		if ( ( d_inflatedPos == d_inflatedSize ) && !inflateBlock() )
+			return false;
+
+		const std::size_t chunkSize = std::min( outputSize, d_inflatedSize - d_inflatedPos );
+		memcpy( output, d_inflatedBlock.data() + d_inflatedPos, chunkSize );
+		d_inflatedPos += chunkSize;
+		output += chunkSize;
+		outputSize -= chunkSize;
+	}
+	return true;
+}
+
+bool KCompressedMapStream::initInflate()
+{
+	d_compressedBlock.resize( d_file ? CompressedBlockSize : 0 );
+	d_inflatedBlock.resize( InflatedBlockSize );
+
+	// 32 added to the window bits enables detection of gzip and zlib header
+	const int MaxWindowBits = 15;
+	d_streamReady = ( ::inflateInit2( &d_stream, MaxWindowBits + 32 ) == Z_OK );
+	return d_streamReady;
+}
+
+// returns false if there is nothing more to inflate (or the data is damaged)
+bool KCompressedMapStream::inflateBlock()
+{
+	d_stream.next_out = d_inflatedBlock.data();
+	d_stream.avail_out = static_cast< uInt >( d_inflatedBlock.size() );
+	while ( !d_streamEnd && ( d_stream.avail_out != 0 ) )
+	{
+		if ( ( d_stream.avail_in == 0 ) && !readCompressedBlock() )
+			break;
+
+		const int status = ::inflate( &d_stream, Z_NO_FLUSH );
+		if ( status == Z_STREAM_END )
+			d_streamEnd = true;
+		else if ( status != Z_OK )
+			break;
+	}
+
+	d_inflatedPos = 0;
+	d_inflatedSize = d_inflatedBlock.size() - d_stream.avail_out;
+	const bool result = ( d_inflatedSize != 0 );
+	return result;
+}
+
+bool KCompressedMapStream::readCompressedBlock()
+{
+	std::size_t blockSize = 0;
+	if ( d_file )
+	{
+		blockSize = fread( d_compressedBlock.data(), 1, d_compressedBlock.size(), d_file );
+		d_stream.next_in = d_compressedBlock.data();
+	}
+	else
+	{
+		// avail_in is 32-bit only, so huge data is passed in parts as well
+		blockSize = std::min( d_dataSize, CompressedBlockSize );
+		d_stream.next_in = const_cast< unsigned char* >( d_data );
+		d_data += blockSize;
+		d_dataSize -= blockSize;
+	}
+	d_stream.avail_in = static_cast< uInt >( blockSize );
+	const bool result = ( blockSize != 0 );
+	return result;
+}
+
+#endif // ENABLE_COMPRESSED_MAP_STREAM
+
 } // anonymous namespace
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
+const int* IMapStream::viewInts( std::size_t /*count*/ )
+{
+	return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
 IMapStream* IMapStream::create( const std::string& fname )
 {
 	auto mapStream = new KFileMapStream();
@@ -344,6 +802,82 @@ IMapStream* IMapStream::create()
 	return mapStream;
 }
 
+IMapStream* IMapStream::createMapped( const std::string& fname )
+{
+	auto mapStream = new KMappedMapStream();
+	if ( !mapStream->open( fname ) )
+	{
+		delete mapStream;
+		mapStream = nullptr;
+	}
+	return mapStream;
+}
+
+IMapStream* IMapStream::createMapped( const int fileDescriptor, const long offset )
+{
+	auto mapStream = new KMappedMapStream();
+	if ( !mapStream->open( fileDescriptor, offset ) )
+	{
+		delete mapStream;
+		mapStream = nullptr;
+	}
+	return mapStream;
+}
+
+#ifdef ENABLE_COMPRESSED_MAP_STREAM
+
+IMapStream* IMapStream::createCompressed( const std::string& fname )
+{
+	auto mapStream = new KCompressedMapStream();
+	if ( !mapStream->open( fname ) )
+	{
+		delete mapStream;
+		mapStream = nullptr;
+	}
+	return mapStream;
+}
+
+IMapStream* IMapStream::createCompressed( const int fileDescriptor, const long offset )
+{
+	auto mapStream = new KCompressedMapStream();
+	if ( !mapStream->open( fileDescriptor, offset ) )
+	{
+		delete mapStream;
+		mapStream = nullptr;
+	}
+	return mapStream;
+}
+
+IMapStream* IMapStream::createCompressed( const void* data, const std::size_t size )
+{
+	auto mapStream = new KCompressedMapStream();
+	if ( !mapStream->open( data, size ) )
+	{
+		delete mapStream;
+		mapStream = nullptr;
+	}
+	return mapStream;
+}
+
+#else
+
+IMapStream* IMapStream::createCompressed( const std::string& /*fname*/ )
+{
+	return nullptr;
+}
+
+IMapStream* IMapStream::createCompressed( const int /*fileDescriptor*/, const long /*offset*/ )
+{
+	return nullptr;
+}
+
+IMapStream* IMapStream::createCompressed( const void* /*data*/, const std::size_t /*size*/ )
+{
+	return nullptr;
+}
+
+#endif // ENABLE_COMPRESSED_MAP_STREAM
+
 } // namespace be
 
 #ifndef ANDROID
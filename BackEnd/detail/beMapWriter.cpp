@@ -0,0 +1,339 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beMapWriter.h"
+#include "beDeltaCodec.h"
+#include "beConsts.h"
+
+namespace be
+{
+
+namespace
+{
+
+class KSerializator
+{
+	public:
+		explicit KSerializator( std::ostream* output );
+
+	public:
+		void putInt( int value );
+		void putBytes( const std::uint8_t* bytes, std::size_t count );
+		bool isGood() const;
+
+	private:
+		std::ostream& d_output;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KSerializator::KSerializator( std::ostream* output )
+	: d_output( *output )
+{
+}
+
+void KSerializator::putInt( const int value )
+{
+	d_output.write( reinterpret_cast< const char* >( &value ), sizeof( value ) );
+}
+
+void KSerializator::putBytes( const std::uint8_t* bytes, const std::size_t count )
+{
+	d_output.write( reinterpret_cast< const char* >( bytes ), count );
+}
+
+bool KSerializator::isGood() const
+{
+	const bool result = d_output.good();
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	writes the indexed map file, segments are stored in the same order as
+	they are passed, but consecutive duplicated points are skipped and
+	degenerated segments (with less than two unique points) are dropped;
+	delta encoded segments are prepared in advance, because their sizes
+	are needed for the offsets
+*/
+class KMapWriter
+{
+	public:
+		explicit KMapWriter( const SWriterData& data );
+
+	public:
+		bool run();
+
+	private:
+		bool prepare();
+		static std::size_t countUniquePoints(
+			const SPointPos* begin,
+			const SPointPos* end );
+		std::size_t encodeSegment( std::size_t segmentIndex );
+
+		void writeHeader();
+		void writeOffsets();
+		void writeSegments();
+		void writeSegment(
+			std::size_t segmentIndex,
+			std::size_t pointsCount );
+		void writeEncodedSegment(
+			std::size_t segmentIndex,
+			std::size_t pointsCount,
+			std::size_t encodedSize,
+			const std::uint8_t** encodedPoints );
+
+	private:
+		KSerializator d_output;
+		const SRect& d_mapRect;
+		const SSegments& d_segments;
+		const EMapEncoding d_encoding;
+
+		// number of unique points of each segment, 0 for dropped ones
+		std::vector< std::size_t > d_segmentPointsCounts;
+		// size of each segment in ints (the same order as above)
+		std::vector< std::size_t > d_segmentSizes;
+		std::size_t d_segmentsCount;
+		std::size_t d_pointsCount;
+		int d_roadClassesMask;
+
+		// delta encoded points of all segments, aligned to ints
+		bytes_t d_encodedPoints;
+		points_t d_uniquePoints;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KMapWriter::KMapWriter( const SWriterData& data )
+	: d_output( data.d_output )
+	, d_mapRect( *data.d_mapRect )
+	, d_segments( *data.d_segments )
+	, d_encoding( data.d_encoding )
+	, d_segmentsCount( 0 )
+	, d_pointsCount( 0 )
+	, d_roadClassesMask( 0 )
+{
+}
+
+bool KMapWriter::run()
+{
+	bool result = false;
+	if ( prepare() )
+	{
+		writeHeader();
+		writeOffsets();
+		writeSegments();
+		result = d_output.isGood();
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+bool KMapWriter::prepare()
+{
+	d_segmentPointsCounts.reserve( d_segments.size() );
+	d_segmentSizes.reserve( d_segments.size() );
+	std::size_t segmentsSize = 0;
+	for ( std::size_t segmentIndex = 0
+		; segmentIndex < d_segments.size()
+		; ++segmentIndex )
+	{
+		std::size_t pointsCount = countUniquePoints(
+			d_segments.getPointsBegin( segmentIndex ),
+			d_segments.getPointsEnd( segmentIndex ) );
+		std::size_t segmentSize = 0;
+		if ( 1 < pointsCount )
+		{
+			const int roadClass = d_segments.getRoadClassIndex( segmentIndex );
+			if ( ( roadClass < 0 ) || ( consts::MaxRoadClassIndex < roadClass ) )
+				return false;
+
+			d_roadClassesMask |= 1 << roadClass;
+			++d_segmentsCount;
+			d_pointsCount += pointsCount;
+
+			// road class, points count and the points
+			segmentSize = ( d_encoding == DeltaMapEncoding )
+				? 3 + encodeSegment( segmentIndex )
+				: 2 + 2 * pointsCount;
+			segmentsSize += segmentSize;
+		}
+		else
+		{
+			pointsCount = 0;
+		}
+		d_segmentPointsCounts.push_back( pointsCount );
+		d_segmentSizes.push_back( segmentSize );
+	}
+
+	// all offsets have to fit into int, the last one is the greatest
+	const std::size_t maxSize = std::numeric_limits< int >::max();
+	const bool result = ( 0 < d_segmentsCount ) && ( segmentsSize <= maxSize );
+	return result;
+}
+
+std::size_t KMapWriter::countUniquePoints(
+	const SPointPos* begin,
+	const SPointPos* end )
+{
+	std::size_t result = 0;
+	const SPoint* prevPoint = nullptr;
+	for ( const SPointPos* it = begin
+		; it != end
+		; ++it )
+	{
+		const SPoint& point = it->getPoint();
+		if ( ( prevPoint == nullptr )
+			|| ( point.x != prevPoint->x )
+			|| ( point.y != prevPoint->y ) )
+		{
+			++result;
+		}
+		prevPoint = &point;
+	}
+	return result;
+}
+
+// returns the size of the encoded points in ints
+std::size_t KMapWriter::encodeSegment( const std::size_t segmentIndex )
+{
+	d_uniquePoints.clear();
+	const SPointPos* end = d_segments.getPointsEnd( segmentIndex );
+	for ( const SPointPos* it = d_segments.getPointsBegin( segmentIndex )
+		; it != end
+		; ++it )
+	{
+		const SPoint& point = it->getPoint();
+		if ( d_uniquePoints.empty() || ( point != d_uniquePoints.back() ) )
+			d_uniquePoints.push_back( point );
+	}
+
+	const std::size_t encodedBegin = d_encodedPoints.size();
+	delta_codec::encode( d_uniquePoints, &d_encodedPoints );
+	while ( ( d_encodedPoints.size() % sizeof( int ) ) != 0 )
+		d_encodedPoints.push_back( 0 );
+
+	const std::size_t result = ( d_encodedPoints.size() - encodedBegin ) / sizeof( int );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+void KMapWriter::writeHeader()
+{
+	d_output.putInt( consts::IndexedMapMagic );
+	d_output.putInt( consts::IndexedMapVersion );
+	d_output.putInt( ( d_encoding == DeltaMapEncoding ) ? consts::IndexedMapDeltaEncoding : 0 );
+
+	d_output.putInt( d_mapRect.left );
+	d_output.putInt( d_mapRect.top );
+	d_output.putInt( d_mapRect.right );
+	d_output.putInt( d_mapRect.bottom );
+
+	d_output.putInt( static_cast< int >( d_segmentsCount ) );
+	d_output.putInt( static_cast< int >( d_pointsCount ) );
+	d_output.putInt( d_roadClassesMask );
+}
+
+void KMapWriter::writeOffsets()
+{
+	std::size_t offset = 0;
+	for ( const std::size_t segmentSize : d_segmentSizes )
+	{
+		if ( segmentSize != 0 )
+		{
+			d_output.putInt( static_cast< int >( offset ) );
+			offset += segmentSize;
+		}
+	}
+	d_output.putInt( static_cast< int >( offset ) );
+}
+
+void KMapWriter::writeSegments()
+{
+	const std::uint8_t* encodedPoints = d_encodedPoints.data();
+	auto countIt = d_segmentPointsCounts.begin();
+	auto sizeIt = d_segmentSizes.begin();
+	for ( std::size_t segmentIndex = 0
+		; segmentIndex < d_segments.size()
+		; ++segmentIndex, ++countIt, ++sizeIt )
+	{
+		const std::size_t pointsCount = *countIt;
+		if ( pointsCount != 0 )
+		{
+			if ( d_encoding == DeltaMapEncoding )
+				writeEncodedSegment( segmentIndex, pointsCount, *sizeIt - 3, &encodedPoints );
+			else
+				writeSegment( segmentIndex, pointsCount );
+		}
+	}
+}
+
+void KMapWriter::writeSegment(
+	const std::size_t segmentIndex,
+	const std::size_t pointsCount )
+{
+	d_output.putInt( d_segments.getRoadClassIndex( segmentIndex ) );
+	d_output.putInt( static_cast< int >( pointsCount ) );
+
+	const SPoint* prevPoint = nullptr;
+	const SPointPos* end = d_segments.getPointsEnd( segmentIndex );
+	for ( const SPointPos* it = d_segments.getPointsBegin( segmentIndex )
+		; it != end
+		; ++it )
+	{
+		const SPoint& point = it->getPoint();
+		if ( ( prevPoint == nullptr )
+			|| ( point.x != prevPoint->x )
+			|| ( point.y != prevPoint->y ) )
+		{
+			d_output.putInt( point.x );
+			d_output.putInt( point.y );
+		}
+		prevPoint = &point;
+	}
+}
+
+void KMapWriter::writeEncodedSegment(
+	const std::size_t segmentIndex,
+	const std::size_t pointsCount,
+	const std::size_t encodedSize,
+	const std::uint8_t** encodedPoints )
+{
+	d_output.putInt( d_segments.getRoadClassIndex( segmentIndex ) );
+	d_output.putInt( static_cast< int >( pointsCount ) );
+	d_output.putInt( static_cast< int >( encodedSize ) );
+
+	const std::size_t encodedBytes = encodedSize * sizeof( int );
+	d_output.putBytes( *encodedPoints, encodedBytes );
+	*encodedPoints += encodedBytes;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+SWriterData::SWriterData(
+	std::ostream* output,
+	const SRect* mapRect,
+	const SSegments* segments,
+	const EMapEncoding encoding )
+	: d_output( output )
+	, d_mapRect( mapRect )
+	, d_segments( segments )
+	, d_encoding( encoding )
+{
+}
+
+bool writeMap( const SWriterData& data )
+{
+	KMapWriter writer( data );
+	const bool result = writer.run();
+	return result;
+}
+
+} // namespace be
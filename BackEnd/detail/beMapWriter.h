@@ -0,0 +1,35 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_BE_MAP_WRITER_H
+#define INC_BE_MAP_WRITER_H
+
+#include "beInternalTypes.h"
+
+namespace be
+{
+
+enum EMapEncoding
+{
+	PlainMapEncoding,
+	DeltaMapEncoding
+};
+
+struct SWriterData
+{
+	SWriterData(
+		std::ostream* output,
+		const SRect* mapRect,
+		const SSegments* segments,
+		EMapEncoding encoding = PlainMapEncoding );
+
+	std::ostream* d_output;
+	const SRect* d_mapRect;
+	const SSegments* d_segments;
+	EMapEncoding d_encoding;
+};
+
+// writes the indexed map file, see the format description in beMapReader.cpp
+bool writeMap( const SWriterData& data );
+
+} // namespace be
+
+#endif
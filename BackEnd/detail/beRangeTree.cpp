@@ -4,6 +4,8 @@
 #include "beSegmentsManager.h"
 #include "beViewportArea.h"
 #include "beTreeUtils.h"
+#include "beIndexImage.h"
+#include "beArena.h"
 #include "beUtils.h"
 #include "beConfig.h"
 
@@ -38,14 +40,13 @@ class KRangeTreeItemVisitor
 
 // ----------------------------------------------------------------------------
 
+// the items live in the arena of the document, so they are never deleted
+// (vide KArena)
 struct SRangeTreeItem
 {
 	protected:
 		explicit SRangeTreeItem( const SPointPos* pointPos );
 
-	public:
-		virtual ~SRangeTreeItem() = default;
-
 	public:
 		virtual bool isLeaf() const = 0;
 
@@ -69,7 +70,6 @@ struct SRangeTreeNodeBase : public SRangeTreeItem
 {
 	public:
 		explicit SRangeTreeNodeBase( const SPointPos* pointPos );
-		~SRangeTreeNodeBase() override;
 
 	public:
 		bool isLeaf() const override;
@@ -91,12 +91,6 @@ SRangeTreeNodeBase::SRangeTreeNodeBase( const SPointPos* pointPos )
 {
 }
 
-SRangeTreeNodeBase::~SRangeTreeNodeBase()
-{
-	delete d_leftChild;
-	delete d_rightChild;
-}
-
 bool SRangeTreeNodeBase::isLeaf() const
 {
 	return false;
@@ -149,11 +143,15 @@ struct SRangeTreeNode : public SRangeTreeNodeBase
 		void accept( KRangeTreeItemVisitor* visitor ) override;
 
 	public:
-		point_positions_t d_point_positions_by_y;
+		// range of the associated structure in SAssociatedStructures
+		std::uint32_t d_point_indexes_offset;
+		std::uint32_t d_point_indexes_count;
 };
 
 SRangeTreeNode::SRangeTreeNode( const SPointPos* pointPos )
 	: SRangeTreeNodeBase( pointPos )
+	, d_point_indexes_offset( 0 )
+	, d_point_indexes_count( 0 )
 {
 }
 
@@ -362,28 +360,391 @@ void KCheckRangeTreeConsistency::visitDefault( SRangeTreeItem* item )
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
+/*
+	ids packed with as few bits as the greatest of them needs, e.g. 20 bits
+	for a million points, each one is decoded on access, so a list is never
+	unpacked as a whole; the ids are read with unaligned 64-bit loads
+	(little-endian targets), the buffer is padded so they never go past it
+*/
+class KPackedIds
+{
+	public:
+		KPackedIds();
+
+	public:
+		void init(
+			std::uint32_t maxId,
+			std::size_t reservedCount );
+		void shrink();
+
+		std::size_t size() const;
+		void push_back( std::uint32_t id );
+		std::uint32_t operator[]( std::size_t index ) const;
+
+		std::size_t getMemorySize() const;
+
+	private:
+		std::size_t calcBytesCount( std::size_t count ) const;
+
+	private:
+		unsigned d_bitsPerId;
+		std::uint64_t d_mask;
+		std::size_t d_count;
+		std::vector< std::uint8_t > d_bytes;
+
+};
+
+KPackedIds::KPackedIds()
+	: d_bitsPerId( 0 )
+	, d_mask( 0 )
+	, d_count( 0 )
+{
+}
+
+void KPackedIds::init(
+	const std::uint32_t maxId,
+	const std::size_t reservedCount )
+{
+	d_bitsPerId = 1;
+	while ( ( std::uint64_t( maxId ) >> d_bitsPerId ) != 0 )
+		++d_bitsPerId;
+	d_mask = ( std::uint64_t( 1 ) << d_bitsPerId ) - 1;
+	d_bytes.reserve( calcBytesCount( reservedCount ) );
+}
+
+void KPackedIds::shrink()
+{
+	d_bytes.shrink_to_fit();
+}
+
+std::size_t KPackedIds::size() const
+{
+	return d_count;
+}
+
+inline void KPackedIds::push_back( const std::uint32_t id )
+{
+	assert( ( id & d_mask ) == id );
+	const std::size_t bitIndex = d_count * d_bitsPerId;
+	++d_count;
+	d_bytes.resize( calcBytesCount( d_count ), 0 );
+
+	std::uint64_t word = 0;
+	std::uint8_t* bytes = d_bytes.data() + ( bitIndex >> 3 );
+	memcpy( &word, bytes, sizeof( word ) );
+	word |= std::uint64_t( id ) << ( bitIndex & 7 );
+	memcpy( bytes, &word, sizeof( word ) );
+}
+
+inline std::uint32_t KPackedIds::operator[]( const std::size_t index ) const
+{
+	assert( index < d_count );
+	const std::size_t bitIndex = index * d_bitsPerId;
+	std::uint64_t word = 0;
+	memcpy( &word, d_bytes.data() + ( bitIndex >> 3 ), sizeof( word ) );
+	const std::uint32_t result = static_cast< std::uint32_t >( ( word >> ( bitIndex & 7 ) ) & d_mask );
+	return result;
+}
+
+std::size_t KPackedIds::getMemorySize() const
+{
+	return utils::get_memory_size( d_bytes );
+}
+
+std::size_t KPackedIds::calcBytesCount( const std::size_t count ) const
+{
+	const std::size_t result = ( count * d_bitsPerId + 7 ) / 8 + sizeof( std::uint64_t );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	associated structures of all the nodes (except root) in one buffer, each
+	node refers to its range, the points are kept as their ids, i.e. indexes
+	(vide KSegmentsManager::getPointPosId), so they take half of the memory
+	of pointers on 64-bit targets, and the ranges lie next to each other
+
+	in the fast mode (vide EIndexMode) the lists are cascaded: for each item
+	d_left_ranks keeps how many items up to it (inclusive) belong to the
+	left child, the list of the child is the subsequence of the list of its
+	parent, so the lower bound found in the parent gives the lower bounds in
+	both children at once; a query makes only one binary search per path
+	of the tree instead of one per node (vide KSelectPoints::traversePath)
+
+	in the compact mode only the nodes at odd depths have their lists, the
+	points of the others are taken from the lists of their children, and
+	the lists are bit-packed; d_point_indexes_by_y is then only a scratch
+	buffer for the list being created
+*/
+struct SAssociatedStructures
+{
+	SAssociatedStructures(
+		const KSegmentsManager& segmentsManager,
+		EIndexMode indexMode );
+
+	void init( const point_positions_t& point_positions );
+	void shrink();
+
+	bool isListKept( std::size_t depth ) const;
+	bool hasList( const SRangeTreeNode* node ) const;
+	bool hasBridges() const;
+	// the list of the node was appended to d_point_indexes_by_y at offset
+	void addList(
+		SRangeTreeNode* node,
+		std::size_t offset );
+	void dropList( std::size_t offset );
+	void getList(
+		const SRangeTreeNode* node,
+		point_offsets_t* point_indexes ) const;
+
+	const std::uint32_t* begin( const SRangeTreeNode* node ) const;
+	const std::uint32_t* end( const SRangeTreeNode* node ) const;
+
+	// position in the list of the left child matching the position in the
+	// list of the node, the one in the right child is the rest
+	std::size_t getLeftPosition(
+		const SRangeTreeNode* node,
+		std::size_t position ) const;
+
+	std::size_t getMemorySize() const;
+
+	const SPointPos* d_points;
+	const EIndexMode d_indexMode;
+	point_offsets_t d_point_indexes_by_y;
+	point_offsets_t d_left_ranks;
+	KPackedIds d_packed_point_indexes_by_y;
+};
+
+SAssociatedStructures::SAssociatedStructures(
+	const KSegmentsManager& segmentsManager,
+	const EIndexMode indexMode )
+	: d_points( segmentsManager.getPointPosArray() )
+	, d_indexMode( indexMode )
+{
+}
+
+void SAssociatedStructures::init( const point_positions_t& point_positions )
+{
+	// each level of the tree below root holds at most all the points
+	const std::size_t pointsCount = point_positions.size();
+	std::size_t levelsCount = 0;
+	while ( ( std::size_t( 1 ) << levelsCount ) < pointsCount )
+		++levelsCount;
+
+	if ( d_indexMode == CompactIndexes )
+	{
+		// the ids are positions in the array of all the points, not only
+		// the vertices, so they are bounded by the greatest of them
+		std::uint32_t maxPointIndex = 0;
+		for ( const SPointPos* pointPos : point_positions )
+			maxPointIndex = std::max( maxPointIndex, static_cast< std::uint32_t >( pointPos - d_points ) );
+		const std::size_t keptLevelsCount = ( levelsCount + 1 ) / 2;
+		d_packed_point_indexes_by_y.init( maxPointIndex, pointsCount * keptLevelsCount );
+	}
+	else
+	{
+		d_point_indexes_by_y.reserve( pointsCount * levelsCount );
+		d_left_ranks.reserve( pointsCount * levelsCount );
+	}
+}
+
+void SAssociatedStructures::shrink()
+{
+	if ( d_indexMode == CompactIndexes )
+	{
+		point_offsets_t().swap( d_point_indexes_by_y );
+		d_packed_point_indexes_by_y.shrink();
+	}
+}
+
+bool SAssociatedStructures::isListKept( const std::size_t depth ) const
+{
+	const bool result = ( d_indexMode == FastIndexes ) || utils::is_odd( depth );
+	return result;
+}
+
+bool SAssociatedStructures::hasList( const SRangeTreeNode* node ) const
+{
+	// nodes have at least two points, so empty range means no list
+	return node->d_point_indexes_count != 0;
+}
+
+bool SAssociatedStructures::hasBridges() const
+{
+	return d_indexMode == FastIndexes;
+}
+
+void SAssociatedStructures::addList(
+	SRangeTreeNode* node,
+	const std::size_t offset )
+{
+	const std::size_t count = d_point_indexes_by_y.size() - offset;
+	if ( d_indexMode == CompactIndexes )
+	{
+		node->d_point_indexes_offset = static_cast< std::uint32_t >( d_packed_point_indexes_by_y.size() );
+		for ( auto it = d_point_indexes_by_y.begin() + offset
+			; it != d_point_indexes_by_y.end()
+			; ++it )
+		{
+			d_packed_point_indexes_by_y.push_back( *it );
+		}
+		d_point_indexes_by_y.resize( offset );
+	}
+	else
+	{
+		// the left child holds the points up to the split one by x
+		assert( d_left_ranks.size() == offset );
+		const SPointPos* splitPointPos = node->d_pointPos;
+		std::uint32_t leftRank = 0;
+		for ( auto it = d_point_indexes_by_y.begin() + offset
+			; it != d_point_indexes_by_y.end()
+			; ++it )
+		{
+			if ( !utils::less_by_x( splitPointPos, d_points + *it ) )
+				++leftRank;
+			d_left_ranks.push_back( leftRank );
+		}
+		node->d_point_indexes_offset = static_cast< std::uint32_t >( offset );
+	}
+	node->d_point_indexes_count = static_cast< std::uint32_t >( count );
+}
+
+void SAssociatedStructures::dropList( const std::size_t offset )
+{
+	d_point_indexes_by_y.resize( offset );
+}
+
+void SAssociatedStructures::getList(
+	const SRangeTreeNode* node,
+	point_offsets_t* point_indexes ) const
+{
+	assert( hasList( node ) );
+	if ( d_indexMode == CompactIndexes )
+	{
+		const std::size_t offset = node->d_point_indexes_offset;
+		for ( std::size_t i = 0; i < node->d_point_indexes_count; ++i )
+			point_indexes->push_back( d_packed_point_indexes_by_y[ offset + i ] );
+	}
+	else
+	{
+		point_indexes->insert( point_indexes->end(), begin( node ), end( node ) );
+	}
+}
+
+const std::uint32_t* SAssociatedStructures::begin( const SRangeTreeNode* node ) const
+{
+	assert( d_indexMode == FastIndexes );
+	return d_point_indexes_by_y.data() + node->d_point_indexes_offset;
+}
+
+const std::uint32_t* SAssociatedStructures::end( const SRangeTreeNode* node ) const
+{
+	return begin( node ) + node->d_point_indexes_count;
+}
+
+inline std::size_t SAssociatedStructures::getLeftPosition(
+	const SRangeTreeNode* node,
+	const std::size_t position ) const
+{
+	assert( hasBridges() && ( position <= node->d_point_indexes_count ) );
+	const std::size_t result
+		= ( position != 0 )
+		? d_left_ranks[ node->d_point_indexes_offset + position - 1 ]
+		: 0;
+	return result;
+}
+
+std::size_t SAssociatedStructures::getMemorySize() const
+{
+	const std::size_t result = utils::get_memory_size( d_point_indexes_by_y )
+		+ utils::get_memory_size( d_left_ranks )
+		+ d_packed_point_indexes_by_y.getMemorySize();
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+// utils::compare_by_y for the indexes of the points
+class KComparePointIndexesByY
+{
+	public:
+		explicit KComparePointIndexesByY( const SPointPos* points );
+
+	public:
+		bool operator()( std::uint32_t lhs, std::uint32_t rhs ) const;
+		bool operator()( std::uint32_t pointIndex, const SViewportBorder& edge ) const;
+
+	private:
+		const SPointPos* d_points;
+
+};
+
+KComparePointIndexesByY::KComparePointIndexesByY( const SPointPos* points )
+	: d_points( points )
+{
+}
+
+bool KComparePointIndexesByY::operator()(
+	const std::uint32_t lhs,
+	const std::uint32_t rhs ) const
+{
+	const bool result = utils::less_by_y( d_points + lhs, d_points + rhs );
+	return result;
+}
+
+bool KComparePointIndexesByY::operator()(
+	const std::uint32_t pointIndex,
+	const SViewportBorder& edge ) const
+{
+	const bool result = utils::less_by_y( d_points + pointIndex, edge );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	the tree is built bottom up like in the merge sort, the points of the
+	node [begin, end) are the ones of its children [begin, middle) and
+	[middle, end), each part already sorted by y, so the list of the node is
+	merged from them in linear time instead of being sorted, i.e. the whole
+	build takes O(n log n) instead of O(n log^2 n); the merged list is
+	written back in place for the parent, even if the node doesn't keep it
+*/
 class KCreateAssociatedStructure : public KRangeTreeItemVisitor
 {
 	public:
 		KCreateAssociatedStructure(
-			point_positions_cit begin,
-			point_positions_cit end );
+			point_offsets_t::iterator begin,
+			point_offsets_t::iterator middle,
+			point_offsets_t::iterator end,
+			bool isListKept,
+			SAssociatedStructures* associatedStructures );
 
 	public:
 		void visitRoot( SRangeTreeRoot* root ) override;
 		void visitNode( SRangeTreeNode* node ) override;
 
 	private:
-		point_positions_cit d_begin;
-		point_positions_cit d_end;
+		point_offsets_t::iterator d_begin;
+		point_offsets_t::iterator d_middle;
+		point_offsets_t::iterator d_end;
+		const bool d_isListKept;
+		SAssociatedStructures& d_associatedStructures;
 
 };
 
 KCreateAssociatedStructure::KCreateAssociatedStructure(
-	point_positions_cit begin,
-	point_positions_cit end )
+	point_offsets_t::iterator begin,
+	point_offsets_t::iterator middle,
+	point_offsets_t::iterator end,
+	const bool isListKept,
+	SAssociatedStructures* associatedStructures )
 	: d_begin( begin )
+	, d_middle( middle )
 	, d_end( end )
+	, d_isListKept( isListKept )
+	, d_associatedStructures( *associatedStructures )
 {
 }
 
@@ -394,13 +755,109 @@ void KCreateAssociatedStructure::visitRoot( SRangeTreeRoot* /*root*/ )
 
 void KCreateAssociatedStructure::visitNode( SRangeTreeNode* node )
 {
-	point_positions_t point_positions_by_y( d_begin, d_end );
-	std::sort(
-		point_positions_by_y.begin(),
-		point_positions_by_y.end(),
-		utils::compare_by_y() );
+	const KComparePointIndexesByY compareByY( d_associatedStructures.d_points );
+	assert( utils::is_sorted( d_begin, d_middle, compareByY ) );
+	assert( utils::is_sorted( d_middle, d_end, compareByY ) );
+
+	// the order is total (vide utils::less_by_y), so the merged list is the
+	// same as the sorted one
+	point_offsets_t& point_indexes_by_y = d_associatedStructures.d_point_indexes_by_y;
+	const std::size_t offset = point_indexes_by_y.size();
+	std::merge( d_begin, d_middle, d_middle, d_end, std::back_inserter( point_indexes_by_y ), compareByY );
+	std::copy( point_indexes_by_y.begin() + offset, point_indexes_by_y.end(), d_begin );
+
+	if ( d_isListKept )
+		d_associatedStructures.addList( node, offset );
+	else
+		d_associatedStructures.dropList( offset );
+}
+
+// ----------------------------------------------------------------------------
+
+class KLoadAssociatedStructure : public KRangeTreeItemVisitor
+{
+	public:
+		// the list is read anyway, if it is not kept it is just skipped
+		KLoadAssociatedStructure(
+			KIndexImageReader* image,
+			point_positions_cit begin,
+			point_positions_cit end,
+			const std::vector< bool >& isTreePoint,
+			bool isListKept,
+			SAssociatedStructures* associatedStructures );
+
+	public:
+		void visitRoot( SRangeTreeRoot* root ) override;
+		void visitNode( SRangeTreeNode* node ) override;
+
+	private:
+		bool isNodePoint( std::uint32_t pointIndex ) const;
+
+	private:
+		KIndexImageReader* d_image;
+		point_positions_cit d_begin;
+		point_positions_cit d_end;
+		const std::vector< bool >& d_isTreePoint;
+		const bool d_isListKept;
+		SAssociatedStructures& d_associatedStructures;
+
+};
+
+KLoadAssociatedStructure::KLoadAssociatedStructure(
+	KIndexImageReader* image,
+	point_positions_cit begin,
+	point_positions_cit end,
+	const std::vector< bool >& isTreePoint,
+	const bool isListKept,
+	SAssociatedStructures* associatedStructures )
+	: d_image( image )
+	, d_begin( begin )
+	, d_end( end )
+	, d_isTreePoint( isTreePoint )
+	, d_isListKept( isListKept )
+	, d_associatedStructures( *associatedStructures )
+{
+}
 
-	node->d_point_positions_by_y.swap( point_positions_by_y );
+void KLoadAssociatedStructure::visitRoot( SRangeTreeRoot* /*root*/ )
+{
+	// root has no associated structure
+}
+
+void KLoadAssociatedStructure::visitNode( SRangeTreeNode* node )
+{
+	// the image holds the points already sorted by y, no need to sort again,
+	// but the order is checked, so is the list: the count is implied by the
+	// shape, so the unique points of the node make up the whole of it
+	point_offsets_t& point_indexes_by_y = d_associatedStructures.d_point_indexes_by_y;
+	const std::size_t offset = point_indexes_by_y.size();
+	d_image->getPointIndexes( std::distance( d_begin, d_end ), &point_indexes_by_y );
+	const auto begin = point_indexes_by_y.begin() + offset;
+	const auto end = point_indexes_by_y.end();
+	bool valid = utils::is_sorted( begin, end, KComparePointIndexesByY( d_associatedStructures.d_points ) );
+	for ( auto it = begin
+		; valid && ( it != end )
+		; ++it )
+	{
+		valid = isNodePoint( *it );
+	}
+	d_image->checkItem( valid );
+
+	if ( d_isListKept )
+		d_associatedStructures.addList( node, offset );
+	else
+		d_associatedStructures.dropList( offset );
+}
+
+bool KLoadAssociatedStructure::isNodePoint( const std::uint32_t pointIndex ) const
+{
+	// the points of the tree are sorted by x, so the ones of the node are
+	// between its first and last one
+	const SPointPos* pointPos = d_associatedStructures.d_points + pointIndex;
+	const bool result = d_isTreePoint[ pointIndex ]
+		&& !utils::less_by_x( pointPos, *d_begin )
+		&& !utils::less_by_x( *( d_end - 1 ), pointPos );
+	return result;
 }
 
 // ----------------------------------------------------------------------------
@@ -409,7 +866,11 @@ void KCreateAssociatedStructure::visitNode( SRangeTreeNode* node )
 class KRangeTreeBuilder
 {
 	public:
-		KRangeTreeBuilder() = default;
+		// if image is passed, then associated structures are loaded from it
+		KRangeTreeBuilder(
+			KArena* arena,
+			SAssociatedStructures* associatedStructures,
+			KIndexImageReader* image = nullptr );
 
 	public:
 		SRangeTreeItem* run( const point_positions_t& point_positions_by_x );
@@ -418,26 +879,78 @@ class KRangeTreeBuilder
 		template< typename TTreeNode >
 		SRangeTreeItem* createItem(
 			point_positions_cit begin,
-			point_positions_cit end );
+			point_positions_cit end,
+			std::size_t depth );
 
 		template< typename TTreeNode >
 		SRangeTreeItem* createNode(
 			point_positions_cit begin,
 			point_positions_cit v_split_node_it,
-			point_positions_cit end );
+			point_positions_cit end,
+			std::size_t depth );
 
 		SRangeTreeItem* createLeaf(
 			const SPointPos* pointPos );
 
+		point_offsets_t::iterator getPointIndexesIt( point_positions_cit it );
+
+	private:
+		KArena* d_arena;
+		SAssociatedStructures* d_associatedStructures;
+		KIndexImageReader* d_image;
+		// while loading: the points of the tree by their indexes
+		std::vector< bool > d_isTreePoint;
+
+		// while building: the indexes of the points in the order by x, the
+		// range of each created subtree is sorted by y (vide
+		// KCreateAssociatedStructure)
+		point_positions_cit d_point_positions_begin;
+		point_offsets_t d_point_indexes;
+
 };
 
 // ----------------------------------------------------------------------------
 
+KRangeTreeBuilder::KRangeTreeBuilder(
+	KArena* arena,
+	SAssociatedStructures* associatedStructures,
+	KIndexImageReader* image )
+	: d_arena( arena )
+	, d_associatedStructures( associatedStructures )
+	, d_image( image )
+{
+}
+
 SRangeTreeItem* KRangeTreeBuilder::run( const point_positions_t& point_positions_by_x )
 {
+	d_associatedStructures->init( point_positions_by_x );
+
 	auto begin = point_positions_by_x.begin();
 	auto end = point_positions_by_x.end();
-	SRangeTreeItem* root = createItem< SRangeTreeRoot >( begin, end );
+	const SPointPos* points = d_associatedStructures->d_points;
+	if ( d_image == nullptr )
+	{
+		d_point_positions_begin = begin;
+		d_point_indexes.reserve( point_positions_by_x.size() );
+		for ( const SPointPos* pointPos : point_positions_by_x )
+			d_point_indexes.push_back( static_cast< std::uint32_t >( pointPos - points ) );
+	}
+	else
+	{
+		for ( const SPointPos* pointPos : point_positions_by_x )
+		{
+			const std::size_t pointIndex = pointPos - points;
+			if ( d_isTreePoint.size() <= pointIndex )
+				d_isTreePoint.resize( pointIndex + 1, false );
+			d_isTreePoint[ pointIndex ] = true;
+		}
+	}
+
+	SRangeTreeItem* root = createItem< SRangeTreeRoot >( begin, end, 0 );
+
+	point_offsets_t().swap( d_point_indexes );
+	std::vector< bool >().swap( d_isTreePoint );
+	d_associatedStructures->shrink();
 	return root;
 }
 
@@ -446,7 +959,8 @@ SRangeTreeItem* KRangeTreeBuilder::run( const point_positions_t& point_positions
 template< typename TTreeNode >
 SRangeTreeItem* KRangeTreeBuilder::createItem(
 	point_positions_cit begin,
-	point_positions_cit end )
+	point_positions_cit end,
+	const std::size_t depth )
 {
 	SRangeTreeItem* result = nullptr;
 	const std::size_t subtreeNodeCount = std::distance( begin, end );
@@ -454,7 +968,7 @@ SRangeTreeItem* KRangeTreeBuilder::createItem(
 	{
 		auto v_split_node_it = utils::get_median( begin, end );
 		assert( v_split_node_it != end );
-		result = createNode< TTreeNode >( begin, v_split_node_it, end );
+		result = createNode< TTreeNode >( begin, v_split_node_it, end, depth );
 	}
 	else if ( subtreeNodeCount == 1 )
 	{
@@ -468,28 +982,172 @@ template< typename TTreeNode >
 SRangeTreeItem* KRangeTreeBuilder::createNode(
 	point_positions_cit begin,
 	point_positions_cit v_split_node_it,
-	point_positions_cit end )
+	point_positions_cit end,
+	const std::size_t depth )
 {
 	const SPointPos* pointPos = *v_split_node_it;
-	SRangeTreeNodeBase* node = new TTreeNode( pointPos );
+	SRangeTreeNodeBase* node = d_arena->create< TTreeNode >( pointPos );
 
-	KCreateAssociatedStructure createAssociatedStructure( begin, end );
-	node->accept( &createAssociatedStructure );
+	// the image holds the lists in preorder, while the created ones are
+	// merged from the lists of the children
+	const bool isListKept = d_associatedStructures->isListKept( depth );
+	if ( d_image != nullptr )
+	{
+		KLoadAssociatedStructure loadAssociatedStructure(
+			d_image,
+			begin,
+			end,
+			d_isTreePoint,
+			isListKept,
+			d_associatedStructures );
+		node->accept( &loadAssociatedStructure );
+	}
 
 	auto lbegin = begin;
 	auto lend = v_split_node_it + 1;
-	node->d_leftChild = createItem< SRangeTreeNode >( lbegin, lend );
+	node->d_leftChild = createItem< SRangeTreeNode >( lbegin, lend, depth + 1 );
 
 	auto rbegin = lend;
 	auto rend = end;
-	node->d_rightChild = createItem< SRangeTreeNode >( rbegin, rend );
+	node->d_rightChild = createItem< SRangeTreeNode >( rbegin, rend, depth + 1 );
+
+	if ( d_image == nullptr )
+	{
+		KCreateAssociatedStructure createAssociatedStructure(
+			getPointIndexesIt( begin ),
+			getPointIndexesIt( lend ),
+			getPointIndexesIt( end ),
+			isListKept,
+			d_associatedStructures );
+		node->accept( &createAssociatedStructure );
+	}
 
 	return node;
 }
 
 SRangeTreeItem* KRangeTreeBuilder::createLeaf( const SPointPos* pointPos )
 {
-	return new SRangeTreeLeaf( pointPos );
+	return d_arena->create< SRangeTreeLeaf >( pointPos );
+}
+
+point_offsets_t::iterator KRangeTreeBuilder::getPointIndexesIt( point_positions_cit it )
+{
+	const auto result = d_point_indexes.begin() + std::distance( d_point_positions_begin, it );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+// gathers leaves from left to right, i.e. all points sorted by x
+class KGatherLeaves : public KRangeTreeItemVisitor
+{
+	public:
+		explicit KGatherLeaves( point_positions_t* point_positions );
+
+	public:
+		void visitNodeBase( SRangeTreeNodeBase* node ) override;
+		void visitLeaf( SRangeTreeLeaf* leaf ) override;
+
+	private:
+		point_positions_t& d_point_positions;
+
+};
+
+KGatherLeaves::KGatherLeaves( point_positions_t* point_positions )
+	: d_point_positions( *point_positions )
+{
+}
+
+void KGatherLeaves::visitNodeBase( SRangeTreeNodeBase* node )
+{
+	SRangeTreeItem* leftChild = node->getLeftChild();
+	if ( leftChild != nullptr )
+		leftChild->accept( this );
+
+	SRangeTreeItem* rightChild = node->getRightChild();
+	if ( rightChild != nullptr )
+		rightChild->accept( this );
+}
+
+void KGatherLeaves::visitLeaf( SRangeTreeLeaf* leaf )
+{
+	d_point_positions.push_back( leaf->d_pointPos );
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	stores associated structures of nodes in preorder, the image is the same
+	in both modes (vide EIndexMode), so the lists dropped in the compact mode
+	are recreated from the leaves
+*/
+class KStoreAssociatedStructures : public KRangeTreeItemVisitor
+{
+	public:
+		KStoreAssociatedStructures(
+			const SAssociatedStructures& associatedStructures,
+			KIndexImageWriter* image );
+
+	public:
+		void visitNodeBase( SRangeTreeNodeBase* node ) override;
+		void visitNode( SRangeTreeNode* node ) override;
+		void visitLeaf( SRangeTreeLeaf* leaf ) override;
+
+	private:
+		const SAssociatedStructures& d_associatedStructures;
+		KIndexImageWriter* d_image;
+		point_offsets_t d_point_indexes;
+		point_positions_t d_point_positions;
+
+};
+
+KStoreAssociatedStructures::KStoreAssociatedStructures(
+	const SAssociatedStructures& associatedStructures,
+	KIndexImageWriter* image )
+	: d_associatedStructures( associatedStructures )
+	, d_image( image )
+{
+}
+
+void KStoreAssociatedStructures::visitNodeBase( SRangeTreeNodeBase* node )
+{
+	SRangeTreeItem* leftChild = node->getLeftChild();
+	if ( leftChild != nullptr )
+		leftChild->accept( this );
+
+	SRangeTreeItem* rightChild = node->getRightChild();
+	if ( rightChild != nullptr )
+		rightChild->accept( this );
+}
+
+void KStoreAssociatedStructures::visitNode( SRangeTreeNode* node )
+{
+	d_point_indexes.clear();
+	if ( d_associatedStructures.hasList( node ) )
+	{
+		d_associatedStructures.getList( node, &d_point_indexes );
+	}
+	else
+	{
+		const SPointPos* points = d_associatedStructures.d_points;
+		d_point_positions.clear();
+		KGatherLeaves gatherLeaves( &d_point_positions );
+		node->accept( &gatherLeaves );
+		for ( const SPointPos* pointPos : d_point_positions )
+			d_point_indexes.push_back( static_cast< std::uint32_t >( pointPos - points ) );
+		std::sort( d_point_indexes.begin(), d_point_indexes.end(), KComparePointIndexesByY( points ) );
+	}
+
+	for ( const std::uint32_t pointIndex : d_point_indexes )
+		d_image->putId( point_pos_id_t( pointIndex ) );
+
+	visitNodeBase( node );
+}
+
+void KStoreAssociatedStructures::visitLeaf( SRangeTreeLeaf* /*leaf*/ )
+{
+	// leaves have no associated structures
 }
 
 // ----------------------------------------------------------------------------
@@ -499,6 +1157,8 @@ class KSelectSubtreePoints : public KRangeTreeItemVisitor
 {
 	public:
 		KSelectSubtreePoints(
+			const KSegmentsManager& segmentsManager,
+			const SAssociatedStructures& associatedStructures,
 			const KViewportArea& viewportArea,
 			point_ids_t* pointids );
 
@@ -506,65 +1166,149 @@ class KSelectSubtreePoints : public KRangeTreeItemVisitor
 		void visitNode( SRangeTreeNode* node ) override;
 		void visitDefault( SRangeTreeItem* item ) override;
 
+	public:
+		std::size_t findListLowerBound( const SRangeTreeNode* node ) const;
+		// the points of the list from its lower bound (vide findListLowerBound)
+		void selectListPoints(
+			const SRangeTreeNode* node,
+			std::size_t lowerBound );
+
 	private:
+		void selectPackedListPoints( const SRangeTreeNode* node );
 		void addPoint( const SPointPos* pointPos );
 
 	private:
+		const KSegmentsManager& d_segmentsManager;
+		const SAssociatedStructures& d_associatedStructures;
 		const KViewportArea& d_viewportArea;
 		point_ids_t& d_pointids;
 
 };
 
 KSelectSubtreePoints::KSelectSubtreePoints(
+	const KSegmentsManager& segmentsManager,
+	const SAssociatedStructures& associatedStructures,
 	const KViewportArea& viewportArea,
 	point_ids_t* pointids )
-	: d_viewportArea( viewportArea )
+	: d_segmentsManager( segmentsManager )
+	, d_associatedStructures( associatedStructures )
+	, d_viewportArea( viewportArea )
 	, d_pointids( *pointids )
 {
 }
 
 void KSelectSubtreePoints::visitNode( SRangeTreeNode* node )
 {
-	const point_positions_t& point_positions_by_y = node->d_point_positions_by_y;
+	if ( !d_associatedStructures.hasList( node ) )
+	{
+		// compact mode, the points are in the lists of the children
+		SRangeTreeItem* leftChild = node->getLeftChild();
+		if ( leftChild != nullptr )
+			leftChild->accept( this );
+
+		SRangeTreeItem* rightChild = node->getRightChild();
+		if ( rightChild != nullptr )
+			rightChild->accept( this );
+	}
+	else if ( d_associatedStructures.d_indexMode == CompactIndexes )
+	{
+		selectPackedListPoints( node );
+	}
+	else
+	{
+		selectListPoints( node, findListLowerBound( node ) );
+	}
+}
+
+std::size_t KSelectSubtreePoints::findListLowerBound( const SRangeTreeNode* node ) const
+{
+	const std::uint32_t* point_indexes_by_y_begin = d_associatedStructures.begin( node );
+	const std::uint32_t* point_indexes_by_y_end = d_associatedStructures.end( node );
+	const KComparePointIndexesByY compare_by_y( d_associatedStructures.d_points );
 
 	const SViewportBorder& topEdge = d_viewportArea.getTopEdge();
-	auto begin
+	auto lowerBound
 		= std::lower_bound(
-			point_positions_by_y.begin()
-			, point_positions_by_y.end()
+			point_indexes_by_y_begin
+			, point_indexes_by_y_end
 			, topEdge
-			, utils::compare_by_y() );
+			, compare_by_y );
 
-	const SViewportBorder& bottomEdge = d_viewportArea.getBottomEdge();
-	auto end
-		= std::upper_bound(
-			point_positions_by_y.begin()
-			, point_positions_by_y.end()
-			, bottomEdge
-			, utils::compare_by_y() );
+	const std::size_t result = std::distance( point_indexes_by_y_begin, lowerBound );
+	return result;
+}
 
-	for ( auto it = begin
-		; it != end
+void KSelectSubtreePoints::selectListPoints(
+	const SRangeTreeNode* node,
+	const std::size_t lowerBound )
+{
+	const std::uint32_t* point_indexes_by_y_end = d_associatedStructures.end( node );
+	const SPointPos* points = d_associatedStructures.d_points;
+	const SViewportBorder& bottomEdge = d_viewportArea.getBottomEdge();
+	for ( const std::uint32_t* it = d_associatedStructures.begin( node ) + lowerBound
+		; it != point_indexes_by_y_end
 		; ++it )
 	{
-		const SPointPos* pointPos = *it;
-		assert( d_viewportArea.contains( pointPos->d_point ) );
-		addPoint( pointPos );
+		const std::uint32_t pointIndex = *it;
+		if ( utils::less_by_y( bottomEdge, points + pointIndex ) )
+			break;
+
+		assert( d_viewportArea.contains( points[ pointIndex ].getPoint() ) );
+		d_pointids.push_back( point_pos_id_t( pointIndex ) );
+	}
+}
+
+// the ids are decoded on demand, i.e. only the ones probed by the binary
+// search and the selected ones
+void KSelectSubtreePoints::selectPackedListPoints( const SRangeTreeNode* node )
+{
+	const KPackedIds& point_indexes_by_y = d_associatedStructures.d_packed_point_indexes_by_y;
+	const SPointPos* points = d_associatedStructures.d_points;
+
+	// lower bound of the top edge
+	const SViewportBorder& topEdge = d_viewportArea.getTopEdge();
+	std::size_t begin = node->d_point_indexes_offset;
+	std::size_t count = node->d_point_indexes_count;
+	while ( 0 < count )
+	{
+		const std::size_t step = count / 2;
+		const std::size_t middle = begin + step;
+		if ( utils::less_by_y( points + point_indexes_by_y[ middle ], topEdge ) )
+		{
+			begin = middle + 1;
+			count -= step + 1;
+		}
+		else
+		{
+			count = step;
+		}
+	}
+
+	const SViewportBorder& bottomEdge = d_viewportArea.getBottomEdge();
+	const std::size_t end = node->d_point_indexes_offset + node->d_point_indexes_count;
+	for ( std::size_t i = begin; i != end; ++i )
+	{
+		const std::uint32_t pointIndex = point_indexes_by_y[ i ];
+		if ( utils::less_by_y( bottomEdge, points + pointIndex ) )
+			break;
+
+		assert( d_viewportArea.contains( points[ pointIndex ].getPoint() ) );
+		d_pointids.push_back( point_pos_id_t( pointIndex ) );
 	}
 }
 
 void KSelectSubtreePoints::visitDefault( SRangeTreeItem* item )
 {
 	const SPointPos* pointPos = item->d_pointPos;
-	const SPoint& point = pointPos->d_point;
+	const SPoint& point = pointPos->getPoint();
 	if ( d_viewportArea.contains( point ) )
 		addPoint( pointPos );
 }
 
 void KSelectSubtreePoints::addPoint( const SPointPos* pointPos )
 {
-	assert( d_viewportArea.contains( pointPos->d_point ) );
-	const point_pos_id_t pointid = pointPos->d_id;
+	assert( d_viewportArea.contains( pointPos->getPoint() ) );
+	const point_pos_id_t pointid = d_segmentsManager.getPointPosId( pointPos );
 	d_pointids.push_back( pointid );
 }
 
@@ -575,6 +1319,8 @@ class KSelectPoints
 {
 	public:
 		KSelectPoints(
+			const KSegmentsManager& segmentsManager,
+			const SAssociatedStructures& associatedStructures,
 			SRangeTreeItem* root,
 			const KViewportArea& viewportArea,
 			point_ids_t* pointids );
@@ -591,9 +1337,19 @@ class KSelectPoints
 		void traverseRightSubtree(
 			SRangeTreeItem* subtreeRoot,
 			KSelectSubtreePoints* selectSubtreePoints );
+		template< bool isLeftPath >
+		void traversePath(
+			SRangeTreeItem* pathRoot,
+			KSelectSubtreePoints* selectSubtreePoints );
+		void selectChildPoints(
+			SRangeTreeItem* child,
+			std::size_t lowerBound,
+			KSelectSubtreePoints* selectSubtreePoints );
 		void addSectPosIfInArea( SRangeTreeItem* node );
 
 	private:
+		const KSegmentsManager& d_segmentsManager;
+		const SAssociatedStructures& d_associatedStructures;
 		SRangeTreeItem* d_root;
 		const KViewportArea& d_viewportArea;
 		point_ids_t& d_pointids;
@@ -603,10 +1359,14 @@ class KSelectPoints
 // ----------------------------------------------------------------------------
 
 KSelectPoints::KSelectPoints(
+	const KSegmentsManager& segmentsManager,
+	const SAssociatedStructures& associatedStructures,
 	SRangeTreeItem* root,
 	const KViewportArea& viewportArea,
 	point_ids_t* pointids )
-	: d_root( root )
+	: d_segmentsManager( segmentsManager )
+	, d_associatedStructures( associatedStructures )
+	, d_root( root )
 	, d_viewportArea( viewportArea )
 	, d_pointids( *pointids )
 {
@@ -658,9 +1418,21 @@ void KSelectPoints::traverseSubtree( SRangeTreeItem* subtreeRoot )
 	}
 	else
 	{
-		KSelectSubtreePoints selectSubtreePoints( d_viewportArea, &d_pointids );
-		traverseLeftSubtree( subtreeRoot, &selectSubtreePoints );
-		traverseRightSubtree( subtreeRoot, &selectSubtreePoints );
+		KSelectSubtreePoints selectSubtreePoints(
+			d_segmentsManager,
+			d_associatedStructures,
+			d_viewportArea,
+			&d_pointids );
+		if ( d_associatedStructures.hasBridges() )
+		{
+			traversePath< true >( subtreeRoot->getLeftChild(), &selectSubtreePoints );
+			traversePath< false >( subtreeRoot->getRightChild(), &selectSubtreePoints );
+		}
+		else
+		{
+			traverseLeftSubtree( subtreeRoot, &selectSubtreePoints );
+			traverseRightSubtree( subtreeRoot, &selectSubtreePoints );
+		}
 	}
 }
 
@@ -712,15 +1484,85 @@ void KSelectPoints::traverseRightSubtree(
 	addSectPosIfInArea( node );
 }
 
+/*
+	the same as traverseLeftSubtree / traverseRightSubtree, but the lists are
+	cascaded (vide SAssociatedStructures), so the lower bound is searched only
+	in the first node of the path, then it follows the bridges down to the
+	nodes of the path and the subtrees hanging off it; the nodes below root
+	are never SRangeTreeRoot, so the inner ones are SRangeTreeNode
+*/
+template< bool isLeftPath >
+void KSelectPoints::traversePath(
+	SRangeTreeItem* pathRoot,
+	KSelectSubtreePoints* selectSubtreePoints )
+{
+	SRangeTreeItem* node = pathRoot;
+	std::size_t lowerBound = 0;
+	if ( ( node != nullptr ) && !node->isLeaf() )
+		lowerBound = selectSubtreePoints->findListLowerBound( static_cast< SRangeTreeNode* >( node ) );
+
+	const SViewportBorder& edge = isLeftPath ? d_viewportArea.getLeftEdge() : d_viewportArea.getRightEdge();
+	while ( ( node != nullptr ) && !node->isLeaf() )
+	{
+		const SRangeTreeNode* treeNode = static_cast< SRangeTreeNode* >( node );
+		const std::size_t leftLowerBound = d_associatedStructures.getLeftPosition( treeNode, lowerBound );
+		const std::size_t rightLowerBound = lowerBound - leftLowerBound;
+		const SPointPos* pointPos = node->d_pointPos;
+		if ( isLeftPath )
+		{
+			if ( utils::less_by_x( edge, pointPos ) )
+			{
+				selectChildPoints( node->getRightChild(), rightLowerBound, selectSubtreePoints );
+				node = node->getLeftChild();
+				lowerBound = leftLowerBound;
+			}
+			else
+			{
+				node = node->getRightChild();
+				lowerBound = rightLowerBound;
+			}
+		}
+		else
+		{
+			if ( utils::less_by_x( pointPos, edge ) )
+			{
+				selectChildPoints( node->getLeftChild(), leftLowerBound, selectSubtreePoints );
+				node = node->getRightChild();
+				lowerBound = rightLowerBound;
+			}
+			else
+			{
+				node = node->getLeftChild();
+				lowerBound = leftLowerBound;
+			}
+		}
+	}
+	addSectPosIfInArea( node );
+}
+
+void KSelectPoints::selectChildPoints(
+	SRangeTreeItem* child,
+	const std::size_t lowerBound,
+	KSelectSubtreePoints* selectSubtreePoints )
+{
+	if ( child != nullptr )
+	{
+		if ( child->isLeaf() )
+			addSectPosIfInArea( child );
+		else
+			selectSubtreePoints->selectListPoints( static_cast< SRangeTreeNode* >( child ), lowerBound );
+	}
+}
+
 void KSelectPoints::addSectPosIfInArea( SRangeTreeItem* node )
 {
 	if ( ( node != nullptr ) && node->isLeaf() )
 	{
 		const SPointPos* pointPos = node->d_pointPos;
-		const SPoint& nodePoint = pointPos->d_point;
+		const SPoint& nodePoint = pointPos->getPoint();
 		if ( d_viewportArea.contains( nodePoint ) )
 		{
-			const point_pos_id_t pointid = pointPos->d_id;
+			const point_pos_id_t pointid = d_segmentsManager.getPointPosId( pointPos );
 			d_pointids.push_back( pointid );
 		}
 	}
@@ -733,23 +1575,30 @@ void KSelectPoints::addSectPosIfInArea( SRangeTreeItem* node )
 
 struct KRangeTree::Impl
 {
-	Impl( SRangeTreeItem* root );
-	~Impl();
+	Impl(
+		const KSegmentsManager& segmentsManager,
+		EIndexMode indexMode );
 
+	const KSegmentsManager& d_segmentsManager;
+	SAssociatedStructures d_associatedStructures;
+	// owned by the arena
 	SRangeTreeItem* d_root;
 };
 
-KRangeTree::Impl::Impl( SRangeTreeItem* root )
-	: d_root( root )
+KRangeTree::Impl::Impl(
+	const KSegmentsManager& segmentsManager,
+	const EIndexMode indexMode )
+	: d_segmentsManager( segmentsManager )
+	, d_associatedStructures( segmentsManager, indexMode )
+	, d_root( nullptr )
 {
 }
 
-KRangeTree::Impl::~Impl()
-{
-	delete d_root;
-}
-
-KRangeTree::KRangeTree( const KSegmentsManager& segmentsManager ) : impl( nullptr )
+KRangeTree::KRangeTree(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena,
+	const EIndexMode indexMode )
+	: impl( nullptr )
 {
 	point_positions_t point_positions;
 	if ( segmentsManager.getPointPositions( &point_positions ) )
@@ -757,10 +1606,42 @@ KRangeTree::KRangeTree( const KSegmentsManager& segmentsManager ) : impl( nullpt
 		std::sort( point_positions.begin(), point_positions.end(), utils::compare_by_x() );
 		assert( std::adjacent_find(
 			point_positions.begin(), point_positions.end() ) == point_positions.end() ); // items should be unique
-		KRangeTreeBuilder treeBuilder;
-		SRangeTreeItem* root = treeBuilder.run( point_positions );
-		assert( KCheckRangeTreeConsistency::run( root, point_positions ) );
-		impl = new Impl( root );
+		impl = new Impl( segmentsManager, indexMode );
+		KRangeTreeBuilder treeBuilder( arena, &impl->d_associatedStructures );
+		impl->d_root = treeBuilder.run( point_positions );
+		assert( KCheckRangeTreeConsistency::run( impl->d_root, point_positions ) );
+	}
+}
+
+/*
+	image layout:
+	int points_count
+	int point_pos_id[ points_count ] - all vertices sorted by x, it determines
+		the shape of the tree (vide KRangeTreeBuilder)
+	int point_pos_id[ node points count ] * nodes - associated structures of
+		nodes (except root) in preorder, the counts are implied by the shape,
+		it is the same order as in SAssociatedStructures
+*/
+KRangeTree::KRangeTree(
+	const KSegmentsManager& segmentsManager,
+	KArena* arena,
+	const EIndexMode indexMode,
+	KIndexImageReader* image )
+	: impl( nullptr )
+{
+	point_positions_t point_positions;
+	const std::size_t pointsCount = image->getCount();
+	image->getPointPositions( pointsCount, &point_positions );
+	if ( !point_positions.empty() )
+	{
+		// the order determines the shape of the tree, so it has to be checked
+		// even in release, the unique points are sorted strictly
+		image->checkItem( utils::is_sorted( point_positions.begin(), point_positions.end(), utils::compare_by_x() ) );
+		std::unique_ptr< Impl > loadedImpl( new Impl( segmentsManager, indexMode ) );
+		KRangeTreeBuilder treeBuilder( arena, &loadedImpl->d_associatedStructures, image );
+		loadedImpl->d_root = treeBuilder.run( point_positions );
+		assert( KCheckRangeTreeConsistency::run( loadedImpl->d_root, point_positions ) );
+		impl = loadedImpl.release();
 	}
 }
 
@@ -777,9 +1658,43 @@ void KRangeTree::selectPoints(
 	{
 		SRangeTreeItem* root = impl->d_root;
 		assert( root != nullptr );
-		KSelectPoints selectPoints( root, viewportArea, pointids );
+		KSelectPoints selectPoints(
+			impl->d_segmentsManager,
+			impl->d_associatedStructures,
+			root,
+			viewportArea,
+			pointids );
 		selectPoints.run();
 	}
 }
 
+void KRangeTree::store( KIndexImageWriter* image ) const
+{
+	point_positions_t point_positions;
+	SRangeTreeItem* root = ( impl != nullptr ) ? impl->d_root : nullptr;
+	if ( root != nullptr )
+	{
+		KGatherLeaves gatherLeaves( &point_positions );
+		root->accept( &gatherLeaves );
+	}
+
+	image->putCount( point_positions.size() );
+	for ( const SPointPos* pointPos : point_positions )
+	{
+		image->putId( impl->d_segmentsManager.getPointPosId( pointPos ) );
+	}
+
+	if ( root != nullptr )
+	{
+		KStoreAssociatedStructures storeAssociatedStructures( impl->d_associatedStructures, image );
+		root->accept( &storeAssociatedStructures );
+	}
+}
+
+std::size_t KRangeTree::getListsMemorySize() const
+{
+	const std::size_t result = ( impl != nullptr ) ? impl->d_associatedStructures.getMemorySize() : 0;
+	return result;
+}
+
 } // namespace be
@@ -3,17 +3,30 @@
 #define INC_BE_RANGE_TREE_H
 
 #include "beInternalTypes.h"
+#include "beTypes.h"
 
 namespace be
 {
 
 class KSegmentsManager;
+class KArena;
 class KViewportArea;
+class KIndexImageReader;
+class KIndexImageWriter;
 
 class KRangeTree
 {
 	public:
-		KRangeTree( const KSegmentsManager& segmentsManager );
+		// the nodes are allocated in the arena, it has to outlive the tree
+		KRangeTree(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena,
+			EIndexMode indexMode );
+		KRangeTree(
+			const KSegmentsManager& segmentsManager,
+			KArena* arena,
+			EIndexMode indexMode,
+			KIndexImageReader* image );
 		~KRangeTree();
 
 	public:
@@ -21,6 +34,11 @@ class KRangeTree
 			const KViewportArea& viewportArea,
 			point_ids_t* pointids ) const;
 
+		void store( KIndexImageWriter* image ) const;
+
+		// bytes taken by the associated structures, the nodes are in the arena
+		std::size_t getListsMemorySize() const;
+
 	private:
 		struct Impl;
 		Impl* impl;
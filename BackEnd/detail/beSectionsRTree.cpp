@@ -0,0 +1,176 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beSectionsRTree.h"
+#include "beSegmentsManager.h"
+#include "beUtils.h"
+
+namespace be
+{
+
+namespace
+{
+
+// the edges belong to the boxes, the same as in SRect::contains
+inline bool doBoxesIntersect( const SRect& lhs, const SRect& rhs )
+{
+	const bool result = ( lhs.left <= rhs.right ) && ( rhs.left <= lhs.right )
+		&& ( lhs.top <= rhs.bottom ) && ( rhs.top <= lhs.bottom );
+	return result;
+}
+
+void mergeBox( const SRect& box, SRect* mergedBox )
+{
+	mergedBox->left = std::min( mergedBox->left, box.left );
+	mergedBox->top = std::min( mergedBox->top, box.top );
+	mergedBox->right = std::max( mergedBox->right, box.right );
+	mergedBox->bottom = std::max( mergedBox->bottom, box.bottom );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+KSectionsRTree::KSectionsRTree( const KSegmentsManager& segmentsManager )
+{
+	build( segmentsManager );
+}
+
+// ----------------------------------------------------------------------------
+
+bool KSectionsRTree::selectSections(
+	const SRect& viewportRect,
+	section_ids_t* sections ) const
+{
+	if ( !d_boxes.empty() )
+		collectSections( viewportRect, sections );
+
+	// the leaves are in the Hilbert order
+	std::sort( sections->begin(), sections->end() );
+	const bool result = !sections->empty();
+	return result;
+}
+
+std::size_t KSectionsRTree::getMemorySize() const
+{
+	const std::size_t result
+		= utils::get_memory_size( d_boxes )
+		+ utils::get_memory_size( d_levelOffsets )
+		+ utils::get_memory_size( d_sectionIds );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+void KSectionsRTree::build( const KSegmentsManager& segmentsManager )
+{
+	section_ids_t sectids;
+	if ( !segmentsManager.getSectionIds( &sectids ) )
+		return;
+
+	std::vector< SRect > sectionBoxes;
+	sectionBoxes.reserve( sectids.size() );
+	for ( const section_id_t sectid : sectids )
+		sectionBoxes.push_back( segmentsManager.getSectionRect( sectid ) );
+
+	SRect bounds = sectionBoxes.front();
+	for ( const SRect& box : sectionBoxes )
+		mergeBox( box, &bounds );
+
+	using key_t = std::pair< std::uint32_t, std::uint32_t >;
+	std::vector< key_t > keys;
+	keys.reserve( sectids.size() );
+	for ( std::size_t i = 0; i < sectionBoxes.size(); ++i )
+	{
+		const SRect& box = sectionBoxes[ i ];
+		const SPoint center(
+			box.left + ( box.right - box.left ) / 2,
+			box.top + ( box.bottom - box.top ) / 2 );
+		const std::uint32_t hilbertIndex = utils::calcHilbertIndex( bounds, center );
+		keys.emplace_back( hilbertIndex, static_cast< std::uint32_t >( i ) );
+	}
+	std::sort( keys.begin(), keys.end() );
+
+	// the levels above take about 1 / ( Fanout - 1 ) of the leaves, plus
+	// a partial node per level at most
+	const std::size_t leavesCount = keys.size();
+	const std::size_t maxLevelsCount = std::numeric_limits< std::uint32_t >::digits;
+	d_boxes.reserve( leavesCount + leavesCount / ( Fanout - 1 ) + maxLevelsCount );
+	d_sectionIds.reserve( leavesCount );
+	for ( const key_t& key : keys )
+	{
+		d_boxes.push_back( sectionBoxes[ key.second ] );
+		d_sectionIds.push_back( sectids[ key.second ] );
+	}
+
+	d_levelOffsets.push_back( 0 );
+	d_levelOffsets.push_back( d_boxes.size() );
+	while ( 1 < getLevelSize( d_levelOffsets.size() - 2 ) )
+		addLevel();
+}
+
+void KSectionsRTree::addLevel()
+{
+	const std::size_t levelBegin = d_levelOffsets[ d_levelOffsets.size() - 2 ];
+	const std::size_t levelEnd = d_levelOffsets.back();
+	for ( std::size_t nodeBegin = levelBegin
+		; nodeBegin < levelEnd
+		; nodeBegin += Fanout )
+	{
+		const std::size_t nodeEnd = std::min( nodeBegin + Fanout, levelEnd );
+		SRect box = d_boxes[ nodeBegin ];
+		for ( std::size_t i = nodeBegin + 1; i < nodeEnd; ++i )
+			mergeBox( d_boxes[ i ], &box );
+		d_boxes.push_back( box );
+	}
+	d_levelOffsets.push_back( d_boxes.size() );
+}
+
+/*
+	the tree is traversed depth first without a stack, as the nodes are
+	implied by their indexes: once the node is skipped (or its last child
+	is visited), the traversal goes to its next sibling, or back to its
+	parent if there are no more siblings
+*/
+void KSectionsRTree::collectSections(
+	const SRect& viewportRect,
+	section_ids_t* sections ) const
+{
+	const std::size_t rootLevel = d_levelOffsets.size() - 2;
+	std::size_t level = rootLevel;
+	std::size_t index = 0;
+	for ( ;; )
+	{
+		const SRect& box = d_boxes[ d_levelOffsets[ level ] + index ];
+		if ( doBoxesIntersect( box, viewportRect ) )
+		{
+			if ( level != 0 )
+			{
+				--level;
+				index *= Fanout;
+				continue;
+			}
+			sections->push_back( d_sectionIds[ index ] );
+		}
+
+		for ( ;; )
+		{
+			if ( level == rootLevel )
+				return;
+
+			++index;
+			if ( ( ( index % Fanout ) != 0 ) && ( index < getLevelSize( level ) ) )
+				break;
+
+			index = ( index - 1 ) / Fanout;
+			++level;
+		}
+	}
+}
+
+std::size_t KSectionsRTree::getLevelSize( const std::size_t level ) const
+{
+	const std::size_t result = d_levelOffsets[ level + 1 ] - d_levelOffsets[ level ];
+	return result;
+}
+
+} // namespace be
@@ -0,0 +1,60 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_BE_SECTIONS_R_TREE_H
+#define INC_BE_SECTIONS_R_TREE_H
+
+#include "beInternalTypes.h"
+
+namespace be
+{
+
+class KSegmentsManager;
+
+/*
+	packed Hilbert R-tree of the bounding boxes of the sections, it replaces
+	both the range and interval trees (vide RTreeIndexes)
+
+	the sections are sorted by the Hilbert index of the centers of their
+	boxes and packed into the leaves, Fanout per node, then the levels above
+	are packed the same way, bottom up; the nodes are kept in one array
+	level by level, the children of the node i are the nodes
+	i * Fanout .. ( i + 1 ) * Fanout - 1 of the level below, so there are no
+	pointers at all
+*/
+class KSectionsRTree
+{
+	public:
+		explicit KSectionsRTree( const KSegmentsManager& segmentsManager );
+
+	public:
+		// the sections whose boxes intersect the viewport, sorted by id
+		bool selectSections(
+			const SRect& viewportRect,
+			section_ids_t* sections ) const;
+
+		std::size_t getMemorySize() const;
+
+	private:
+		void build( const KSegmentsManager& segmentsManager );
+		void addLevel();
+
+		void collectSections(
+			const SRect& viewportRect,
+			section_ids_t* sections ) const;
+
+		std::size_t getLevelSize( std::size_t level ) const;
+
+	private:
+		static const std::size_t Fanout = 16;
+
+		// boxes of all the levels, starting from the leaves
+		std::vector< SRect > d_boxes;
+		// index of the first box of each level, plus the end of the last one
+		std::vector< std::size_t > d_levelOffsets;
+		// sections of the leaves
+		section_ids_t d_sectionIds;
+
+};
+
+} // namespace be
+
+#endif
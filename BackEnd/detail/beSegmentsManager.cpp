@@ -2,6 +2,7 @@
 #include "ph.h"
 #include "beSegmentsManager.h"
 #include "beUtils.h"
+#include "beTreeUtils.h"
 #include "beConsts.h"
 #include "beConfig.h"
 
@@ -14,31 +15,6 @@ namespace
 const std::size_t IsBeginOrEndOfSectionFlagMask = 0x1;
 
 
-// ----------------------------------------------------------------------------
-
-inline point_pos_id_t composePointPosId(
-	std::size_t segmentIndex,
-	std::size_t pointIndex )
-{
-	assert( segmentIndex <= consts::MaxSegmentId );
-	assert( pointIndex <= consts::MaxPointPosId );
-	const std::size_t rawPointPosId = ( segmentIndex << consts::BitsForPointPosId ) + pointIndex;
-	const point_pos_id_t result( rawPointPosId );
-	return result;
-}
-
-inline void decomposePointPosId(
-	const point_pos_id_t pointId,
-	std::size_t* segmentIndex,
-	std::size_t* pointIndex )
-{
-	const std::size_t rawPointPosId = pointId.get();
-	*segmentIndex = rawPointPosId >> consts::BitsForPointPosId;
-	*pointIndex = rawPointPosId & consts::MaxPointPosId;
-	assert( *segmentIndex <= consts::MaxSegmentId );
-	assert( *pointIndex <= consts::MaxPointPosId );
-}
-
 // ----------------------------------------------------------------------------
 
 inline sect_pos_id_t composeSectPosId(
@@ -75,143 +51,43 @@ inline std::size_t sectPosId2intervalSectionIndex(
 
 // ----------------------------------------------------------------------------
 
-inline section_id_t composeSectionId(
-	std::size_t segmentIndex,
-	std::size_t sectionIndex )
+// the section is identified by its beginning point
+inline section_id_t composeSectionId( std::size_t beginPointIndex )
 {
-	assert( segmentIndex <= consts::MaxSegmentId );
-	assert( sectionIndex <= consts::MaxSectionId );
-	const std::size_t rawSectionId = ( segmentIndex << consts::BitsForSegmentId ) + sectionIndex;
-	//const section_id_t result = reinterpret_cast< section_id_t >( rawSectionId );
-	const section_id_t result = static_cast< section_id_t >( rawSectionId );
+	const section_id_t result( beginPointIndex );
 	return result;
 }
 
-inline void decomposeSectionId(
-	const section_id_t sectionId,
-	std::size_t* segmentIndex,
-	std::size_t* sectionIndex )
+inline std::size_t sectionId2beginPointIndex( const section_id_t sectionId )
 {
-	const std::size_t rawSectionId = sectionId.get();
-	*segmentIndex = rawSectionId >> consts::BitsForSegmentId;
-	*sectionIndex = rawSectionId & consts::MaxSectionId;
-	assert( *segmentIndex <= consts::MaxSegmentId );
-	assert( *sectionIndex <= consts::MaxSectionId );
+	const std::size_t result = sectionId.get();
+	return result;
 }
 
 // ----------------------------------------------------------------------------
 
-struct sort_by_road_class
-{
-	bool operator()( const SRawSegment& lhs, const SRawSegment& rhs ) const
-	{
-		const int lRoadClass = lhs.d_roadClass;
-		const int rRoadClass = rhs.d_roadClass;
-		const bool result = lRoadClass < rRoadClass;
-		return result;
-	}
-};
-
-// ----------------------------------------------------------------------------
-// ----------------------------------------------------------------------------
-
-class KSegmentsCreator
-{
-	public:
-		KSegmentsCreator(
-			const road_classes_t& roadClasses,
-			segments_t* segments );
-
-	public:
-		bool run( raw_segments_t* segments );
-
-	private:
-		void initSegments(
-			const raw_segments_t& rawSegments );
-		void addSegment(
-			const SRawSegment& rawSegment );
-		void addSegmentPoints(
-			const points_t& rawPoints,
-			segment_points_t* segmentPoints );
-
-	private:
-		const road_classes_t& d_roadClasses;
-		std::size_t d_segmentIndex;
-		segments_t* d_segments;
-
-};
-
-// ----------------------------------------------------------------------------
-
-KSegmentsCreator::KSegmentsCreator(
-	const road_classes_t& roadClasses,
-	segments_t* segments )
-	: d_roadClasses( roadClasses )
-	, d_segmentIndex( 0 )
-	, d_segments( segments )
-{
-}
-
-bool KSegmentsCreator::run( raw_segments_t* rawSegments )
-{
-	d_segments->reserve( rawSegments->size() );
-
-	/*
-		sort by road class - at drawing the most important roads will be
-		painted at the end (over less important)
-
-		CAUTION! sort it before initSegments, else indexes will be
-		corrupted !!!
-	*/
-	std::sort( rawSegments->begin(), rawSegments->end(), sort_by_road_class() );
-
-	initSegments( *rawSegments );
-
-	const bool result = !d_segments->empty();
-	return result;
-}
-
-void KSegmentsCreator::initSegments( const raw_segments_t& rawSegments )
+bool hasOrientation(
+	const SSectionPos& beginSectPos,
+	const SSectionPos& endSectPos,
+	const EOrientation orientation )
 {
-	for ( auto it = rawSegments.begin()
-		; it != rawSegments.end()
-		; ++it, ++d_segmentIndex )
+	bool result = false;
+	if ( orientation == Horizontal )
 	{
-		const SRawSegment& rawSegment = *it;
-		addSegment( rawSegment );
+		const coord_t y0 = beginSectPos.getPoint().y;
+		const coord_t y1 = endSectPos.getPoint().y;
+		if ( y0 == y1 )
+			result = true;
 	}
-}
-
-void KSegmentsCreator::addSegment( const SRawSegment& rawSegment )
-{
-	const int roadClassIndex = rawSegment.d_roadClass;
-	assert( ( 0 <= roadClassIndex ) && ( roadClassIndex <= consts::MaxRoadClassIndex ) );
-	d_segments->push_back( SSegment( roadClassIndex ) );
-
-	SSegment& segment = d_segments->back();
-	const points_t& rawPoints = rawSegment.d_points;
-	segment_points_t* segmentPoints = &segment.d_points;
-	addSegmentPoints( rawPoints, segmentPoints );
-}
-
-void KSegmentsCreator::addSegmentPoints(
-	const points_t& rawPoints,
-	segment_points_t* segmentPoints )
-{
-	const std::size_t pointsCount = rawPoints.size();
-	assert( 1 < pointsCount );
-	segmentPoints->reserve( pointsCount );
-
-	std::size_t pointIndex = 0;
-	for ( auto it = rawPoints.begin()
-		; it != rawPoints.end()
-		; ++it, ++pointIndex )
+	else
 	{
-		const point_pos_id_t id = composePointPosId( d_segmentIndex, pointIndex );
-		const SPoint& point = *it;
-		const SPointPos pointPos( id, point );
-		segmentPoints->push_back( pointPos );
+		assert( orientation == Vertical );
+		const coord_t x0 = beginSectPos.getPoint().x;
+		const coord_t x1 = endSectPos.getPoint().x;
+		if ( x0 == x1 )
+			result = true;
 	}
+	return result;
 }
 
 // ----------------------------------------------------------------------------
@@ -220,15 +96,18 @@ void KSegmentsCreator::addSegmentPoints(
 class KIntervalSectionsCreator
 {
 	public:
-		explicit KIntervalSectionsCreator( interval_sections_t* intervalSections );
+		KIntervalSectionsCreator(
+			interval_section_positions_t* intervalSectionPositions,
+			section_ids_t* intervalSectionIds );
 
 	public:
-		void run( const segments_t& segments );
+		void run( const SSegments& segments );
 
 	private:
 		void resetContext();
 		void traverseSegment(
-			const SSegment& segment );
+			const SPointPos* begin,
+			const SPointPos* end );
 		void addIntervalSections();
 		void addHorizontalSection(
 			coord_t raw_x0,
@@ -238,38 +117,43 @@ class KIntervalSectionsCreator
 			coord_t y0,
 			coord_t y1,
 			coord_t x );
-		sect_pos_id_t generateSectPosId(
-			bool isEndOfSection ) const;
+		void addIntervalSection(
+			const SPoint& beginPoint,
+			const SPoint& endPoint );
 
 	private:
-		std::size_t d_segmentIndex;
-		interval_sections_t* d_intervalSections;
+		const SPointPos* d_points;
+		interval_section_positions_t* d_intervalSectionPositions;
+		section_ids_t* d_intervalSectionIds;
 
 		section_id_t d_sectid;
-		const SPoint* d_beginSectionPoint;
-		const SPoint* d_endSectionPoint;
+		SPoint d_beginSectionPoint;
+		SPoint d_endSectionPoint;
 
 };
 
 // ----------------------------------------------------------------------------
 
 KIntervalSectionsCreator::KIntervalSectionsCreator(
-	interval_sections_t* intervalSections )
-	: d_segmentIndex( 0 )
-	, d_intervalSections( intervalSections )
-	, d_beginSectionPoint( nullptr )
-	, d_endSectionPoint( nullptr )
+	interval_section_positions_t* intervalSectionPositions,
+	section_ids_t* intervalSectionIds )
+	: d_points( nullptr )
+	, d_intervalSectionPositions( intervalSectionPositions )
+	, d_intervalSectionIds( intervalSectionIds )
 {
 }
 
-void KIntervalSectionsCreator::run( const segments_t& segments )
+void KIntervalSectionsCreator::run( const SSegments& segments )
 {
-	for ( auto it = segments.begin()
-		; it != segments.end()
-		; ++it, ++d_segmentIndex )
+	d_points = segments.d_points.data();
+	const std::size_t segmentsCount = segments.size();
+	for ( std::size_t segmentIndex = 0
+		; segmentIndex < segmentsCount
+		; ++segmentIndex )
 	{
-		const SSegment& segment = *it;
-		traverseSegment( segment );
+		traverseSegment(
+			segments.getPointsBegin( segmentIndex ),
+			segments.getPointsEnd( segmentIndex ) );
 		resetContext();
 	}
 }
@@ -277,28 +161,28 @@ void KIntervalSectionsCreator::run( const segments_t& segments )
 void KIntervalSectionsCreator::resetContext()
 {
 	d_sectid.reset();
-	d_beginSectionPoint = d_endSectionPoint = nullptr;
 }
 
-void KIntervalSectionsCreator::traverseSegment( const SSegment& segment )
+void KIntervalSectionsCreator::traverseSegment(
+	const SPointPos* begin,
+	const SPointPos* end )
 {
-	const segment_points_t& points = segment.d_points;
-	assert( !points.empty() );
-	for ( auto it = points.begin()
-		; it != points.end()
+	assert( begin != end );
+	for ( const SPointPos* it = begin
+		; it != end
 		; ++it )
 	{
 		const SPointPos& segmentPos = *it;
-		if ( d_beginSectionPoint == nullptr )
+		if ( it == begin )
 		{
-			d_beginSectionPoint = &segmentPos.d_point;
+			d_beginSectionPoint = segmentPos.getPoint();
 		}
 		else
 		{
-			const std::size_t sectionIndex = std::distance( points.begin(), it ) - 1;
-			d_sectid = composeSectionId( d_segmentIndex, sectionIndex );
+			const std::size_t beginPointIndex = std::distance( d_points, it ) - 1;
+			d_sectid = composeSectionId( beginPointIndex );
 
-			d_endSectionPoint = &segmentPos.d_point;
+			d_endSectionPoint = segmentPos.getPoint();
 			addIntervalSections();
 			d_beginSectionPoint = d_endSectionPoint;
 		}
@@ -307,10 +191,10 @@ void KIntervalSectionsCreator::traverseSegment( const SSegment& segment )
 
 void KIntervalSectionsCreator::addIntervalSections()
 {
-	const coord_t x0 = d_beginSectionPoint->x;
-	const coord_t y0 = d_beginSectionPoint->y;
-	const coord_t x1 = d_endSectionPoint->x;
-	const coord_t y1 = d_endSectionPoint->y;
+	const coord_t x0 = d_beginSectionPoint.x;
+	const coord_t y0 = d_beginSectionPoint.y;
+	const coord_t x1 = d_endSectionPoint.x;
+	const coord_t y1 = d_endSectionPoint.y;
 
 	if ( x0 != x1 )
 	{
@@ -349,17 +233,9 @@ void KIntervalSectionsCreator::addHorizontalSection(
 
 	assert( x0 < x1 );
 
-	const sect_pos_id_t beginSectPosId = generateSectPosId( false );
 	const SPoint beginPoint( x0, y );
-	const SSectionPos beginSectionPos( beginSectPosId, beginPoint );
-
-	const sect_pos_id_t endSectPosId = generateSectPosId( true );
 	const SPoint endPoint( x1, y );
-	const SSectionPos endSectionPos( endSectPosId, endPoint );
-
-	const SIntervalSection intervalSection(
-		d_sectid, beginSectionPos, endSectionPos );
-	d_intervalSections->push_back( intervalSection );
+	addIntervalSection( beginPoint, endPoint );
 }
 
 void KIntervalSectionsCreator::addVerticalSection(
@@ -376,25 +252,20 @@ void KIntervalSectionsCreator::addVerticalSection(
 
 	assert( y0 < y1 );
 
-	const sect_pos_id_t beginSectPosId = generateSectPosId( false );
 	const SPoint beginPoint( x, y0 );
-	const SSectionPos beginSectionPos( beginSectPosId, beginPoint );
-
-	const sect_pos_id_t endSectPosId = generateSectPosId( true );
 	const SPoint endPoint( x, y1 );
-	const SSectionPos endSectionPos( endSectPosId, endPoint );
-
-	const SIntervalSection intervalSection(
-		d_sectid, beginSectionPos, endSectionPos );
-	d_intervalSections->push_back( intervalSection );
+	addIntervalSection( beginPoint, endPoint );
 }
 
-sect_pos_id_t KIntervalSectionsCreator::generateSectPosId(
-	const bool isEndOfSection ) const
+// the ids of both positions are implied by their indexes (vide composeSectPosId)
+void KIntervalSectionsCreator::addIntervalSection(
+	const SPoint& beginPoint,
+	const SPoint& endPoint )
 {
-	const std::size_t intervalSectionIndex = d_intervalSections->size();
-	const sect_pos_id_t result = composeSectPosId( intervalSectionIndex, isEndOfSection );
-	return result;
+	assert( d_intervalSectionIds->size() <= consts::MaxIntervalSectionId );
+	d_intervalSectionPositions->push_back( SSectionPos( beginPoint ) );
+	d_intervalSectionPositions->push_back( SSectionPos( endPoint ) );
+	d_intervalSectionIds->push_back( d_sectid );
 }
 
 // ----------------------------------------------------------------------------
@@ -406,8 +277,11 @@ class KSectionCollector
 		KSectionCollector(
 			const KSegmentsManager& segmentsManager,
 			const SRect& viewportRect,
-			const segments_t& segments,
-			const interval_sections_t& intervalSections,
+			const SSegments& segments,
+			const bools_t& sectionBeginFlags,
+			const point_offsets_t& vertexPointLinks,
+			const interval_section_positions_t& intervalSectionPositions,
+			const section_ids_t& intervalSectionIds,
 			section_ids_t* sections );
 
 	public:
@@ -415,25 +289,26 @@ class KSectionCollector
 
 	protected:
 		void preparePoint( point_pos_id_t pointid );
+		void prepareVertexPoint( std::size_t pointIndex );
 
-		void storeSection(
-			std::size_t segmentIndex,
-			std::size_t sectionIndex );
-		void storeSection(
-			const SIntervalSection& intervalSection );
+		void storeIntervalSection(
+			std::size_t intervalSectionIndex );
 		void storeSection(
 			section_id_t sectid );
 
 		bool doesSectionCrossViewport(
-			const SIntervalSection& intervalSection ) const;
+			std::size_t intervalSectionIndex ) const;
 
 		bool uniqueSections();
 
 	protected:
 		const KSegmentsManager& d_segmentsManager;
 		const SRect& d_viewportRect;
-		const segments_t& d_segments;
-		const interval_sections_t& d_intervalSections;
+		const SSegments& d_segments;
+		const bools_t& d_sectionBeginFlags;
+		const point_offsets_t& d_vertexPointLinks;
+		const interval_section_positions_t& d_intervalSectionPositions;
+		const section_ids_t& d_intervalSectionIds;
 		section_ids_t* d_sections;
 
 };
@@ -443,55 +318,59 @@ class KSectionCollector
 KSectionCollector::KSectionCollector(
 	const KSegmentsManager& segmentsManager,
 	const SRect& viewportRect,
-	const segments_t& segments,
-	const interval_sections_t& intervalSections,
+	const SSegments& segments,
+	const bools_t& sectionBeginFlags,
+	const point_offsets_t& vertexPointLinks,
+	const interval_section_positions_t& intervalSectionPositions,
+	const section_ids_t& intervalSectionIds,
 	section_ids_t* sections )
 	: d_segmentsManager( segmentsManager )
 	, d_viewportRect( viewportRect )
 	, d_segments( segments )
-	, d_intervalSections( intervalSections )
+	, d_sectionBeginFlags( sectionBeginFlags )
+	, d_vertexPointLinks( vertexPointLinks )
+	, d_intervalSectionPositions( intervalSectionPositions )
+	, d_intervalSectionIds( intervalSectionIds )
 	, d_sections( sections )
 {
 }
 
+// the vertex expands to all the points with its coords (vide
+// KSegmentsManager::initVertices)
 void KSectionCollector::preparePoint( point_pos_id_t pointid )
 {
-	std::size_t segmentIndex;
-	std::size_t pointIndex;
-	decomposePointPosId( pointid, &segmentIndex, &pointIndex );
-	const SSegment& segment = d_segments[ segmentIndex ];
-	const segment_points_t& points = segment.d_points;
-	const std::size_t pointsCount = points.size();
-	assert( 1 < pointsCount );
-	assert( pointIndex < pointsCount );
-	assert( d_viewportRect.contains( points[ pointIndex ].d_point ) );
+	const std::size_t vertexIndex = pointid.get();
+	std::size_t pointIndex = vertexIndex;
+	do
+	{
+		prepareVertexPoint( pointIndex );
+		pointIndex = d_vertexPointLinks[ pointIndex ];
+	}
+	while ( pointIndex != vertexIndex );
+}
 
-	const std::size_t lastPointIndex = pointsCount - 1;
+void KSectionCollector::prepareVertexPoint( const std::size_t pointIndex )
+{
+	assert( d_viewportRect.contains( d_segments.d_points[ pointIndex ].getPoint() ) );
 
-	if ( pointIndex < lastPointIndex )
+	// the point begins the next section of its segment and ends the
+	// previous one, unless it is the last or the first point of the segment
+	if ( d_sectionBeginFlags[ pointIndex ] )
 	{
-		const std::size_t sectionIndex = pointIndex;
-		storeSection( segmentIndex, sectionIndex );
+		const section_id_t sectid = composeSectionId( pointIndex );
+		storeSection( sectid );
 	}
 
-	if ( 0 < pointIndex )
+	if ( ( 0 < pointIndex ) && d_sectionBeginFlags[ pointIndex - 1 ] )
 	{
-		const std::size_t sectionIndex = pointIndex - 1;
-		storeSection( segmentIndex, sectionIndex );
+		const section_id_t sectid = composeSectionId( pointIndex - 1 );
+		storeSection( sectid );
 	}
 }
 
-void KSectionCollector::storeSection(
-	std::size_t segmentIndex,
-	std::size_t sectionIndex )
-{
-	const section_id_t sectid = composeSectionId( segmentIndex, sectionIndex );
-	storeSection( sectid );
-}
-
-void KSectionCollector::storeSection( const SIntervalSection& intervalSection )
+void KSectionCollector::storeIntervalSection( const std::size_t intervalSectionIndex )
 {
-	const section_id_t sectid = intervalSection.d_sectid;
+	const section_id_t sectid = d_intervalSectionIds[ intervalSectionIndex ];
 	storeSection( sectid );
 }
 
@@ -501,11 +380,15 @@ void KSectionCollector::storeSection( section_id_t sectid )
 }
 
 bool KSectionCollector::doesSectionCrossViewport(
-	const SIntervalSection& intervalSection ) const
+	const std::size_t intervalSectionIndex ) const
 {
 	bool result = false;
-	const SPoint& beginPos = intervalSection.d_begin.d_point;
-	const SPoint& endPos = intervalSection.d_end.d_point;
+	const sect_pos_id_t beginSectPosId = composeSectPosId( intervalSectionIndex, false );
+	const SSectionPos& beginSectPos = d_intervalSectionPositions[ beginSectPosId.get() ];
+	const sect_pos_id_t endSectPosId = composeSectPosId( intervalSectionIndex, true );
+	const SSectionPos& endSectPos = d_intervalSectionPositions[ endSectPosId.get() ];
+	const SPoint& beginPos = beginSectPos.getPoint();
+	const SPoint& endPos = endSectPos.getPoint();
 	if ( d_viewportRect.contains( beginPos ) || d_viewportRect.contains( endPos ) )
 	{
 		result = true;
@@ -522,7 +405,7 @@ bool KSectionCollector::doesSectionCrossViewport(
 		const coord_t x1 = endPos.x;
 		const coord_t y1 = endPos.y;
 
-		if ( intervalSection.hasOrientation( Horizontal ) )
+		if ( hasOrientation( beginSectPos, endSectPos, Horizontal ) )
 		{
 			assert( y0 == y1 );
 			if ( ( x0 <= left ) && ( left <= x1 )
@@ -533,7 +416,7 @@ bool KSectionCollector::doesSectionCrossViewport(
 		}
 		else
 		{
-			assert( intervalSection.hasOrientation( Vertical ) );
+			assert( hasOrientation( beginSectPos, endSectPos, Vertical ) );
 			assert( x0 == x1 );
 			if ( ( y0 <= top ) && ( top <= y1 )
 				&& ( left <= x0 ) && ( x0 <= right ) )
@@ -550,9 +433,8 @@ bool KSectionCollector::doesSectionCrossViewport(
 
 			if ( ( x < left ) && ( y < top ) )
 			{
-				const sect_pos_id_t sectposid = intervalSection.d_begin.d_id;
 				const SPoint& sectionRectRightBottomCorner
-					= d_segmentsManager.getSectionCrossPoint( sectposid );
+					= d_segmentsManager.getSectionCrossPoint( beginSectPosId );
 				if ( ( right < sectionRectRightBottomCorner.x ) && ( bottom < sectionRectRightBottomCorner.y ) )
 					result = true;
 			}
@@ -580,8 +462,11 @@ class KPrepareSections : public KSectionCollector
 		KPrepareSections(
 			const KSegmentsManager& segmentsManager,
 			const SRect& viewportRect,
-			const segments_t& segments,
-			const interval_sections_t& intervalSections,
+			const SSegments& segments,
+			const bools_t& sectionBeginFlags,
+			const point_offsets_t& vertexPointLinks,
+			const interval_section_positions_t& intervalSectionPositions,
+			const section_ids_t& intervalSectionIds,
 			section_ids_t* sections );
 
 	public:
@@ -602,10 +487,21 @@ class KPrepareSections : public KSectionCollector
 KPrepareSections::KPrepareSections(
 	const KSegmentsManager& segmentsManager,
 	const SRect& viewportRect,
-	const segments_t& segments,
-	const interval_sections_t& intervalSections,
+	const SSegments& segments,
+	const bools_t& sectionBeginFlags,
+	const point_offsets_t& vertexPointLinks,
+	const interval_section_positions_t& intervalSectionPositions,
+	const section_ids_t& intervalSectionIds,
 	section_ids_t* sections )
-	: KSectionCollector( segmentsManager, viewportRect, segments, intervalSections, sections )
+	: KSectionCollector(
+		segmentsManager,
+		viewportRect,
+		segments,
+		sectionBeginFlags,
+		vertexPointLinks,
+		intervalSectionPositions,
+		intervalSectionIds,
+		sections )
 {
 }
 
@@ -639,9 +535,8 @@ void KPrepareSections::prepareSectPos( sect_pos_id_t sectposid )
 {
 	const std::size_t intervalSectionIndex
 		= sectPosId2intervalSectionIndex( sectposid );
-	const SIntervalSection& intervalSection = d_intervalSections[ intervalSectionIndex ];
-	assert( doesSectionCrossViewport( intervalSection ) );
-	storeSection( intervalSection );
+	assert( doesSectionCrossViewport( intervalSectionIndex ) );
+	storeIntervalSection( intervalSectionIndex );
 }
 
 // ----------------------------------------------------------------------------
@@ -654,8 +549,11 @@ class KBruteForceSelectSections : public KSectionCollector
 		KBruteForceSelectSections(
 			const KSegmentsManager& segmentsManager,
 			const SRect& viewportRect,
-			const segments_t& segments,
-			const interval_sections_t& intervalSections,
+			const SSegments& segments,
+			const bools_t& sectionBeginFlags,
+			const point_offsets_t& vertexPointLinks,
+			const interval_section_positions_t& intervalSectionPositions,
+			const section_ids_t& intervalSectionIds,
 			section_ids_t* sections );
 
 	public:
@@ -663,7 +561,6 @@ class KBruteForceSelectSections : public KSectionCollector
 
 	private:
 		void gatherPointIds();
-		void traverseSegment( const SSegment& segment );
 		void preparePointPos( const SPointPos& pointPos );
 
 		void gatherIntervalSectionIds();
@@ -675,10 +572,21 @@ class KBruteForceSelectSections : public KSectionCollector
 KBruteForceSelectSections::KBruteForceSelectSections(
 	const KSegmentsManager& segmentsManager,
 	const SRect& viewportRect,
-	const segments_t& segments,
-	const interval_sections_t& intervalSections,
+	const SSegments& segments,
+	const bools_t& sectionBeginFlags,
+	const point_offsets_t& vertexPointLinks,
+	const interval_section_positions_t& intervalSectionPositions,
+	const section_ids_t& intervalSectionIds,
 	section_ids_t* sections )
-	: KSectionCollector( segmentsManager, viewportRect, segments, intervalSections, sections )
+	: KSectionCollector(
+		segmentsManager,
+		viewportRect,
+		segments,
+		sectionBeginFlags,
+		vertexPointLinks,
+		intervalSectionPositions,
+		intervalSectionIds,
+		sections )
 {
 }
 
@@ -693,16 +601,7 @@ void KBruteForceSelectSections::run()
 
 void KBruteForceSelectSections::gatherPointIds()
 {
-	for ( const SSegment& segment : d_segments )
-	{
-		traverseSegment( segment );
-	}
-}
-
-void KBruteForceSelectSections::traverseSegment( const SSegment& segment )
-{
-	const segment_points_t& points = segment.d_points;
-	for ( const SPointPos& pointPos : points )
+	for ( const SPointPos& pointPos : d_segments.d_points )
 	{
 		preparePointPos( pointPos );
 	}
@@ -710,20 +609,22 @@ void KBruteForceSelectSections::traverseSegment( const SSegment& segment )
 
 void KBruteForceSelectSections::preparePointPos( const SPointPos& pointPos )
 {
-	const SPoint& point = pointPos.d_point;
+	const SPoint& point = pointPos.getPoint();
 	if ( d_viewportRect.contains( point ) )
 	{
-		const point_pos_id_t pointid = pointPos.d_id;
-		preparePoint( pointid );
+		const point_pos_id_t pointid = d_segmentsManager.getPointPosId( &pointPos );
+		prepareVertexPoint( pointid.get() );
 	}
 }
 
 void KBruteForceSelectSections::gatherIntervalSectionIds()
 {
-	for ( const SIntervalSection& intervalSection : d_intervalSections )
+	for ( std::size_t intervalSectionIndex = 0
+		; intervalSectionIndex < d_intervalSectionIds.size()
+		; ++intervalSectionIndex )
 	{
-		if ( doesSectionCrossViewport( intervalSection ) )
-			storeSection( intervalSection );
+		if ( doesSectionCrossViewport( intervalSectionIndex ) )
+			storeIntervalSection( intervalSectionIndex );
 	}
 }
 #endif // BRUTE_FORCE_SELECT_SECTIONS_CHECKER
@@ -740,47 +641,60 @@ KSegmentsManager::~KSegmentsManager()
 
 // ----------------------------------------------------------------------------
 
-std::size_t KSegmentsManager::maxSegmentCount()
+std::size_t KSegmentsManager::maxPointsCount()
 {
-	return consts::MaxSegmentId;
-}
-
-std::size_t KSegmentsManager::maxSegmentPointsCount()
-{
-	return consts::MaxPointPosId;
+	return consts::MaxPointsCount;
 }
 
 // ----------------------------------------------------------------------------
 
+// only the vertices are indexed, i.e. one point of each unique coords
 bool KSegmentsManager::getPointPositions( point_positions_t* point_positions ) const
 {
-	for ( const SSegment& segment : d_segments )
+	point_positions->reserve( d_verticesCount );
+	const std::size_t pointsCount = d_segments.getPointsCount();
+	for ( std::size_t pointIndex = 0
+		; pointIndex < pointsCount
+		; ++pointIndex )
 	{
-		const segment_points_t& points = segment.d_points;
-		for ( const SPointPos& pointPos : points )
-		{
-			point_positions->push_back( &pointPos );
-		}
+		if ( isVertex( pointIndex ) )
+			point_positions->push_back( &d_segments.d_points[ pointIndex ] );
 	}
+	assert( point_positions->size() == d_verticesCount );
 
 	const bool result = !point_positions->empty();
 	return result;
 }
 
+point_pos_id_t KSegmentsManager::getPointPosId( const SPointPos* pointPos ) const
+{
+	assert( ( d_segments.d_points.data() <= pointPos )
+		&& ( pointPos < d_segments.d_points.data() + d_segments.d_points.size() ) );
+	const std::size_t rawPointPosId = pointPos - d_segments.d_points.data();
+	const point_pos_id_t result( rawPointPosId );
+	return result;
+}
+
+const SPointPos* KSegmentsManager::getPointPosArray() const
+{
+	return d_segments.d_points.data();
+}
+
 // ----------------------------------------------------------------------------
 
 bool KSegmentsManager::getSectPositions(
 	const EOrientation orientation,
 	section_positions_t* sect_positions ) const
 {
-	for ( const SIntervalSection& section : d_intervalSections )
+	for ( auto it = d_intervalSectionPositions.begin()
+		; it != d_intervalSectionPositions.end()
+		; it += 2 )
 	{
-		if ( section.hasOrientation( orientation ) )
+		const SSectionPos& beginSectPos = it[ 0 ];
+		const SSectionPos& endSectPos = it[ 1 ];
+		if ( hasOrientation( beginSectPos, endSectPos, orientation ) )
 		{
-			const SSectionPos& beginSectPos = section.d_begin;
 			sect_positions->push_back( &beginSectPos );
-
-			const SSectionPos& endSectPos = section.d_end;
 			sect_positions->push_back( &endSectPos );
 		}
 	}
@@ -789,19 +703,31 @@ bool KSegmentsManager::getSectPositions(
 	return result;
 }
 
+sect_pos_id_t KSegmentsManager::getSectPosId( const SSectionPos* sectpos ) const
+{
+	assert( ( d_intervalSectionPositions.data() <= sectpos )
+		&& ( sectpos < d_intervalSectionPositions.data() + d_intervalSectionPositions.size() ) );
+	const std::size_t rawSectPosId = sectpos - d_intervalSectionPositions.data();
+	const sect_pos_id_t result( rawSectPosId );
+	return result;
+}
+
 const SSectionPos* KSegmentsManager::getSectionPos( sect_pos_id_t sectposid ) const
 {
-	std::size_t intervalSectionIndex;
-	bool isEndOfsection;
-	decomposeSectPosId( sectposid, &intervalSectionIndex, &isEndOfsection );
-	const SIntervalSection& intervalSection = d_intervalSections[ intervalSectionIndex ];
-	const SSectionPos* result = isEndOfsection ? &intervalSection.d_end : &intervalSection.d_begin;
+	const std::size_t rawSectPosId = sectposid.get();
+	assert( rawSectPosId < d_intervalSectionPositions.size() );
+	const SSectionPos* result = &d_intervalSectionPositions[ rawSectPosId ];
 	return result;
 }
 
+const SSectionPos* KSegmentsManager::getSectionPosArray() const
+{
+	return d_intervalSectionPositions.data();
+}
+
 const SSectionPos* KSegmentsManager::getSectionBeginPos( const SSectionPos* sectpos ) const
 {
-	const sect_pos_id_t sectPosId = sectpos->d_id;
+	const sect_pos_id_t sectPosId = getSectPosId( sectpos );
 	std::size_t rawSectPosId = sectPosId.get();
 	rawSectPosId &= ~IsBeginOrEndOfSectionFlagMask;
 	const sect_pos_id_t beginSectPosId( rawSectPosId );
@@ -812,7 +738,7 @@ const SSectionPos* KSegmentsManager::getSectionBeginPos( const SSectionPos* sect
 
 const SSectionPos* KSegmentsManager::getSectionEndPos( const SSectionPos* sectpos ) const
 {
-	const sect_pos_id_t sectPosId = sectpos->d_id;
+	const sect_pos_id_t sectPosId = getSectPosId( sectpos );
 	std::size_t rawSectPosId = sectPosId.get();
 	rawSectPosId |= IsBeginOrEndOfSectionFlagMask;
 	const sect_pos_id_t endSectPosId( rawSectPosId );
@@ -823,17 +749,13 @@ const SSectionPos* KSegmentsManager::getSectionEndPos( const SSectionPos* sectpo
 
 SPoint KSegmentsManager::getSectionCrossPoint( sect_pos_id_t sectposid ) const
 {
-	std::size_t intervalSectionIndex;
-	bool isEndOfsection;
-	decomposeSectPosId( sectposid, &intervalSectionIndex, &isEndOfsection );
-	const SIntervalSection& intervalSection = d_intervalSections[ intervalSectionIndex ];
-
-	const section_id_t sectid = intervalSection.d_sectid;
+	const std::size_t intervalSectionIndex = sectPosId2intervalSectionIndex( sectposid );
+	const section_id_t sectid = d_intervalSectionIds[ intervalSectionIndex ];
 	SSection section;
 	getSection( sectid, &section );
 
-	const SPoint& begin = *section.d_begin;
-	const SPoint& end = *section.d_end;
+	const SPoint& begin = section.d_begin;
+	const SPoint& end = section.d_end;
 
 	const coord_t x = std::max( begin.x, end.x );
 	const coord_t y = std::max( begin.y, end.y );
@@ -843,14 +765,14 @@ SPoint KSegmentsManager::getSectionCrossPoint( sect_pos_id_t sectposid ) const
 
 bool KSegmentsManager::isSection(
 	const SSectionPos* beginSectPos,
-	const SSectionPos* endSectPos )
+	const SSectionPos* endSectPos ) const
 {
-	const sect_pos_id_t firstSectPosId = beginSectPos->d_id;
+	const sect_pos_id_t firstSectPosId = getSectPosId( beginSectPos );
 	std::size_t firstIntervalSectionIndex;
 	bool firstIsEndOfsection;
 	decomposeSectPosId( firstSectPosId, &firstIntervalSectionIndex, &firstIsEndOfsection );
 
-	const sect_pos_id_t secondSectPosId = endSectPos->d_id;
+	const sect_pos_id_t secondSectPosId = getSectPosId( endSectPos );
 	std::size_t secondIntervalSectionIndex;
 	bool secondIsEndOfsection;
 	decomposeSectPosId( secondSectPosId, &secondIntervalSectionIndex, &secondIsEndOfsection );
@@ -862,40 +784,215 @@ bool KSegmentsManager::isSection(
 
 // ----------------------------------------------------------------------------
 
-void KSegmentsManager::init( raw_segments_t* rawSegments )
+bool KSegmentsManager::getSectionIds( section_ids_t* sectids ) const
+{
+	const std::size_t pointsCount = d_segments.getPointsCount();
+	sectids->reserve( pointsCount - d_segments.size() );
+	for ( std::size_t pointIndex = 0
+		; pointIndex < pointsCount
+		; ++pointIndex )
+	{
+		if ( d_sectionBeginFlags[ pointIndex ] )
+			sectids->push_back( composeSectionId( pointIndex ) );
+	}
+	const bool result = !sectids->empty();
+	return result;
+}
+
+SRect KSegmentsManager::getSectionRect( const section_id_t sectid ) const
+{
+	SSection section;
+	getSection( sectid, &section );
+
+	const SPoint& begin = section.d_begin;
+	const SPoint& end = section.d_end;
+	const SRect result(
+		std::min( begin.x, end.x ),
+		std::min( begin.y, end.y ),
+		std::max( begin.x, end.x ),
+		std::max( begin.y, end.y ) );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+const SPointPos* KSegmentsManager::findPointPos( const point_pos_id_t pointid ) const
+{
+	const SPointPos* result = nullptr;
+	const std::size_t rawPointPosId = pointid.get();
+	if ( rawPointPosId < d_segments.getPointsCount() )
+		result = &d_segments.d_points[ rawPointPosId ];
+	return result;
+}
+
+const SSectionPos* KSegmentsManager::findSectionPos( const sect_pos_id_t sectposid ) const
+{
+	const SSectionPos* result = nullptr;
+	if ( sectposid.get() < d_intervalSectionPositions.size() )
+		result = getSectionPos( sectposid );
+	return result;
+}
+
+std::uint32_t KSegmentsManager::calcFingerprint() const
+{
+	// FNV-1a over the whole geometry, in the order the ids are given
+	std::uint32_t result = 2166136261U;
+	auto hash = [ &result ]( const std::size_t value )
+	{
+		result = ( result ^ static_cast< std::uint32_t >( value ) ) * 16777619U;
+	};
+
+	hash( d_segments.size() );
+	hash( d_pointsCount );
+	hash( d_intervalSectionIds.size() );
+	for ( std::size_t segmentIndex = 0
+		; segmentIndex < d_segments.size()
+		; ++segmentIndex )
+	{
+		hash( d_segments.getRoadClassIndex( segmentIndex ) );
+		hash( d_segments.getPointsCount( segmentIndex ) );
+		const SPointPos* end = d_segments.getPointsEnd( segmentIndex );
+		for ( const SPointPos* it = d_segments.getPointsBegin( segmentIndex )
+			; it != end
+			; ++it )
+		{
+			hash( it->getPoint().x );
+			hash( it->getPoint().y );
+		}
+	}
+	return result;
+}
+
+std::size_t KSegmentsManager::getMemorySize() const
+{
+	const std::size_t result = utils::get_memory_size( d_segments.d_points )
+		+ utils::get_memory_size( d_segments.d_offsets )
+		+ utils::get_memory_size( d_segments.d_roadClassIndexes )
+		+ utils::get_memory_size( d_sectionBeginFlags )
+		+ utils::get_memory_size( d_roadClassOffsets )
+		+ utils::get_memory_size( d_vertexPointLinks )
+		+ utils::get_memory_size( d_intervalSectionPositions )
+		+ utils::get_memory_size( d_intervalSectionIds );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+
+void KSegmentsManager::init(
+	SSegments* segments,
+	const std::size_t pointsCount )
+{
+	d_pointsCount = pointsCount;
+	d_segments.swap( *segments );
+
+	// the segments are read straight into their final positions, sorted
+	// by road class (vide readMap)
+	assert( std::is_sorted( d_segments.d_roadClassIndexes.begin(), d_segments.d_roadClassIndexes.end() ) );
+	assert( d_segments.empty() || ( d_segments.d_roadClassIndexes.back() <= consts::MaxRoadClassIndex ) );
+
+	const std::size_t allPointsCount = d_segments.d_points.size();
+	d_sectionBeginFlags.assign( allPointsCount, true );
+	d_roadClassOffsets.assign( consts::MaxRoadClassIndex + 2, allPointsCount );
+	const std::size_t segmentsCount = d_segments.size();
+	for ( std::size_t i = segmentsCount; 0 < i; --i )
+	{
+		const std::size_t segmentIndex = i - 1;
+		const std::size_t lastPointIndex = d_segments.d_offsets[ segmentIndex + 1 ] - 1;
+		d_sectionBeginFlags[ lastPointIndex ] = false;
+
+		const int roadClassIndex = d_segments.getRoadClassIndex( segmentIndex );
+		d_roadClassOffsets[ roadClassIndex ] = d_segments.d_offsets[ segmentIndex ];
+	}
+
+	// road classes without segments begin where the next one does
+	for ( std::size_t i = consts::MaxRoadClassIndex + 1; 0 < i; --i )
+	{
+		const std::size_t roadClassIndex = i - 1;
+		d_roadClassOffsets[ roadClassIndex ] = std::min(
+			d_roadClassOffsets[ roadClassIndex ],
+			d_roadClassOffsets[ roadClassIndex + 1 ] );
+	}
+
+	initVertices();
+
+	KIntervalSectionsCreator intervalSectionsCreator(
+		&d_intervalSectionPositions,
+		&d_intervalSectionIds );
+	intervalSectionsCreator.run( d_segments );
+}
+
+/*
+	segments meeting at a junction have their own copies of its coords,
+	the points with the same coords are linked into a circular list
+	in ascending order, the last of them represents the vertex
+*/
+void KSegmentsManager::initVertices()
 {
-	KSegmentsCreator segmentsCreator( d_roadClasses, &d_segments );
-	if ( segmentsCreator.run( rawSegments ) )
+	const SPointPos* points = d_segments.d_points.data();
+	const std::size_t pointsCount = d_segments.getPointsCount();
+	point_offsets_t pointIndexes;
+	pointIndexes.reserve( pointsCount );
+	for ( std::size_t pointIndex = 0
+		; pointIndex < pointsCount
+		; ++pointIndex )
+	{
+		pointIndexes.push_back( static_cast< std::uint32_t >( pointIndex ) );
+	}
+	std::sort( pointIndexes.begin(), pointIndexes.end(),
+		[ points ]( const std::uint32_t lhs, const std::uint32_t rhs )
+		{
+			const SPoint& lpt = points[ lhs ].getPoint();
+			const SPoint& rpt = points[ rhs ].getPoint();
+			return utils::cmp_less_by_x( lpt, rpt, lhs < rhs );
+		} );
+
+	d_vertexPointLinks.resize( pointsCount );
+	d_verticesCount = 0;
+	auto vertexBegin = pointIndexes.begin();
+	while ( vertexBegin != pointIndexes.end() )
 	{
-		KIntervalSectionsCreator intervalSectionsCreator( &d_intervalSections );
-		intervalSectionsCreator.run( d_segments );
+		const SPoint& vertex = points[ *vertexBegin ].getPoint();
+		auto vertexEnd = std::find_if( vertexBegin + 1, pointIndexes.end(),
+			[ points, &vertex ]( const std::uint32_t pointIndex )
+			{
+				return points[ pointIndex ].getPoint() != vertex;
+			} );
+
+		for ( auto it = vertexBegin + 1; it != vertexEnd; ++it )
+			d_vertexPointLinks[ *( it - 1 ) ] = *it;
+		d_vertexPointLinks[ *( vertexEnd - 1 ) ] = *vertexBegin;
+
+		++d_verticesCount;
+		vertexBegin = vertexEnd;
 	}
 }
 
+bool KSegmentsManager::isVertex( const std::size_t pointIndex ) const
+{
+	const bool result = d_vertexPointLinks[ pointIndex ] <= pointIndex;
+	return result;
+}
+
 void KSegmentsManager::getSection(
 	const section_id_t sectid,
 	SSection* section ) const
 {
-	std::size_t segmentIndex;
-	std::size_t sectionIndex;
-	decomposeSectionId( sectid, &segmentIndex, &sectionIndex );
-
-	const SSegment& segment = d_segments[ segmentIndex ];
-	const int roadClassIndex = segment.d_roadClassIndex;
+	const std::size_t sectionBeginPointIndex = sectionId2beginPointIndex( sectid );
+	const std::size_t sectionEndPointIndex = sectionBeginPointIndex + 1;
+	assert( d_sectionBeginFlags[ sectionBeginPointIndex ] );
+
+	// there are only a few road classes, so the linear scan is fine
+	int roadClassIndex = 0;
+	while ( d_roadClassOffsets[ roadClassIndex + 1 ] <= sectionBeginPointIndex )
+		++roadClassIndex;
 	section->d_roadClassIndex = roadClassIndex;
 
-	const segment_points_t& points = segment.d_points;
-	const std::size_t sectionBeginPointIndex = sectionIndex;
-	const std::size_t sectionEndPointIndex = sectionIndex + 1;
-	assert( sectionEndPointIndex < points.size() );
-
+	const SPointPos* points = d_segments.d_points.data();
 	const SPointPos& sectionBeginPointPos = points[ sectionBeginPointIndex ];
-	const SPoint& sectionBeginPoint = sectionBeginPointPos.d_point;
-	section->d_begin = &sectionBeginPoint;
+	section->d_begin = sectionBeginPointPos.getPoint();
 
 	const SPointPos& sectionEndPointPos = points[ sectionEndPointIndex ];
-	const SPoint& sectionEndPoint = sectionEndPointPos.d_point;
-	section->d_end = &sectionEndPoint;
+	section->d_end = sectionEndPointPos.getPoint();
 }
 
 bool KSegmentsManager::prepareSections(
@@ -904,7 +1001,15 @@ bool KSegmentsManager::prepareSections(
 	const sect_pos_ids_t& sectposids,
 	section_ids_t* sections ) const
 {
-	KPrepareSections prepareSection( *this, viewportRect, d_segments, d_intervalSections, sections );
+	KPrepareSections prepareSection(
+		*this,
+		viewportRect,
+		d_segments,
+		d_sectionBeginFlags,
+		d_vertexPointLinks,
+		d_intervalSectionPositions,
+		d_intervalSectionIds,
+		sections );
 	const bool result = prepareSection.run( pointids, sectposids );
 	return result;
 }
@@ -917,7 +1022,14 @@ bool KSegmentsManager::compareBruteForceSelectSections(
 	#ifdef BRUTE_FORCE_SELECT_SECTIONS_CHECKER
 	section_ids_t bfSections;
 	KBruteForceSelectSections bruteForceSelectSections(
-		*this, viewportRect, d_segments, d_intervalSections, &bfSections );
+		*this,
+		viewportRect,
+		d_segments,
+		d_sectionBeginFlags,
+		d_vertexPointLinks,
+		d_intervalSectionPositions,
+		d_intervalSectionIds,
+		&bfSections );
 	bruteForceSelectSections.run();
 
 	section_ids_t diff_sections;
@@ -16,28 +16,53 @@ class KSegmentsManager
 		virtual ~KSegmentsManager();
 
 	public:
-		static std::size_t maxSegmentCount();
-		static std::size_t maxSegmentPointsCount();
+		static std::size_t maxPointsCount();
 
 	public:
+		// positions of the vertices, i.e. the points with unique coords
 		bool getPointPositions( point_positions_t* point_positions ) const;
 
+		// the ids are implied by the positions in the arrays
+		point_pos_id_t getPointPosId( const SPointPos* pointPos ) const;
+		// all the points, indexed by their ids
+		const SPointPos* getPointPosArray() const;
+
 	public:
 		bool getSectPositions(
 			const EOrientation orientation,
 			section_positions_t* sect_positions ) const;
 
+		sect_pos_id_t getSectPosId( const SSectionPos* sectpos ) const;
 		const SSectionPos* getSectionPos( sect_pos_id_t sectposid ) const;
+		// all the section positions, indexed by their ids
+		const SSectionPos* getSectionPosArray() const;
 
 		const SSectionPos* getSectionBeginPos( const SSectionPos* sectpos ) const;
 		const SSectionPos* getSectionEndPos( const SSectionPos* sectpos ) const;
 
 		SPoint getSectionCrossPoint( sect_pos_id_t sectposid ) const;
 
-		static bool isSection( const SSectionPos* beginSectPos, const SSectionPos* endSectPos );
+		bool isSection( const SSectionPos* beginSectPos, const SSectionPos* endSectPos ) const;
+
+	public:
+		// all the sections, in ascending order
+		bool getSectionIds( section_ids_t* sectids ) const;
+		SRect getSectionRect( section_id_t sectid ) const;
+
+	public:
+		// return nullptr for ids out of range, e.g. read from damaged index image
+		const SPointPos* findPointPos( point_pos_id_t pointid ) const;
+		const SSectionPos* findSectionPos( sect_pos_id_t sectposid ) const;
+
+		// identifies the loaded map, index images are valid only for it
+		std::uint32_t calcFingerprint() const;
+
+		// bytes taken by the segments, their sections and the links
+		std::size_t getMemorySize() const;
 
 	protected:
-		void init( raw_segments_t* rawSegments );
+		// takes over the segments read by readMap
+		void init( SSegments* segments, std::size_t pointsCount );
 
 		void getSection(
 			const section_id_t sectid,
@@ -53,10 +78,24 @@ class KSegmentsManager
 			const SRect& viewportRect,
 			const section_ids_t& sections ) const;
 
+	private:
+		void initVertices();
+		bool isVertex( std::size_t pointIndex ) const;
+
 	protected:
+		std::size_t d_pointsCount = 0;
 		road_classes_t d_roadClasses;
-		segments_t d_segments;
-		interval_sections_t d_intervalSections;
+		SSegments d_segments;
+		// whether the point begins a section, i.e. it is not the last one of its segment
+		bools_t d_sectionBeginFlags;
+		// index of the first point of each road class (plus the end of the last one)
+		point_offsets_t d_roadClassOffsets;
+		// next point with the same coords (vide initVertices)
+		point_offsets_t d_vertexPointLinks;
+		std::size_t d_verticesCount = 0;
+		interval_section_positions_t d_intervalSectionPositions;
+		// section of each interval section, vide KIntervalSectionsCreator
+		section_ids_t d_intervalSectionIds;
 
 };
 
@@ -28,8 +28,8 @@ bool less_by_x(
 	const position_t lhs,
 	const position_t rhs )
 {
-	const SPoint& lpt = lhs->d_point;
-	const SPoint& rpt = rhs->d_point;
+	const SPoint& lpt = lhs->getPoint();
+	const SPoint& rpt = rhs->getPoint();
 	const bool resultIfEqual = lhs < rhs;
 	const bool result = cmp_less_by_x( lpt, rpt, resultIfEqual );
 	return result;
@@ -41,7 +41,7 @@ bool less_by_x(
 	const position_t rhs )
 {
 	const SPoint& lpt = edge.d_border;
-	const SPoint& rpt = rhs->d_point;
+	const SPoint& rpt = rhs->getPoint();
 	const bool resultIfEqual = edge.isMin();
 	const bool result = cmp_less_by_x( lpt, rpt, resultIfEqual );
 	return result;
@@ -52,7 +52,7 @@ bool less_by_x(
 	const position_t lhs,
 	const SViewportBorder& edge )
 {
-	const SPoint& lpt = lhs->d_point;
+	const SPoint& lpt = lhs->getPoint();
 	const SPoint& rpt = edge.d_border;
 	const bool resultIfEqual = edge.isMax();
 	const bool result = cmp_less_by_x( lpt, rpt, resultIfEqual );
@@ -66,8 +66,8 @@ bool less_by_y(
 	const position_t lhs,
 	const position_t rhs )
 {
-	const SPoint& lpt = lhs->d_point;
-	const SPoint& rpt = rhs->d_point;
+	const SPoint& lpt = lhs->getPoint();
+	const SPoint& rpt = rhs->getPoint();
 	const bool resultIfEqual = lhs < rhs;
 	const bool result = cmp_less_by_y( lpt, rpt, resultIfEqual );
 	return result;
@@ -79,7 +79,7 @@ bool less_by_y(
 	const position_t rhs )
 {
 	const SPoint& lpt = edge.d_border;
-	const SPoint& rpt = rhs->d_point;
+	const SPoint& rpt = rhs->getPoint();
 	const bool resultIfEqual = edge.isMin();
 	const bool result = cmp_less_by_y( lpt, rpt, resultIfEqual );
 	return result;
@@ -90,7 +90,7 @@ bool less_by_y(
 	const position_t lhs,
 	const SViewportBorder& edge )
 {
-	const SPoint& lpt = lhs->d_point;
+	const SPoint& lpt = lhs->getPoint();
 	const SPoint& rpt = edge.d_border;
 	const bool resultIfEqual = edge.isMax();
 	const bool result = cmp_less_by_y( lpt, rpt, resultIfEqual );
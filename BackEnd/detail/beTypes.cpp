@@ -21,14 +21,6 @@ bool SSize::operator!=( const SSize& rhs ) const
 
 // ----------------------------------------------------------------------------
 
-SPoint::SPoint(
-	coord_t ix,
-	coord_t iy )
-	: x( ix )
-	, y( iy )
-{
-}
-
 bool SPoint::operator==( const SPoint& rhs ) const
 {
 	const bool result = ( x == rhs.x ) && ( y == rhs.y );
@@ -170,4 +162,22 @@ SZoomData::SZoomData(
 {
 }
 
+// ----------------------------------------------------------------------------
+
+SMemoryUsage::SMemoryUsage()
+	: d_segments( 0 )
+	, d_rangeTreeNodes( 0 )
+	, d_rangeTreeLists( 0 )
+	, d_intervalTrees( 0 )
+	, d_sectionsRTree( 0 )
+{
+}
+
+std::size_t SMemoryUsage::getTotal() const
+{
+	const std::size_t result = d_segments + d_rangeTreeNodes + d_rangeTreeLists + d_intervalTrees
+		+ d_sectionsRTree;
+	return result;
+}
+
 } // namespace be
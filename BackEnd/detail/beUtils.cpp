@@ -31,6 +31,51 @@ bool isShiftOverflow( coord_t coord, int shiftCounter )
 	return overflow;
 }
 
+std::uint32_t calcHilbertIndex( const SRect& rect, const SPoint& point )
+{
+	const int Order = 16;
+	const big_coord_t maxCell = ( big_coord_t( 1 ) << Order ) - 1;
+
+	// scale the coords of the rect to the cells of the curve
+	auto getCell = [ maxCell ](
+		const coord_t minCoord,
+		const coord_t maxCoord,
+		const coord_t coord )
+	{
+		const big_coord_t range = static_cast< big_coord_t >( maxCoord ) - minCoord;
+		big_coord_t cell = 0;
+		if ( 0 < range )
+		{
+			const big_coord_t offset = static_cast< big_coord_t >( coord ) - minCoord;
+			cell = std::min( std::max( offset, big_coord_t( 0 ) ), range ) * maxCell / range;
+		}
+		return static_cast< std::uint32_t >( cell );
+	};
+
+	std::uint32_t x = getCell( rect.left, rect.right, point.x );
+	std::uint32_t y = getCell( rect.top, rect.bottom, point.y );
+
+	std::uint32_t result = 0;
+	for ( std::uint32_t half = 1U << ( Order - 1 ); half != 0; half >>= 1 )
+	{
+		const std::uint32_t rx = ( x & half ) ? 1 : 0;
+		const std::uint32_t ry = ( y & half ) ? 1 : 0;
+		result += half * half * ( ( 3 * rx ) ^ ry );
+
+		// rotate the quadrant, so the curve is continuous
+		if ( ry == 0 )
+		{
+			if ( rx == 1 )
+			{
+				x = ( half - 1 ) - ( x & ( half - 1 ) );
+				y = ( half - 1 ) - ( y & ( half - 1 ) );
+			}
+			std::swap( x, y );
+		}
+	}
+	return result;
+}
+
 } // namespace utils
 
 } // namespace be
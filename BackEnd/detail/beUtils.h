@@ -61,6 +61,20 @@ item_id_it get_median(
 	return median_it;
 }
 
+// bytes allocated by the vector
+template< typename TValue >
+std::size_t get_memory_size( const std::vector< TValue >& values )
+{
+	const std::size_t result = values.capacity() * sizeof( TValue );
+	return result;
+}
+
+inline std::size_t get_memory_size( const std::vector< bool >& values )
+{
+	const std::size_t result = values.capacity() / 8;
+	return result;
+}
+
 template< typename TIterator >
 void delete_container( TIterator begin, TIterator end )
 {
@@ -90,6 +104,10 @@ inline bool isValueInRange(
 bool checkSectionLength( const SPoint& begin, const SPoint& end );
 bool isShiftOverflow( coord_t coord, int shiftCounter );
 
+// distance of the point along the Hilbert curve of order 16 laid over
+// the rect, the points close to each other get close distances
+std::uint32_t calcHilbertIndex( const SRect& rect, const SPoint& point );
+
 } // namespace utils
 
 } // namespace be
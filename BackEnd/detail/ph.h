@@ -7,12 +7,18 @@
 #include <limits>
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <string>
 #include <vector>
 #include <set>
 #include <map>
 #include <algorithm>
 #include <functional>
+#include <thread>
+#include <future>
+#include <chrono>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
 
 #endif
@@ -22,6 +22,11 @@ struct IController
 
 		virtual bool generateContents( IBitmap* bitmap ) = 0;
 
+		// true while the map is loaded in the background (vide
+		// SInstance::initAsync), the contents should be regenerated from time
+		// to time until it turns false, each time it shows more road classes
+		virtual bool isLoading() const = 0;
+
 		virtual std::string getParamsDescription() const = 0;
 };
 
@@ -17,6 +17,8 @@ struct IDocument
 		virtual void setState( const std::string& stateString ) = 0;
 
 		virtual color32_t getBkColor() const = 0;
+
+		virtual SMemoryUsage getMemoryUsage() const = 0;
 };
 
 } // namespace be
@@ -2,6 +2,10 @@
 #ifndef INC_BE_INSTANCE_H
 #define INC_BE_INSTANCE_H
 
+#include "beTypes.h"
+#include <string>
+#include <memory>
+
 namespace be
 {
 
@@ -16,6 +20,24 @@ struct SInstance
 
 	bool init( IMapStream* mapStream );
 
+	// the spatial indexes are loaded from the image stored in 'indexFname'
+	// (if it was built for the same map), else they are built and stored,
+	// the image doesn't depend on the indexMode (but it isn't used by
+	// RTreeIndexes)
+	bool init(
+		IMapStream* mapStream,
+		const std::string& indexFname,
+		EIndexMode indexMode = FastIndexes );
+
+	// the same as above, but only the major road classes are read and indexed
+	// before it returns, the rest of the map is read and indexed in the
+	// background (vide IController::isLoading), so the instance takes over
+	// the stream (and the data it views, if any, has to outlive the loading)
+	bool initAsync(
+		std::unique_ptr< IMapStream > mapStream,
+		const std::string& indexFname,
+		EIndexMode indexMode = FastIndexes );
+
 	IDocument* d_document;
 	IController* d_controller;
 };
@@ -13,12 +13,35 @@ struct IMapStream
 		static IMapStream* create( const int* begin, const int* end );
 		static IMapStream* create();
 
+		// map the whole file into memory instead of reading it with fread, the
+		// stream then hands out views straight into the mapping (see viewInts)
+		// returns nullptr if the file cannot be mapped, use create then
+		static IMapStream* createMapped( const std::string& fname );
+		static IMapStream* createMapped( const int fileDescriptor, const long offset );
+
+		// inflate the gzip (or zlib) compressed map on the fly, block by
+		// block, so the whole uncompressed map is never stored anywhere
+		// returns nullptr if the data cannot be read or the backend is built
+		// without zlib (vide ENABLE_COMPRESSED_MAP_STREAM)
+		static IMapStream* createCompressed( const std::string& fname );
+		static IMapStream* createCompressed( const int fileDescriptor, const long offset );
+		static IMapStream* createCompressed( const void* data, std::size_t size );
+
 	public:
 		virtual ~IMapStream() = default;
 
 	public:
 		virtual bool getInt( int* value ) = 0;
 
+		// reads 'count' consecutive ints into 'values' at once, returns false
+		// if there are less than 'count' ints left
+		virtual bool getInts( int* values, std::size_t count ) = 0;
+
+		// returns pointer to 'count' consecutive ints and skips them in the stream,
+		// or nullptr if the stream cannot hand out direct views (or there is not
+		// enough data), in such case getInt is the way to go
+		virtual const int* viewInts( std::size_t count );
+
 };
 
 } // namespace be
@@ -46,6 +46,15 @@ struct SPoint
 	coord_t y;
 };
 
+// inline, so the points decoded on the fly (vide STiledPoint) are cheap
+inline SPoint::SPoint(
+	coord_t ix,
+	coord_t iy )
+	: x( ix )
+	, y( iy )
+{
+}
+
 using points_t = std::vector< SPoint >;
 using points_it = points_t::iterator;
 using points_cit = points_t::const_iterator;
@@ -135,6 +144,41 @@ struct SZoomData
 
 };
 
+// ----------------------------------------------------------------------------
+
+// how the spatial indexes are kept in memory (vide SInstance::init)
+enum EIndexMode
+{
+	// the fastest selection
+	FastIndexes,
+	// the associated structures of the range tree take about a third of the
+	// memory, but the points are selected up to about twice slower, it is
+	// meant for low-end devices which can't hold the indexes of large maps
+	CompactIndexes,
+	// the sections are selected by a packed R-tree of their boxes instead of
+	// the range and interval trees, it takes a fraction of their memory and
+	// it is built from scratch each time (no index image)
+	RTreeIndexes
+};
+
+// bytes taken by the contents of the document (vide IDocument::getMemoryUsage)
+struct SMemoryUsage
+{
+	SMemoryUsage();
+
+	std::size_t getTotal() const;
+
+	// points, sections and their links
+	std::size_t d_segments;
+	std::size_t d_rangeTreeNodes;
+	// sorted by y lists of points of the range tree nodes
+	std::size_t d_rangeTreeLists;
+	// both the horizontal and vertical trees with their heaps
+	std::size_t d_intervalTrees;
+	// vide RTreeIndexes
+	std::size_t d_sectionsRTree;
+};
+
 } // namespace be
 
 #endif
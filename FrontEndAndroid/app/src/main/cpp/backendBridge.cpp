@@ -129,6 +129,20 @@ be::IMapStream* createMapStream(
 	#endif
 }
 
+handle_t createInstance(
+	be::IMapStream* rawMapStream,
+	const std::string& indexFilePath )
+{
+	handle_t result = 0;
+	std::unique_ptr< be::SInstance > beInstance( new be::SInstance() );
+	std::unique_ptr< be::IMapStream > mapStream( rawMapStream );
+	if ( mapStream && beInstance->init( mapStream.get(), indexFilePath ) )
+		result = reinterpret_cast< handle_t >( beInstance.release() );
+
+	LOGI("new instance %p", reinterpret_cast<void*>( result ));
+	return result;
+}
+
 } // anonymous namespace
 
 // ----------------------------------------------------------------------------
@@ -138,7 +152,8 @@ extern "C" JNIEXPORT handle_t JNICALL Java_com_amtest_frontend_AMTest_createBack
 	JNIEnv* env,
 	jobject /*obj*/,
 	jbyteArray jmapBytesArray,
-	jint jmapBytesArraySize )
+	jint jmapBytesArraySize,
+	jstring jindexFilePath )
 {
 	LOGI("createBackendInstance %d", jmapBytesArraySize);
 	handle_t beInstanceHandle = 0;
@@ -147,14 +162,36 @@ extern "C" JNIEXPORT handle_t JNICALL Java_com_amtest_frontend_AMTest_createBack
 		jboolean isCopy = false;
 		jbyte* rawMapStream = env->GetByteArrayElements( jmapBytesArray, &isCopy );
 
-		std::unique_ptr< be::SInstance > beInstance( new be::SInstance() );
-		std::unique_ptr< be::IMapStream > mapStream( createMapStream( rawMapStream, jmapBytesArraySize ) );
-		if ( beInstance->init( mapStream.get() ) )
-			beInstanceHandle = reinterpret_cast< handle_t >( beInstance.release() );
+		const std::string& indexFilePath = j2str( env, jindexFilePath );
+		beInstanceHandle = createInstance( createMapStream( rawMapStream, jmapBytesArraySize ), indexFilePath );
 
 		env->ReleaseByteArrayElements( jmapBytesArray, rawMapStream, JNI_ABORT );
+	}
+	catch ( std::exception& e )
+	{
+		const std::string& reason = e.what();
+		LOGE("%s", reason.c_str());
+	}
+	return beInstanceHandle;
+}
 
-		LOGI("new instance %p", reinterpret_cast<void*>( beInstanceHandle ));
+// the gzip compressed map is inflated on the fly straight from the package,
+// the stream takes over the descriptor
+extern "C" JNIEXPORT handle_t JNICALL Java_com_amtest_frontend_AMTest_createBackendInstanceFromCompressedMap(
+	JNIEnv* env,
+	jobject /*obj*/,
+	jint jmapFileDescriptor,
+	jlong jmapOffset,
+	jstring jindexFilePath )
+{
+	LOGI("createBackendInstanceFromCompressedMap %lld", static_cast<long long>( jmapOffset ));
+	handle_t beInstanceHandle = 0;
+	try
+	{
+		const std::string& indexFilePath = j2str( env, jindexFilePath );
+		beInstanceHandle = createInstance(
+			be::IMapStream::createCompressed( jmapFileDescriptor, static_cast<long>( jmapOffset ) ),
+			indexFilePath );
 	}
 	catch ( std::exception& e )
 	{
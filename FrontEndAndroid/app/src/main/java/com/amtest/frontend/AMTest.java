@@ -87,9 +87,17 @@ public class AMTest extends AppCompatActivity
 
 		try
 		{
-			byte[] mapBytesArray = readMap( MapFileName );
-			if ( mapBytesArray != null )
-				result = createBackendInstance( mapBytesArray, mapBytesArray.length );
+			String indexFilePath = new File( getFilesDir(), IndexFileName ).getPath();
+			if ( hasAsset( CompressedMapFileName ) )
+			{
+				result = createCompressedBackendInstance( CompressedMapFileName, indexFilePath );
+			}
+			else
+			{
+				byte[] mapBytesArray = readMap( MapFileName );
+				if ( mapBytesArray != null )
+					result = createBackendInstance( mapBytesArray, mapBytesArray.length, indexFilePath );
+			}
 		}
 		catch ( IOException e )
 		{
@@ -100,6 +108,30 @@ public class AMTest extends AppCompatActivity
 		return result;
 	}
 
+	private boolean hasAsset( String fileName ) throws IOException
+	{
+		AssetManager assetManager = getResources().getAssets();
+		String[] fileNames = assetManager.list( "" );
+		return ( fileNames != null ) && java.util.Arrays.asList( fileNames ).contains( fileName );
+	}
+
+	// the compressed map is stored in the package as it is (aapt doesn't
+	// compress .gz files), so the backend inflates it straight from there
+	// instead of getting the whole file in an array
+	private long createCompressedBackendInstance( String mapFileName, String indexFilePath ) throws IOException
+	{
+		AssetManager assetManager = getResources().getAssets();
+		try ( AssetFileDescriptor mapFileDescriptor = assetManager.openFd( mapFileName ) )
+		{
+			// the backend takes over (and closes) the duplicated descriptor
+			ParcelFileDescriptor mapDescriptor = ParcelFileDescriptor.dup( mapFileDescriptor.getFileDescriptor() );
+			return createBackendInstanceFromCompressedMap(
+				mapDescriptor.detachFd(),
+				mapFileDescriptor.getStartOffset(),
+				indexFilePath );
+		}
+	}
+
 	private byte[] readMap( String mapFileName ) throws IOException
 	{
 		Resources resources = getResources();
@@ -136,7 +168,8 @@ public class AMTest extends AppCompatActivity
 
 	// ----------------------------------------------------------------------------
 
-	private native long createBackendInstance( byte[] mapBytesArray, int mapBytesArraySize );
+	private native long createBackendInstance( byte[] mapBytesArray, int mapBytesArraySize, String indexFilePath );
+	private native long createBackendInstanceFromCompressedMap( int mapFileDescriptor, long mapOffset, String indexFilePath );
 	private native void destroyBackendInstance( long beInstanceHandle );
 
 	private long d_beInstanceHandle;
@@ -147,6 +180,9 @@ public class AMTest extends AppCompatActivity
 
 	private static final String TAG = "AMtest";
 	private static final String MapFileName = "mapa.dat";
+	// if present, it is taken instead of MapFileName
+	private static final String CompressedMapFileName = "mapa.dat.gz";
+	private static final String IndexFileName = "mapa.idx";
 
 }
 
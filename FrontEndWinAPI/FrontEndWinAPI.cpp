@@ -12,6 +12,7 @@ namespace
 {
 
 const std::string MapFilePath = "./mapa.dat";
+const std::string IndexFilePath = "./mapa.idx";
 
 be::IMapStream* createMapStream()
 {
@@ -19,7 +20,9 @@ be::IMapStream* createMapStream()
 	#ifdef STUB_INPUT
 	be::IMapStream* mapStream = be::IMapStream::create();
 	#else
-	be::IMapStream* mapStream = be::IMapStream::create( MapFilePath );
+	be::IMapStream* mapStream = be::IMapStream::createMapped( MapFilePath );
+	if ( mapStream == nullptr )
+		mapStream = be::IMapStream::create( MapFilePath );
 	#endif
 	return mapStream;
 }
@@ -27,7 +30,7 @@ be::IMapStream* createMapStream()
 void initBackendInstance( be::SInstance* beInstance )
 {
 	std::unique_ptr< be::IMapStream > mapStream( createMapStream() );
-	if ( !beInstance->init( mapStream.get() ) )
+	if ( !beInstance->initAsync( std::move( mapStream ), IndexFilePath ) )
 		throw std::runtime_error( "Cannot initialize backend instance. Check if map file '"
 			+ MapFilePath + "' is available. " );
 }
@@ -15,6 +15,10 @@ namespace
 
 const char* WindowClassName = "FrontEndWinAPIWindowClassName";
 
+// the view is refreshed periodically while the map is loaded in the background
+const UINT_PTR LoadingTimerId = 1;
+const UINT LoadingTimerElapse = 100;
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
@@ -253,6 +257,7 @@ class KView : public IView
 
 		void onSize( WPARAM wParam, LPARAM lParam );
 		void onPaint();
+		void onTimer( WPARAM wParam, LPARAM lParam );
 
 		void onLButtonDown( WPARAM wParam, LPARAM lParam );
 		void onRButtonDown( WPARAM wParam, LPARAM lParam );
@@ -337,6 +342,8 @@ bool KView::init( const int cmdShow )
 	{
 		::ShowWindow( d_hwnd, cmdShow );
 		::UpdateWindow( d_hwnd );
+		if ( d_beController->isLoading() )
+			::SetTimer( d_hwnd, LoadingTimerId, LoadingTimerElapse, 0 );
 	}
 
 	const bool result = ( d_hwnd != 0 );
@@ -400,6 +407,10 @@ LRESULT CALLBACK KView::WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM
 			result = true;
 			break;
 
+		case WM_TIMER:
+			s_view->onTimer( wParam, lParam );
+			break;
+
 		case WM_LBUTTONDOWN:
 			s_view->onLButtonDown( wParam, lParam );
 			break;
@@ -465,6 +476,16 @@ void KView::onPaint()
 	}
 }
 
+void KView::onTimer( WPARAM wParam, LPARAM /*lParam*/ )
+{
+	if ( wParam == LoadingTimerId )
+	{
+		if ( !d_beController->isLoading() )
+			::KillTimer( d_hwnd, LoadingTimerId );
+		refresh();
+	}
+}
+
 void KView::onLButtonDown( WPARAM wParam, LPARAM lParam )
 {
 	const be::coord_t x = LOWORD( lParam );
@@ -0,0 +1,759 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "beMapStream.h"
+#include "beMapReader.h"
+#include "beMapWriter.h"
+#include "beInstance.h"
+#include "beDocument.h"
+#include "beController.h"
+#include "beInternalDocument.h"
+#include "beBitmap.h"
+#include "beConsts.h"
+#include "beConfig.h"
+#include "mtMapImporter.h"
+#include <random>
+#include <atomic>
+#include <cstring>
+
+// counts the heap allocations, so the benchmark can check that the frames
+// don't allocate once the buffers have grown (vide benchMap)
+std::atomic< std::size_t > g_allocationsCount( 0 );
+
+void* operator new( std::size_t size )
+{
+	++g_allocationsCount;
+	void* result = std::malloc( ( size != 0 ) ? size : 1 );
+	if ( result == nullptr )
+		throw std::bad_alloc();
+	return result;
+}
+
+void* operator new[]( std::size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void* memory ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete( void* memory, std::size_t /*size*/ ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete[]( void* memory ) noexcept
+{
+	std::free( memory );
+}
+
+void operator delete[]( void* memory, std::size_t /*size*/ ) noexcept
+{
+	std::free( memory );
+}
+
+namespace
+{
+
+using args_t = std::vector< std::string >;
+
+const char* const Usage =
+	"usage:\n"
+	"\tMapTool compile <input map file> <output indexed map file>\n"
+	"\tMapTool compress <input map file> <output delta encoded map file>\n"
+	"\tMapTool compare <map file> <map file>\n"
+	"\tMapTool index <map file> <output index image file>\n"
+	"\tMapTool import <GeoJSON or CSV file, - for stdin> <output map file> [options]\n"
+	"\tMapTool grid <output map file> <number of segments>\n"
+	"\tMapTool bench <map file> [number of frames] [compact|rtree]\n"
+	"\tMapTool buildbench [max number of points] [compact|rtree]\n"
+	"\tMapTool readbench <map file> [number of reads]\n"
+	"\n"
+	"import options:\n"
+	"\tformat=geojson|csv - by default deduced from the extension (.csv)\n"
+	"\tproperty=<name> - feature property or CSV column with the road class (road_class)\n"
+	"\tgeometry=<name> - CSV column with the WKT geometry (WKT)\n"
+	"\tclasses=<value>:<class>,... - maps the property values onto road classes\n"
+	"\tdefault-class=<class>|skip - class of features with missing or unmapped property (0)\n"
+	"\tscale=<factor> - coordinates are multiplied by it and rounded (1)\n"
+	"\tflip-y - negates y, e.g. for latitude\n"
+	"\tthreads=<count> - parsing threads (all hardware threads)\n";
+
+// ----------------------------------------------------------------------------
+
+bool hasExtension( const std::string& fname, const std::string& extension )
+{
+	const bool result = ( extension.size() < fname.size() )
+		&& std::equal( extension.rbegin(), extension.rend(), fname.rbegin(),
+			[]( const char lhs, const char rhs )
+			{
+				return std::tolower( static_cast< unsigned char >( lhs ) )
+					== std::tolower( static_cast< unsigned char >( rhs ) );
+			} );
+	return result;
+}
+
+bool isCompressed( const std::string& fname )
+{
+	const bool result = hasExtension( fname, ".gz" );
+	return result;
+}
+
+be::IMapStream* createMapStream( const std::string& fname )
+{
+	if ( isCompressed( fname ) )
+	{
+		#ifdef ENABLE_COMPRESSED_MAP_STREAM
+		return be::IMapStream::createCompressed( fname );
+		#else
+		throw std::runtime_error( "compressed maps are not supported in this build, cannot open map file '" + fname + "'" );
+		#endif
+	}
+
+	be::IMapStream* mapStream = be::IMapStream::createMapped( fname );
+	if ( mapStream == nullptr )
+		mapStream = be::IMapStream::create( fname );
+	return mapStream;
+}
+
+void loadMap(
+	const std::string& fname,
+	be::SRect* mapRect,
+	be::SSegments* segments,
+	std::size_t* pointsCount )
+{
+	std::unique_ptr< be::IMapStream > mapStream( createMapStream( fname ) );
+	if ( !mapStream )
+		throw std::runtime_error( "cannot open map file '" + fname + "'" );
+
+	be::bools_t roadClasses;
+	be::SReaderData readerData(
+		mapStream.get(),
+		mapRect,
+		&roadClasses,
+		segments,
+		pointsCount );
+	if ( !be::readMap( readerData ) )
+		throw std::runtime_error( "there are no segments in map file '" + fname + "'" );
+}
+
+void storeMap(
+	const std::string& fname,
+	const be::SRect& mapRect,
+	const be::SSegments& segments,
+	const be::EMapEncoding encoding )
+{
+	std::ofstream output( fname, std::ios::binary | std::ios::trunc );
+	if ( !output )
+		throw std::runtime_error( "cannot create map file '" + fname + "'" );
+
+	be::SWriterData writerData( &output, &mapRect, &segments, encoding );
+	if ( !be::writeMap( writerData ) )
+		throw std::runtime_error( "cannot write map file '" + fname + "'" );
+}
+
+// ----------------------------------------------------------------------------
+
+void convertMap(
+	const args_t& args,
+	const be::EMapEncoding encoding )
+{
+	const std::string& inputFname = args[ 0 ];
+	const std::string& outputFname = args[ 1 ];
+
+	be::SRect mapRect;
+	be::SSegments segments;
+	std::size_t pointsCount = 0;
+	loadMap( inputFname, &mapRect, &segments, &pointsCount );
+	storeMap( outputFname, mapRect, segments, encoding );
+
+	std::cout << "compiled " << segments.size() << " segments, "
+		<< pointsCount << " points into '" << outputFname << "'" << std::endl;
+}
+
+void compileMap( const args_t& args )
+{
+	convertMap( args, be::PlainMapEncoding );
+}
+
+// any map may be converted back with the 'compile' command
+void compressMap( const args_t& args )
+{
+	convertMap( args, be::DeltaMapEncoding );
+}
+
+// the maps are equal if they have the same segments, regardless of format
+void compareMaps( const args_t& args )
+{
+	const std::string& lhsFname = args[ 0 ];
+	const std::string& rhsFname = args[ 1 ];
+
+	be::SRect lhsMapRect;
+	be::SSegments lhsSegments;
+	std::size_t lhsPointsCount = 0;
+	loadMap( lhsFname, &lhsMapRect, &lhsSegments, &lhsPointsCount );
+
+	be::SRect rhsMapRect;
+	be::SSegments rhsSegments;
+	std::size_t rhsPointsCount = 0;
+	loadMap( rhsFname, &rhsMapRect, &rhsSegments, &rhsPointsCount );
+
+	const bool equal = !( lhsMapRect != rhsMapRect )
+		&& ( lhsPointsCount == rhsPointsCount )
+		&& ( lhsSegments.d_roadClassIndexes == rhsSegments.d_roadClassIndexes )
+		&& ( lhsSegments.d_offsets == rhsSegments.d_offsets )
+		&& std::equal(
+			lhsSegments.d_points.begin(), lhsSegments.d_points.end(),
+			rhsSegments.d_points.begin(), rhsSegments.d_points.end(),
+			[]( const be::SPointPos& lhsPos, const be::SPointPos& rhsPos )
+			{
+				return lhsPos.getPoint() == rhsPos.getPoint();
+			} );
+	if ( !equal )
+		throw std::runtime_error( "maps '" + lhsFname + "' and '" + rhsFname + "' differ" );
+
+	std::cout << "maps are equal, " << lhsSegments.size() << " segments, "
+		<< lhsPointsCount << " points" << std::endl;
+}
+
+void indexMap( const args_t& args )
+{
+	const std::string& mapFname = args[ 0 ];
+	const std::string& indexFname = args[ 1 ];
+
+	std::unique_ptr< be::IMapStream > mapStream( createMapStream( mapFname ) );
+	if ( !mapStream )
+		throw std::runtime_error( "cannot open map file '" + mapFname + "'" );
+
+	// the backend builds the indexes and stores them if there is no valid image
+	std::remove( indexFname.c_str() );
+	be::SInstance instance;
+	if ( !instance.init( mapStream.get(), indexFname ) )
+		throw std::runtime_error( "cannot load map file '" + mapFname + "'" );
+
+	std::ifstream image( indexFname, std::ios::binary );
+	if ( !image )
+		throw std::runtime_error( "cannot write index image '" + indexFname + "'" );
+
+	std::cout << "stored index image '" << indexFname << "'" << std::endl;
+}
+
+// ----------------------------------------------------------------------------
+
+std::size_t parseCount( const std::string& value )
+{
+	std::size_t parsedCount = 0;
+	const long long result = std::stoll( value, &parsedCount );
+	if ( ( parsedCount != value.size() ) || ( result <= 0 ) )
+		throw std::invalid_argument( "invalid count '" + value + "'" );
+	return static_cast< std::size_t >( result );
+}
+
+/*
+	synthetic map for benchmarks: a square grid of junctions joined by
+	two-point segments of random road classes, the junctions are shifted a
+	bit at random, so most of the sections are inclined; the same count
+	gives always the same map
+*/
+void generateGrid(
+	const std::size_t segmentsCount,
+	be::SRect* mapRect,
+	be::SSegments* segments )
+{
+	// n x n junctions make 2 * n * ( n - 1 ) segments
+	std::size_t n = 2;
+	while ( 2 * n * ( n - 1 ) < segmentsCount )
+		++n;
+
+	const be::coord_t step = 100;
+	const be::coord_t maxShift = step / 8;
+	std::mt19937 random( 1 );
+	std::uniform_int_distribution< be::coord_t > shiftDistribution( -maxShift, maxShift );
+	std::uniform_int_distribution< int > roadClassDistribution( 0, be::consts::MaxRoadClassIndex );
+
+	be::points_t junctions;
+	junctions.reserve( n * n );
+	for ( std::size_t i = 0; i < n * n; ++i )
+	{
+		const be::coord_t x = static_cast< be::coord_t >( i % n ) * step + shiftDistribution( random );
+		const be::coord_t y = static_cast< be::coord_t >( i / n ) * step + shiftDistribution( random );
+		junctions.push_back( be::SPoint( x, y ) );
+	}
+
+	segments->reserve( segmentsCount, 2 * segmentsCount );
+	const auto addSegment = [ & ]( const std::size_t begin, const std::size_t end )
+	{
+		if ( segments->size() < segmentsCount )
+		{
+			segments->d_points.push_back( be::SPointPos( junctions[ begin ] ) );
+			segments->d_points.push_back( be::SPointPos( junctions[ end ] ) );
+			segments->closeSegment( roadClassDistribution( random ) );
+		}
+	};
+	for ( std::size_t i = 0; i < n * n; ++i )
+	{
+		if ( ( i % n ) + 1 < n )
+			addSegment( i, i + 1 );
+		if ( i + n < n * n )
+			addSegment( i, i + n );
+	}
+
+	const be::coord_t size = static_cast< be::coord_t >( n - 1 ) * step;
+	*mapRect = be::SRect( -maxShift, -maxShift, size + maxShift, size + maxShift );
+}
+
+void generateMap( const args_t& args )
+{
+	const std::string& outputFname = args[ 0 ];
+	const std::size_t segmentsCount = parseCount( args[ 1 ] );
+
+	be::SRect mapRect;
+	be::SSegments segments;
+	generateGrid( segmentsCount, &mapRect, &segments );
+	storeMap( outputFname, mapRect, segments, be::PlainMapEncoding );
+
+	std::cout << "generated " << segments.size() << " segments, "
+		<< segments.getPointsCount() << " points into '" << outputFname << "'" << std::endl;
+}
+
+// ----------------------------------------------------------------------------
+
+class KBenchBitmap : public be::IBitmap
+{
+	public:
+		explicit KBenchBitmap( const be::SSize& size );
+
+	public:
+		bool lock( be::color_t** buffer ) override;
+		void unlock() override;
+
+	private:
+		std::vector< be::color_t > d_buffer;
+
+};
+
+KBenchBitmap::KBenchBitmap( const be::SSize& size )
+	: d_buffer( static_cast< std::size_t >( size.width ) * size.height )
+{
+}
+
+bool KBenchBitmap::lock( be::color_t** buffer )
+{
+	*buffer = d_buffer.data();
+	return true;
+}
+
+void KBenchBitmap::unlock()
+{
+}
+
+be::EIndexMode parseIndexMode( const std::string& value )
+{
+	if ( value == "compact" )
+		return be::CompactIndexes;
+	if ( value == "rtree" )
+		return be::RTreeIndexes;
+	throw std::runtime_error( "unknown index mode '" + value + "'" );
+}
+
+// vide IController::getParamsDescription
+be::SRect parseViewportRect( const std::string& paramsDescription )
+{
+	std::istringstream is( paramsDescription );
+	std::string label;
+	be::SRect result;
+	is >> label >> result.left >> label >> result.top
+		>> label >> result.right >> label >> result.bottom;
+	if ( !is )
+		throw std::runtime_error( "unexpected params description '" + paramsDescription + "'" );
+	return result;
+}
+
+/*
+	loads the map (without the index image, so the indexes are built) and
+	reports the memory it takes, then at each zoom factor from the initial
+	one down to the closest pans around the initial view zoomed in place,
+	each step generates the contents like the frontends do; the first round
+	of the pan warms up the buffers of the controller, after it the frames
+	should not allocate at all, else the bench fails; then the same views
+	are only selected, to compare the spatial indexes apart from the drawing
+*/
+void benchMap( const args_t& args )
+{
+	using clock_t = std::chrono::steady_clock;
+	using milliseconds_t = std::chrono::duration< double, std::milli >;
+
+	const std::string& mapFname = args[ 0 ];
+	const std::size_t framesCount = ( 1 < args.size() ) ? parseCount( args[ 1 ] ) : 100;
+	const be::EIndexMode indexMode = ( 2 < args.size() ) ? parseIndexMode( args[ 2 ] ) : be::FastIndexes;
+
+	std::unique_ptr< be::IMapStream > mapStream( createMapStream( mapFname ) );
+	if ( !mapStream )
+		throw std::runtime_error( "cannot open map file '" + mapFname + "'" );
+
+	const clock_t::time_point loadBegin = clock_t::now();
+	be::SInstance instance;
+	if ( !instance.init( mapStream.get(), std::string(), indexMode ) )
+		throw std::runtime_error( "cannot load map file '" + mapFname + "'" );
+	const milliseconds_t loadTime = clock_t::now() - loadBegin;
+	std::cout << "loaded '" << mapFname << "' in " << loadTime.count() << " ms" << std::endl;
+
+	const be::SMemoryUsage& memoryUsage = instance.d_document->getMemoryUsage();
+	std::cout << "memory: segments " << memoryUsage.d_segments
+		<< ", range tree nodes " << memoryUsage.d_rangeTreeNodes
+		<< ", range tree lists " << memoryUsage.d_rangeTreeLists
+		<< ", interval trees " << memoryUsage.d_intervalTrees
+		<< ", sections r-tree " << memoryUsage.d_sectionsRTree
+		<< ", total " << memoryUsage.getTotal() << " bytes" << std::endl;
+
+	const be::SSize deviceSize( 800, 480 );
+	KBenchBitmap bitmap( deviceSize );
+	be::IController* controller = instance.d_controller;
+	controller->setDeviceSize( deviceSize );
+	const be::IInternalDocument* document = dynamic_cast< const be::IInternalDocument* >( instance.d_document );
+	be::SSelectionBuffers selectionBuffers;
+	std::size_t totalSteadyAllocationsCount = 0;
+
+	// goes round the initial view, so it doesn't leave the map
+	const be::EDirection directions[] = {
+		be::East, be::East, be::South, be::South, be::West, be::West, be::North, be::North };
+	const std::size_t directionsCount = sizeof( directions ) / sizeof( directions[ 0 ] );
+	const be::SPoint deviceCenter( deviceSize.width / 2, deviceSize.height / 2 );
+	for ( int zoomFactor = be::consts::InitZoomFactor
+		; be::consts::MinZoomFactor <= zoomFactor
+		; --zoomFactor )
+	{
+		const auto resetView = [ controller, zoomFactor, &deviceCenter ]()
+		{
+			controller->resetView();
+			const int zoomInDelta = be::consts::InitZoomFactor - zoomFactor;
+			if ( 0 < zoomInDelta )
+				controller->zoom( be::SZoomData( be::SZoomData::ZoomIn, zoomInDelta, true, deviceCenter ) );
+		};
+
+		resetView();
+		std::size_t generatedCount = 0;
+		std::size_t steadyAllocationsCount = 0;
+		const clock_t::time_point framesBegin = clock_t::now();
+		for ( std::size_t frame = 0; frame < framesCount; ++frame )
+		{
+			const std::size_t allocationsCount = g_allocationsCount;
+			controller->move( be::SMoveData( directions[ frame % directionsCount ] ) );
+			if ( controller->generateContents( &bitmap ) )
+				++generatedCount;
+			if ( directionsCount <= frame )
+				steadyAllocationsCount += g_allocationsCount - allocationsCount;
+		}
+		const milliseconds_t framesTime = clock_t::now() - framesBegin;
+
+		resetView();
+		milliseconds_t selectionTime( 0 );
+		for ( std::size_t frame = 0; frame < framesCount; ++frame )
+		{
+			controller->move( be::SMoveData( directions[ frame % directionsCount ] ) );
+			const be::SRect& viewportRect = parseViewportRect( controller->getParamsDescription() );
+			const clock_t::time_point selectionBegin = clock_t::now();
+			document->selectSections( viewportRect, &selectionBuffers );
+			selectionTime += clock_t::now() - selectionBegin;
+		}
+
+		std::cout << "zoom factor " << zoomFactor << ": " << framesCount << " frames ("
+			<< generatedCount << " not empty), " << framesTime.count() / framesCount
+			<< " ms per frame (" << selectionTime.count() / framesCount << " ms selecting), "
+			<< steadyAllocationsCount << " allocations after the first round"
+			<< std::endl;
+		totalSteadyAllocationsCount += steadyAllocationsCount;
+	}
+
+	// the brute force checker builds its own selections in each frame
+	#ifndef BRUTE_FORCE_SELECT_SECTIONS_CHECKER
+	if ( totalSteadyAllocationsCount != 0 )
+	{
+		throw std::runtime_error( "the frames allocated "
+			+ std::to_string( totalSteadyAllocationsCount ) + " times after the first round" );
+	}
+	#endif
+}
+
+/*
+	times building of the indexes of the synthetic maps (vide generateGrid)
+	from 10k points up to the given count (10M by default), ten times more
+	each step; the maps are kept in memory, so the time is mostly the one
+	of the indexes
+*/
+void benchBuild( const args_t& args )
+{
+	using clock_t = std::chrono::steady_clock;
+	using milliseconds_t = std::chrono::duration< double, std::milli >;
+
+	const std::size_t maxPointsCount = ( 0 < args.size() ) ? parseCount( args[ 0 ] ) : 10000000;
+	const be::EIndexMode indexMode = ( 1 < args.size() ) ? parseIndexMode( args[ 1 ] ) : be::FastIndexes;
+
+	for ( std::size_t pointsCount = 10000
+		; pointsCount <= maxPointsCount
+		; pointsCount *= 10 )
+	{
+		std::vector< int > map;
+		{
+			// the segments of the grid have two points each
+			be::SRect mapRect;
+			be::SSegments segments;
+			generateGrid( pointsCount / 2, &mapRect, &segments );
+
+			std::ostringstream output( std::ios::binary );
+			be::SWriterData writerData( &output, &mapRect, &segments, be::PlainMapEncoding );
+			if ( !be::writeMap( writerData ) )
+				throw std::runtime_error( "cannot write generated map" );
+			const std::string& bytes = output.str();
+			map.resize( bytes.size() / sizeof( int ) );
+			std::memcpy( map.data(), bytes.data(), map.size() * sizeof( int ) );
+		}
+
+		std::unique_ptr< be::IMapStream > mapStream( be::IMapStream::create( map.data(), map.data() + map.size() ) );
+		const clock_t::time_point buildBegin = clock_t::now();
+		be::SInstance instance;
+		if ( !instance.init( mapStream.get(), std::string(), indexMode ) )
+			throw std::runtime_error( "cannot load generated map" );
+		const milliseconds_t buildTime = clock_t::now() - buildBegin;
+
+		std::cout << pointsCount << " points: built in " << buildTime.count() << " ms ("
+			<< buildTime.count() * 1000000 / pointsCount << " ms per million points), "
+			<< instance.d_document->getMemoryUsage().getTotal() << " bytes" << std::endl;
+	}
+}
+
+/*
+	times reading of the map (vide be::readMap) through the stream reading
+	the file with fread and through the memory-mapped one, which hands out
+	the blocks of points straight from the mapping and lets the segments be
+	parsed in parallel; each read opens the file anew, the first one of each
+	kind is not timed, so both read the file from the page cache
+*/
+void benchRead( const args_t& args )
+{
+	using clock_t = std::chrono::steady_clock;
+	using milliseconds_t = std::chrono::duration< double, std::milli >;
+
+	const std::string& mapFname = args[ 0 ];
+	const std::size_t readsCount = ( 1 < args.size() ) ? parseCount( args[ 1 ] ) : 5;
+
+	struct SStreamKind
+	{
+		const char* d_name;
+		be::IMapStream* ( *d_create )( const std::string& fname );
+	};
+	const SStreamKind streamKinds[] = {
+		{ "fread", be::IMapStream::create },
+		{ "mapped", be::IMapStream::createMapped }
+	};
+
+	std::size_t firstPointsCount = 0;
+	for ( const SStreamKind& streamKind : streamKinds )
+	{
+		milliseconds_t minReadTime( std::numeric_limits< double >::max() );
+		milliseconds_t totalReadTime( 0 );
+		std::size_t pointsCount = 0;
+		for ( std::size_t read = 0; read <= readsCount; ++read )
+		{
+			const clock_t::time_point readBegin = clock_t::now();
+			std::unique_ptr< be::IMapStream > mapStream( streamKind.d_create( mapFname ) );
+			if ( !mapStream )
+				throw std::runtime_error( "cannot open map file '" + mapFname + "' (" + streamKind.d_name + ")" );
+
+			be::SRect mapRect;
+			be::bools_t roadClasses;
+			be::SSegments segments;
+			pointsCount = 0;
+			be::SReaderData readerData(
+				mapStream.get(),
+				&mapRect,
+				&roadClasses,
+				&segments,
+				&pointsCount );
+			if ( !be::readMap( readerData ) )
+				throw std::runtime_error( "cannot read map file '" + mapFname + "'" );
+			const milliseconds_t readTime = clock_t::now() - readBegin;
+
+			if ( read != 0 )
+			{
+				minReadTime = std::min( minReadTime, readTime );
+				totalReadTime += readTime;
+			}
+		}
+
+		// both streams have to give the same map
+		if ( firstPointsCount == 0 )
+			firstPointsCount = pointsCount;
+		else if ( pointsCount != firstPointsCount )
+			throw std::runtime_error( "the streams read different maps" );
+
+		std::cout << streamKind.d_name << ": " << readsCount << " reads of " << pointsCount
+			<< " points, best " << minReadTime.count() << " ms, average "
+			<< totalReadTime.count() / readsCount << " ms" << std::endl;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+int parseRoadClass( const std::string& value )
+{
+	std::size_t parsedCount = 0;
+	const int result = std::stoi( value, &parsedCount );
+	if ( ( parsedCount != value.size() ) || ( result < 0 ) || ( be::consts::MaxRoadClassIndex < result ) )
+		throw std::runtime_error( "invalid road class '" + value + "'" );
+	return result;
+}
+
+// <value>:<class>,<value>:<class>,...
+void parseRoadClasses(
+	const std::string& value,
+	std::map< std::string, int, std::less<> >* roadClasses )
+{
+	std::istringstream input( value );
+	std::string item;
+	while ( std::getline( input, item, ',' ) )
+	{
+		const std::size_t separator = item.rfind( ':' );
+		if ( ( separator == std::string::npos ) || ( separator == 0 ) )
+			throw std::runtime_error( "invalid road class mapping '" + item + "'" );
+		( *roadClasses )[ item.substr( 0, separator ) ] = parseRoadClass( item.substr( separator + 1 ) );
+	}
+}
+
+void parseImportOption( const std::string& option, mt::SImportOptions* options )
+{
+	const std::size_t separator = option.find( '=' );
+	const std::string name = option.substr( 0, separator );
+	const std::string value = ( separator != std::string::npos )
+		? option.substr( separator + 1 )
+		: std::string();
+
+	if ( ( name == "format" ) && ( ( value == "geojson" ) || ( value == "csv" ) ) )
+		options->d_format = ( value == "csv" ) ? mt::CsvImportFormat : mt::GeoJsonImportFormat;
+	else if ( ( name == "property" ) && !value.empty() )
+		options->d_roadClassProperty = value;
+	else if ( ( name == "geometry" ) && !value.empty() )
+		options->d_geometryColumn = value;
+	else if ( ( name == "classes" ) && !value.empty() )
+		parseRoadClasses( value, &options->d_roadClasses );
+	else if ( ( name == "default-class" ) && !value.empty() )
+		options->d_defaultRoadClass = ( value == "skip" ) ? -1 : parseRoadClass( value );
+	else if ( ( name == "scale" ) && !value.empty() )
+		options->d_scale = std::stod( value );
+	else if ( ( name == "flip-y" ) && ( separator == std::string::npos ) )
+		options->d_flipY = true;
+	else if ( ( name == "threads" ) && !value.empty() )
+		options->d_threadsCount = std::stoul( value );
+	else
+		throw std::runtime_error( "invalid import option '" + option + "'" );
+}
+
+/*
+	the output is the plain map file, it may be compiled or compressed
+	afterwards; the input may be piped, e.g. zcat roads.geojson.gz | MapTool
+	import - roads.dat
+*/
+void importMap( const args_t& args )
+{
+	const std::string& inputFname = args[ 0 ];
+	const std::string& outputFname = args[ 1 ];
+
+	mt::SImportOptions options;
+	if ( hasExtension( inputFname, ".csv" ) )
+		options.d_format = mt::CsvImportFormat;
+	for ( auto it = args.begin() + 2; it != args.end(); ++it )
+		parseImportOption( *it, &options );
+
+	std::ifstream inputFile;
+	if ( inputFname != "-" )
+	{
+		inputFile.open( inputFname, std::ios::binary );
+		if ( !inputFile )
+			throw std::runtime_error( "cannot open input file '" + inputFname + "'" );
+	}
+	std::istream& input = inputFile.is_open() ? inputFile : std::cin;
+
+	std::ofstream output( outputFname, std::ios::binary | std::ios::trunc );
+	if ( !output )
+		throw std::runtime_error( "cannot create map file '" + outputFname + "'" );
+
+	mt::SImportStats stats;
+	const mt::SImporterData importerData( &input, &output, &options, &stats );
+	mt::importMap( importerData );
+
+	std::cout << "imported " << stats.d_segmentsCount << " segments, "
+		<< stats.d_pointsCount << " points into '" << outputFname << "'";
+	if ( stats.d_skippedCount != 0 )
+		std::cout << ", skipped " << stats.d_skippedCount << " features";
+	std::cout << std::endl;
+}
+
+// ----------------------------------------------------------------------------
+
+struct SCommand
+{
+	const char* d_name;
+	std::size_t d_minArgsCount;
+	std::size_t d_maxArgsCount;
+	void ( *d_run )( const args_t& args );
+};
+
+const std::size_t ImportOptionsCount = 8;
+
+const SCommand Commands[] = {
+	{ "compile", 2, 2, compileMap },
+	{ "compress", 2, 2, compressMap },
+	{ "compare", 2, 2, compareMaps },
+	{ "index", 2, 2, indexMap },
+	{ "import", 2, 2 + ImportOptionsCount, importMap },
+	{ "grid", 2, 2, generateMap },
+	{ "bench", 1, 3, benchMap },
+	{ "buildbench", 0, 2, benchBuild },
+	{ "readbench", 1, 2, benchRead }
+};
+
+const SCommand* findCommand( const std::string& name, const std::size_t argsCount )
+{
+	for ( const SCommand& command : Commands )
+	{
+		if ( ( name == command.d_name )
+			&& ( command.d_minArgsCount <= argsCount )
+			&& ( argsCount <= command.d_maxArgsCount ) )
+		{
+			return &command;
+		}
+	}
+	return nullptr;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+int main( int argc, char* argv[] )
+{
+	int result = EXIT_FAILURE;
+	const args_t args( argv + 1, argv + argc );
+	const SCommand* command = args.empty()
+		? nullptr
+		: findCommand( args.front(), args.size() - 1 );
+	if ( command != nullptr )
+	{
+		try
+		{
+			const args_t commandArgs( args.begin() + 1, args.end() );
+			command->d_run( commandArgs );
+			result = EXIT_SUCCESS;
+		}
+		catch ( std::exception& e )
+		{
+			std::cerr << "error: " << e.what() << std::endl;
+		}
+	}
+	else
+	{
+		std::cerr << Usage;
+	}
+	return result;
+}
@@ -0,0 +1,1688 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#include "ph.h"
+#include "mtMapImporter.h"
+#include "beConsts.h"
+#include <charconv>
+#include <string_view>
+#include <deque>
+#include <cmath>
+#include <cctype>
+#include <cstring>
+
+namespace mt
+{
+
+namespace
+{
+
+// the input is split into chunks of whole features (or CSV rows), each of
+// them is parsed as a separate task
+const std::size_t ChunkSize = 4 * 1024 * 1024;
+
+// a single feature (or row) may exceed the chunk, but not this size, so the
+// memory stays bounded whatever the input is
+const std::size_t MaxRecordSize = 64 * ChunkSize;
+
+const char* const Utf8Bom = "\xEF\xBB\xBF";
+
+// GeoJSON text sequences (RFC 8142) prefix each feature with this character
+const char RecordSeparator = '\x1E';
+
+using ints_t = std::vector< int >;
+using doubles_t = std::vector< double >;
+using sizes_t = std::vector< std::size_t >;
+using fields_t = std::vector< std::string_view >;
+
+// ----------------------------------------------------------------------------
+
+/*
+	segments parsed from one chunk, they are already serialized in the plain
+	map format (road class, points count, points), so storing them is just
+	a single write
+*/
+struct SParsedChunk
+{
+	SParsedChunk();
+
+	ints_t d_data;
+	std::size_t d_segmentsCount;
+	std::size_t d_pointsCount;
+	std::size_t d_skippedCount;
+};
+
+SParsedChunk::SParsedChunk()
+	: d_segmentsCount( 0 )
+	, d_pointsCount( 0 )
+	, d_skippedCount( 0 )
+{
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KRoadClassMapper
+{
+	public:
+		explicit KRoadClassMapper( const SImportOptions& options );
+
+	public:
+		// both return -1 if the feature has to be skipped
+		int mapNumber( std::string_view text, double value ) const;
+		int mapText( std::string_view text ) const;
+		int getDefault() const;
+
+	private:
+		int lookup( std::string_view text ) const;
+
+	private:
+		const SImportOptions& d_options;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KRoadClassMapper::KRoadClassMapper( const SImportOptions& options )
+	: d_options( options )
+{
+}
+
+int KRoadClassMapper::mapNumber( const std::string_view text, const double value ) const
+{
+	if ( !d_options.d_roadClasses.empty() )
+		return lookup( text );
+
+	if ( std::isnan( value ) )
+		return getDefault();
+
+	const double roadClass = std::round( value );
+	if ( roadClass <= 0.0 )
+		return 0;
+	if ( be::consts::MaxRoadClassIndex <= roadClass )
+		return be::consts::MaxRoadClassIndex;
+	return static_cast< int >( roadClass );
+}
+
+int KRoadClassMapper::mapText( const std::string_view text ) const
+{
+	if ( !d_options.d_roadClasses.empty() )
+		return lookup( text );
+
+	double value = 0.0;
+	const char* end = text.data() + text.size();
+	const std::from_chars_result number = std::from_chars( text.data(), end, value );
+	if ( ( number.ec != std::errc() ) || ( number.ptr != end ) )
+		return getDefault();
+
+	return mapNumber( text, value );
+}
+
+int KRoadClassMapper::getDefault() const
+{
+	return d_options.d_defaultRoadClass;
+}
+
+int KRoadClassMapper::lookup( const std::string_view text ) const
+{
+	auto it = d_options.d_roadClasses.find( text );
+	const int result = ( it != d_options.d_roadClasses.end() )
+		? it->second
+		: getDefault();
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+// data shared (read-only) by all the parsing tasks
+struct SParserContext
+{
+	explicit SParserContext( const SImportOptions& options );
+
+	const SImportOptions& d_options;
+	const KRoadClassMapper d_roadClassMapper;
+
+	// CSV only, found in the header
+	std::size_t d_roadClassColumn;
+	std::size_t d_geometryColumn;
+};
+
+SParserContext::SParserContext( const SImportOptions& options )
+	: d_options( options )
+	, d_roadClassMapper( options )
+	, d_roadClassColumn( 0 )
+	, d_geometryColumn( 0 )
+{
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	polylines of a single feature, the coordinates are kept as they are
+	read, since in GeoJSON the road class may come after the geometry
+*/
+class KGeometry
+{
+	public:
+		void clear();
+		void addPosition( double x, double y );
+		void endLine();
+
+	public:
+		std::size_t getLinesCount() const;
+		// range of coords of the line, each position takes two of them
+		void getLine( std::size_t lineIndex, const double** begin, const double** end ) const;
+
+	private:
+		doubles_t d_coords;
+		sizes_t d_lineEnds;
+
+};
+
+// ----------------------------------------------------------------------------
+
+void KGeometry::clear()
+{
+	d_coords.clear();
+	d_lineEnds.clear();
+}
+
+void KGeometry::addPosition( const double x, const double y )
+{
+	d_coords.push_back( x );
+	d_coords.push_back( y );
+}
+
+void KGeometry::endLine()
+{
+	d_lineEnds.push_back( d_coords.size() );
+}
+
+std::size_t KGeometry::getLinesCount() const
+{
+	return d_lineEnds.size();
+}
+
+void KGeometry::getLine(
+	const std::size_t lineIndex,
+	const double** begin,
+	const double** end ) const
+{
+	const std::size_t lineBegin = ( lineIndex == 0 ) ? 0 : d_lineEnds[ lineIndex - 1 ];
+	*begin = d_coords.data() + lineBegin;
+	*end = d_coords.data() + d_lineEnds[ lineIndex ];
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+// converts the polylines into segments of the plain map file
+class KSegmentsSink
+{
+	public:
+		KSegmentsSink(
+			const SImportOptions& options,
+			SParsedChunk* chunk );
+
+	public:
+		// returns false if no segment was added (e.g. empty geometry)
+		bool addFeature( int roadClass, const KGeometry& geometry );
+		void skipFeature();
+
+	private:
+		bool addSegment(
+			int roadClass,
+			const double* begin,
+			const double* end );
+		bool convertCoord( double value, int* coord ) const;
+
+	private:
+		const double d_scaleX;
+		const double d_scaleY;
+		SParsedChunk& d_chunk;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KSegmentsSink::KSegmentsSink(
+	const SImportOptions& options,
+	SParsedChunk* chunk )
+	: d_scaleX( options.d_scale )
+	, d_scaleY( options.d_flipY ? -options.d_scale : options.d_scale )
+	, d_chunk( *chunk )
+{
+}
+
+bool KSegmentsSink::addFeature( const int roadClass, const KGeometry& geometry )
+{
+	bool result = false;
+	if ( 0 <= roadClass )
+	{
+		for ( std::size_t i = 0; i < geometry.getLinesCount(); ++i )
+		{
+			const double* begin = nullptr;
+			const double* end = nullptr;
+			geometry.getLine( i, &begin, &end );
+			if ( addSegment( roadClass, begin, end ) )
+				result = true;
+		}
+	}
+
+	if ( !result )
+		skipFeature();
+	return result;
+}
+
+void KSegmentsSink::skipFeature()
+{
+	++d_chunk.d_skippedCount;
+}
+
+bool KSegmentsSink::addSegment(
+	const int roadClass,
+	const double* begin,
+	const double* end )
+{
+	ints_t& data = d_chunk.d_data;
+	const std::size_t segmentBegin = data.size();
+	data.push_back( roadClass );
+	data.push_back( 0 );
+
+	// consecutive duplicated points are skipped, as the reader does
+	std::size_t pointsCount = 0;
+	for ( const double* it = begin; it != end; it += 2 )
+	{
+		int x = 0;
+		int y = 0;
+		if ( !convertCoord( it[ 0 ] * d_scaleX, &x ) || !convertCoord( it[ 1 ] * d_scaleY, &y ) )
+		{
+			pointsCount = 0;
+			break;
+		}
+
+		if ( ( pointsCount == 0 ) || ( x != data[ data.size() - 2 ] ) || ( y != data.back() ) )
+		{
+			data.push_back( x );
+			data.push_back( y );
+			++pointsCount;
+		}
+	}
+
+	const bool result = ( 1 < pointsCount );
+	if ( result )
+	{
+		data[ segmentBegin + 1 ] = static_cast< int >( pointsCount );
+		++d_chunk.d_segmentsCount;
+		d_chunk.d_pointsCount += pointsCount;
+	}
+	else
+	{
+		data.resize( segmentBegin );
+	}
+	return result;
+}
+
+bool KSegmentsSink::convertCoord( const double value, int* coord ) const
+{
+	const double rounded = std::round( value );
+	// the negated condition rejects NaN too
+	if ( !( ( be::consts::MinCoord <= rounded ) && ( rounded <= be::consts::MaxCoord ) ) )
+		return false;
+
+	*coord = static_cast< int >( rounded );
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KTextScanner
+{
+	protected:
+		KTextScanner();
+
+	protected:
+		void reset( const char* begin, const char* end );
+		bool isEnd() const;
+		char peek() const;
+		void skipWhitespaces();
+		// skips the trailing whitespaces and checks whether it is the end
+		bool isFinished();
+		bool skipChar( char c );
+		bool parseNumber( double* value, std::string_view* text );
+
+	protected:
+		const char* d_cur;
+		const char* d_end;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KTextScanner::KTextScanner()
+	: d_cur( nullptr )
+	, d_end( nullptr )
+{
+}
+
+void KTextScanner::reset( const char* begin, const char* end )
+{
+	d_cur = begin;
+	d_end = end;
+}
+
+bool KTextScanner::isEnd() const
+{
+	return d_cur == d_end;
+}
+
+// returns '\0' at the end of the text
+char KTextScanner::peek() const
+{
+	return isEnd() ? '\0' : *d_cur;
+}
+
+void KTextScanner::skipWhitespaces()
+{
+	while ( !isEnd()
+		&& ( ( *d_cur == ' ' ) || ( *d_cur == '\t' ) || ( *d_cur == '\r' ) || ( *d_cur == '\n' ) ) )
+	{
+		++d_cur;
+	}
+}
+
+bool KTextScanner::isFinished()
+{
+	skipWhitespaces();
+	return isEnd();
+}
+
+bool KTextScanner::skipChar( const char c )
+{
+	skipWhitespaces();
+	const bool result = ( peek() == c );
+	if ( result )
+		++d_cur;
+	return result;
+}
+
+bool KTextScanner::parseNumber( double* value, std::string_view* text )
+{
+	skipWhitespaces();
+	const std::from_chars_result number = std::from_chars( d_cur, d_end, *value );
+	const bool result = ( number.ec == std::errc() );
+	if ( result )
+	{
+		*text = std::string_view( d_cur, number.ptr - d_cur );
+		d_cur = number.ptr;
+	}
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	splits GeoJSON of any layout into features, one per line: the features
+	are the top level objects (newline delimited GeoJSON, text sequences),
+	the items of the top level array, or the items of the "features" array
+	of the top level collection, whose other members are dropped; the line breaks inside a feature can be only
+	whitespaces (JSON strings can't contain them), so they are replaced by
+	spaces
+*/
+class KGeoJsonSplitter
+{
+	public:
+		KGeoJsonSplitter();
+
+	public:
+		// appends the features which end in [begin, end) to 'features', the
+		// beginning of the one cut at the end is kept for the next call
+		void split(
+			const char* begin,
+			const char* end,
+			std::string* features );
+
+		// appends the feature cut by the end of the input (it is malformed,
+		// so it is going to be skipped by the parser)
+		void finish( std::string* features );
+
+		// size of the beginning of the feature cut at the end of the recent
+		// block
+		std::size_t getPendingSize() const;
+
+	private:
+		void openContainer( char c );
+		void closeContainer();
+		void appendRecord( const char* begin, const char* end );
+		void endRecord( std::string* features );
+
+	private:
+		// the feature being split, if it isn't empty
+		std::string d_record;
+		bool d_isRecording;
+
+		// nesting of objects and arrays
+		int d_depth;
+		int d_recordDepth;
+		bool d_isInString;
+		bool d_isEscaped;
+
+		// the recent key of the top level object, vide openContainer
+		std::string d_key;
+		bool d_isKey;
+		bool d_isInFeatures;
+		bool d_isInTopArray;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KGeoJsonSplitter::KGeoJsonSplitter()
+	: d_isRecording( false )
+	, d_depth( 0 )
+	, d_recordDepth( 0 )
+	, d_isInString( false )
+	, d_isEscaped( false )
+	, d_isKey( false )
+	, d_isInFeatures( false )
+	, d_isInTopArray( false )
+{
+}
+
+void KGeoJsonSplitter::split(
+	const char* begin,
+	const char* end,
+	std::string* features )
+{
+	const char* recordBegin = begin;
+	for ( const char* it = begin; it != end; ++it )
+	{
+		const char c = *it;
+		if ( d_isInString )
+		{
+			if ( d_isEscaped )
+				d_isEscaped = false;
+			else if ( c == '\\' )
+				d_isEscaped = true;
+			else if ( c == '"' )
+				d_isInString = false;
+			else if ( d_isKey && ( d_key.size() < std::strlen( "features" ) + 1 ) )
+				d_key.push_back( c );
+			continue;
+		}
+
+		switch ( c )
+		{
+			case '"':
+				d_isInString = true;
+				d_isKey = ( d_depth == 1 );
+				if ( d_isKey )
+					d_key.clear();
+				break;
+
+			case '{':
+			case '[':
+				if ( !d_isRecording
+					&& ( c == '{' )
+					&& ( ( d_depth == 0 )
+						|| ( d_isInTopArray && ( d_depth == 1 ) )
+						|| ( d_isInFeatures && ( d_depth == 2 ) ) ) )
+				{
+					d_isRecording = true;
+					d_recordDepth = d_depth;
+					recordBegin = it;
+				}
+				openContainer( c );
+				if ( !d_isRecording )
+					recordBegin = it + 1;
+				break;
+
+			case '}':
+			case ']':
+				closeContainer();
+				if ( d_isRecording && ( d_depth == d_recordDepth ) )
+				{
+					appendRecord( recordBegin, it + 1 );
+					endRecord( features );
+					recordBegin = it + 1;
+				}
+				break;
+		}
+	}
+
+	if ( d_isRecording )
+		appendRecord( recordBegin, end );
+}
+
+void KGeoJsonSplitter::finish( std::string* features )
+{
+	if ( d_isRecording )
+		endRecord( features );
+}
+
+std::size_t KGeoJsonSplitter::getPendingSize() const
+{
+	return d_record.size();
+}
+
+/*
+	the top level object turns out to be a collection once its "features"
+	array is opened, then the items of the array are split instead of the
+	whole collection
+*/
+void KGeoJsonSplitter::openContainer( const char c )
+{
+	if ( ( c == '[' ) && ( d_depth == 1 ) && ( d_key == "features" ) )
+	{
+		d_isInFeatures = true;
+		d_isRecording = false;
+		d_record.clear();
+	}
+	else if ( ( c == '[' ) && ( d_depth == 0 ) )
+	{
+		d_isInTopArray = true;
+	}
+	++d_depth;
+}
+
+void KGeoJsonSplitter::closeContainer()
+{
+	if ( 0 < d_depth )
+		--d_depth;
+	if ( d_depth == 1 )
+		d_isInFeatures = false;
+	else if ( d_depth == 0 )
+		d_isInTopArray = false;
+}
+
+void KGeoJsonSplitter::appendRecord( const char* begin, const char* end )
+{
+	const std::size_t size = d_record.size();
+	d_record.append( begin, end );
+	std::replace( d_record.begin() + size, d_record.end(), '\n', ' ' );
+	std::replace( d_record.begin() + size, d_record.end(), '\r', ' ' );
+}
+
+void KGeoJsonSplitter::endRecord( std::string* features )
+{
+	features->append( d_record );
+	features->push_back( '\n' );
+	d_record.clear();
+	d_isRecording = false;
+}
+
+// ----------------------------------------------------------------------------
+
+/*
+	parses the features one per line (vide KGeoJsonSplitter), a collection
+	written in a single line is handled too
+
+	LineString and MultiLineString geometries are imported (in fact any
+	geometry whose coordinates consist of lines), the road class is taken
+	from the given feature property
+*/
+class KGeoJsonParser : protected KTextScanner
+{
+	public:
+		KGeoJsonParser(
+			const SParserContext& context,
+			SParsedChunk* chunk );
+
+	public:
+		void parseLine( const char* begin, const char* end );
+
+	private:
+		bool parseFeature();
+		bool parseFeatures();
+		bool parseGeometry();
+		bool parseGeometries();
+		bool parseCoordinates( int* depth );
+		bool parsePosition();
+		bool parseProperties( int* roadClass );
+		bool parseRoadClass( int* roadClass );
+
+		bool parseString( std::string* value );
+		bool parseUnicodeEscape( std::string* value );
+		bool parseLiteral( const char* literal );
+		bool skipValue();
+		bool skipObject();
+		bool skipArray();
+
+	private:
+		const SImportOptions& d_options;
+		const KRoadClassMapper& d_roadClassMapper;
+		KSegmentsSink d_sink;
+
+		KGeometry d_geometry;
+		double d_positionX;
+		double d_positionY;
+		std::string d_key;
+		std::string d_value;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KGeoJsonParser::KGeoJsonParser(
+	const SParserContext& context,
+	SParsedChunk* chunk )
+	: d_options( context.d_options )
+	, d_roadClassMapper( context.d_roadClassMapper )
+	, d_sink( context.d_options, chunk )
+	, d_positionX( 0.0 )
+	, d_positionY( 0.0 )
+{
+}
+
+void KGeoJsonParser::parseLine( const char* begin, const char* end )
+{
+	while ( ( begin != end )
+		&& ( ( *begin == RecordSeparator ) || ( *begin == ' ' ) || ( *begin == '\t' ) ) )
+	{
+		++begin;
+	}
+
+	while ( ( begin != end )
+		&& ( ( end[ -1 ] == ',' ) || ( end[ -1 ] == ' ' ) || ( end[ -1 ] == '\t' ) || ( end[ -1 ] == '\r' ) ) )
+	{
+		--end;
+	}
+
+	// skip the lines of the collection, e.g. "{", "]", "}" or its members
+	if ( ( end - begin < 2 ) || ( *begin != '{' ) )
+		return;
+
+	reset( begin, end );
+	if ( !parseFeature() || !isFinished() )
+		d_sink.skipFeature();
+}
+
+/*
+	parses either a feature or a feature collection, the object is treated
+	as a feature if it has the geometry member
+*/
+bool KGeoJsonParser::parseFeature()
+{
+	if ( !skipChar( '{' ) )
+		return false;
+
+	bool isFeature = false;
+	bool isCollection = false;
+	bool hasGeometry = false;
+	int roadClass = d_roadClassMapper.getDefault();
+	if ( !skipChar( '}' ) )
+	{
+		do
+		{
+			if ( !parseString( &d_key ) || !skipChar( ':' ) )
+				return false;
+
+			bool parsed = false;
+			if ( d_key == "geometry" )
+			{
+				isFeature = true;
+				d_geometry.clear();
+				skipWhitespaces();
+				hasGeometry = ( peek() != 'n' );
+				parsed = hasGeometry ? parseGeometry() : parseLiteral( "null" );
+			}
+			else if ( d_key == "properties" )
+			{
+				parsed = parseProperties( &roadClass );
+			}
+			else if ( d_key == "features" )
+			{
+				isCollection = true;
+				parsed = parseFeatures();
+			}
+			else
+			{
+				parsed = skipValue();
+			}
+
+			if ( !parsed )
+				return false;
+		}
+		while ( skipChar( ',' ) );
+
+		if ( !skipChar( '}' ) )
+			return false;
+	}
+
+	if ( isFeature )
+	{
+		if ( hasGeometry )
+			d_sink.addFeature( roadClass, d_geometry );
+		else
+			d_sink.skipFeature();
+	}
+
+	const bool result = isFeature || isCollection;
+	return result;
+}
+
+bool KGeoJsonParser::parseFeatures()
+{
+	if ( !skipChar( '[' ) )
+		return false;
+
+	if ( skipChar( ']' ) )
+		return true;
+
+	do
+	{
+		if ( !parseFeature() )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( ']' );
+	return result;
+}
+
+bool KGeoJsonParser::parseGeometry()
+{
+	if ( !skipChar( '{' ) )
+		return false;
+
+	if ( skipChar( '}' ) )
+		return true;
+
+	do
+	{
+		if ( !parseString( &d_key ) || !skipChar( ':' ) )
+			return false;
+
+		bool parsed = false;
+		if ( d_key == "coordinates" )
+		{
+			int depth = 0;
+			parsed = parseCoordinates( &depth );
+		}
+		else if ( d_key == "geometries" )
+		{
+			parsed = parseGeometries();
+		}
+		else
+		{
+			parsed = skipValue();
+		}
+
+		if ( !parsed )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( '}' );
+	return result;
+}
+
+// members of GeometryCollection
+bool KGeoJsonParser::parseGeometries()
+{
+	if ( !skipChar( '[' ) )
+		return false;
+
+	if ( skipChar( ']' ) )
+		return true;
+
+	do
+	{
+		if ( !parseGeometry() )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( ']' );
+	return result;
+}
+
+/*
+	depth is 0 for a position, 1 for a line (array of positions) and so on,
+	each array of positions becomes a separate line
+*/
+bool KGeoJsonParser::parseCoordinates( int* depth )
+{
+	if ( !skipChar( '[' ) )
+		return false;
+
+	skipWhitespaces();
+	const char c = peek();
+	if ( ( c == '-' ) || ( ( '0' <= c ) && ( c <= '9' ) ) )
+	{
+		*depth = 0;
+		return parsePosition();
+	}
+
+	*depth = 1;
+	if ( skipChar( ']' ) )
+		return true;
+
+	bool isLine = false;
+	do
+	{
+		int childDepth = 0;
+		if ( !parseCoordinates( &childDepth ) )
+			return false;
+
+		if ( childDepth == 0 )
+		{
+			d_geometry.addPosition( d_positionX, d_positionY );
+			isLine = true;
+		}
+		else
+		{
+			*depth = std::max( *depth, childDepth + 1 );
+		}
+	}
+	while ( skipChar( ',' ) );
+
+	if ( !skipChar( ']' ) )
+		return false;
+
+	if ( isLine )
+		d_geometry.endLine();
+	return true;
+}
+
+// x and y, the altitude (if any) is ignored
+bool KGeoJsonParser::parsePosition()
+{
+	std::string_view text;
+	if ( !parseNumber( &d_positionX, &text )
+		|| !skipChar( ',' )
+		|| !parseNumber( &d_positionY, &text ) )
+	{
+		return false;
+	}
+
+	double altitude = 0.0;
+	while ( skipChar( ',' ) )
+	{
+		if ( !parseNumber( &altitude, &text ) )
+			return false;
+	}
+
+	const bool result = skipChar( ']' );
+	return result;
+}
+
+bool KGeoJsonParser::parseProperties( int* roadClass )
+{
+	skipWhitespaces();
+	if ( peek() == 'n' )
+		return parseLiteral( "null" );
+
+	if ( !skipChar( '{' ) )
+		return false;
+
+	if ( skipChar( '}' ) )
+		return true;
+
+	do
+	{
+		if ( !parseString( &d_key ) || !skipChar( ':' ) )
+			return false;
+
+		const bool parsed = ( d_key == d_options.d_roadClassProperty )
+			? parseRoadClass( roadClass )
+			: skipValue();
+		if ( !parsed )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( '}' );
+	return result;
+}
+
+bool KGeoJsonParser::parseRoadClass( int* roadClass )
+{
+	skipWhitespaces();
+	const char c = peek();
+	if ( c == '"' )
+	{
+		if ( !parseString( &d_value ) )
+			return false;
+		*roadClass = d_roadClassMapper.mapText( d_value );
+	}
+	else if ( ( c == '-' ) || ( ( '0' <= c ) && ( c <= '9' ) ) )
+	{
+		double value = 0.0;
+		std::string_view text;
+		if ( !parseNumber( &value, &text ) )
+			return false;
+		*roadClass = d_roadClassMapper.mapNumber( text, value );
+	}
+	else
+	{
+		// null, boolean or a compound value
+		if ( !skipValue() )
+			return false;
+		*roadClass = d_roadClassMapper.getDefault();
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool KGeoJsonParser::parseString( std::string* value )
+{
+	if ( !skipChar( '"' ) )
+		return false;
+
+	value->clear();
+	while ( !isEnd() )
+	{
+		const char* chunkBegin = d_cur;
+		while ( !isEnd() && ( *d_cur != '"' ) && ( *d_cur != '\\' ) )
+			++d_cur;
+		value->append( chunkBegin, d_cur );
+
+		if ( isEnd() )
+			break;
+
+		if ( *d_cur++ == '"' )
+			return true;
+
+		if ( isEnd() )
+			break;
+
+		const char escaped = *d_cur++;
+		switch ( escaped )
+		{
+			case 'b': value->push_back( '\b' ); break;
+			case 'f': value->push_back( '\f' ); break;
+			case 'n': value->push_back( '\n' ); break;
+			case 'r': value->push_back( '\r' ); break;
+			case 't': value->push_back( '\t' ); break;
+			case 'u':
+				if ( !parseUnicodeEscape( value ) )
+					return false;
+				break;
+			default: value->push_back( escaped );
+		}
+	}
+	return false;
+}
+
+// stores the code unit as UTF-8, surrogate pairs are not combined
+bool KGeoJsonParser::parseUnicodeEscape( std::string* value )
+{
+	const int HexDigitsCount = 4;
+	if ( d_end - d_cur < HexDigitsCount )
+		return false;
+
+	unsigned int code = 0;
+	const std::from_chars_result number = std::from_chars( d_cur, d_cur + HexDigitsCount, code, 16 );
+	if ( ( number.ec != std::errc() ) || ( number.ptr != d_cur + HexDigitsCount ) )
+		return false;
+	d_cur += HexDigitsCount;
+
+	if ( code < 0x80 )
+	{
+		value->push_back( static_cast< char >( code ) );
+	}
+	else if ( code < 0x800 )
+	{
+		value->push_back( static_cast< char >( 0xC0 | ( code >> 6 ) ) );
+		value->push_back( static_cast< char >( 0x80 | ( code & 0x3F ) ) );
+	}
+	else
+	{
+		value->push_back( static_cast< char >( 0xE0 | ( code >> 12 ) ) );
+		value->push_back( static_cast< char >( 0x80 | ( ( code >> 6 ) & 0x3F ) ) );
+		value->push_back( static_cast< char >( 0x80 | ( code & 0x3F ) ) );
+	}
+	return true;
+}
+
+bool KGeoJsonParser::parseLiteral( const char* literal )
+{
+	skipWhitespaces();
+	const std::size_t length = std::strlen( literal );
+	const bool result = ( length <= static_cast< std::size_t >( d_end - d_cur ) )
+		&& ( std::memcmp( d_cur, literal, length ) == 0 );
+	if ( result )
+		d_cur += length;
+	return result;
+}
+
+bool KGeoJsonParser::skipValue()
+{
+	skipWhitespaces();
+	switch ( peek() )
+	{
+		case '"': return parseString( &d_value );
+		case '{': return skipObject();
+		case '[': return skipArray();
+		case 't': return parseLiteral( "true" );
+		case 'f': return parseLiteral( "false" );
+		case 'n': return parseLiteral( "null" );
+		default:
+		{
+			double value = 0.0;
+			std::string_view text;
+			return parseNumber( &value, &text );
+		}
+	}
+}
+
+bool KGeoJsonParser::skipObject()
+{
+	if ( !skipChar( '{' ) )
+		return false;
+
+	if ( skipChar( '}' ) )
+		return true;
+
+	std::string key;
+	do
+	{
+		if ( !parseString( &key ) || !skipChar( ':' ) || !skipValue() )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( '}' );
+	return result;
+}
+
+bool KGeoJsonParser::skipArray()
+{
+	if ( !skipChar( '[' ) )
+		return false;
+
+	if ( skipChar( ']' ) )
+		return true;
+
+	do
+	{
+		if ( !skipValue() )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( ']' );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+/*
+	parses CSV with a header, one feature per row, the geometry is stored in
+	the WKT format (e.g. as written by ogr2ogr -lco GEOMETRY=AS_WKT), only
+	LINESTRING and MULTILINESTRING are imported; the quoted fields must not
+	contain line breaks
+*/
+class KCsvParser : protected KTextScanner
+{
+	public:
+		KCsvParser(
+			const SParserContext& context,
+			SParsedChunk* chunk );
+
+	public:
+		void parseLine( const char* begin, const char* end );
+
+		// finds the columns of the road class and of the geometry
+		static void parseHeader(
+			const char* begin,
+			const char* end,
+			SParserContext* context );
+
+	private:
+		static void splitFields(
+			const char* begin,
+			const char* end,
+			fields_t* fields );
+		static void unquoteField(
+			std::string_view field,
+			std::string* value );
+
+		bool parseWkt( std::string_view wkt );
+		bool parseKeyword( std::string_view* keyword );
+		bool parseWktLines( int depth );
+		bool parseWktLine();
+
+	private:
+		const SParserContext& d_context;
+		KSegmentsSink d_sink;
+
+		KGeometry d_geometry;
+		fields_t d_fields;
+		std::string d_value;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KCsvParser::KCsvParser(
+	const SParserContext& context,
+	SParsedChunk* chunk )
+	: d_context( context )
+	, d_sink( context.d_options, chunk )
+{
+}
+
+void KCsvParser::parseLine( const char* begin, const char* end )
+{
+	if ( ( begin != end ) && ( end[ -1 ] == '\r' ) )
+		--end;
+
+	if ( begin == end )
+		return;
+
+	splitFields( begin, end, &d_fields );
+	const std::size_t roadClassColumn = d_context.d_roadClassColumn;
+	const std::size_t geometryColumn = d_context.d_geometryColumn;
+	if ( ( d_fields.size() <= roadClassColumn ) || ( d_fields.size() <= geometryColumn ) )
+	{
+		d_sink.skipFeature();
+		return;
+	}
+
+	unquoteField( d_fields[ roadClassColumn ], &d_value );
+	const int roadClass = d_value.empty()
+		? d_context.d_roadClassMapper.getDefault()
+		: d_context.d_roadClassMapper.mapText( d_value );
+
+	d_geometry.clear();
+	if ( parseWkt( d_fields[ geometryColumn ] ) )
+		d_sink.addFeature( roadClass, d_geometry );
+	else
+		d_sink.skipFeature();
+}
+
+void KCsvParser::parseHeader(
+	const char* begin,
+	const char* end,
+	SParserContext* context )
+{
+	if ( ( begin != end ) && ( end[ -1 ] == '\r' ) )
+		--end;
+
+	fields_t fields;
+	splitFields( begin, end, &fields );
+
+	const SImportOptions& options = context->d_options;
+	bool hasRoadClass = false;
+	bool hasGeometry = false;
+	std::string name;
+	for ( std::size_t i = 0; i < fields.size(); ++i )
+	{
+		unquoteField( fields[ i ], &name );
+		if ( name == options.d_roadClassProperty )
+		{
+			context->d_roadClassColumn = i;
+			hasRoadClass = true;
+		}
+
+		if ( name == options.d_geometryColumn )
+		{
+			context->d_geometryColumn = i;
+			hasGeometry = true;
+		}
+	}
+
+	if ( !hasRoadClass )
+		throw std::runtime_error( "there is no column '" + options.d_roadClassProperty + "' in the CSV header" );
+
+	if ( !hasGeometry )
+		throw std::runtime_error( "there is no column '" + options.d_geometryColumn + "' in the CSV header" );
+}
+
+// the fields keep their quotes, vide unquoteField
+void KCsvParser::splitFields(
+	const char* begin,
+	const char* end,
+	fields_t* fields )
+{
+	fields->clear();
+	const char* fieldBegin = begin;
+	bool quoted = false;
+	for ( const char* it = begin; it != end; ++it )
+	{
+		if ( *it == '"' )
+		{
+			quoted = !quoted;
+		}
+		else if ( ( *it == ',' ) && !quoted )
+		{
+			fields->emplace_back( fieldBegin, it - fieldBegin );
+			fieldBegin = it + 1;
+		}
+	}
+	fields->emplace_back( fieldBegin, end - fieldBegin );
+}
+
+void KCsvParser::unquoteField(
+	std::string_view field,
+	std::string* value )
+{
+	value->clear();
+	if ( ( 2 <= field.size() ) && ( field.front() == '"' ) && ( field.back() == '"' ) )
+	{
+		field = field.substr( 1, field.size() - 2 );
+		for ( std::size_t i = 0; i < field.size(); ++i )
+		{
+			value->push_back( field[ i ] );
+			// doubled quote stands for a single one
+			if ( ( field[ i ] == '"' ) && ( i + 1 < field.size() ) && ( field[ i + 1 ] == '"' ) )
+				++i;
+		}
+	}
+	else
+	{
+		value->assign( field.begin(), field.end() );
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool KCsvParser::parseWkt( std::string_view wkt )
+{
+	if ( ( 2 <= wkt.size() ) && ( wkt.front() == '"' ) && ( wkt.back() == '"' ) )
+		wkt = wkt.substr( 1, wkt.size() - 2 );
+	reset( wkt.data(), wkt.data() + wkt.size() );
+
+	std::string_view keyword;
+	if ( !parseKeyword( &keyword ) )
+		return false;
+
+	int depth = 0;
+	if ( keyword == "LINESTRING" )
+		depth = 1;
+	else if ( keyword == "MULTILINESTRING" )
+		depth = 2;
+	else
+		return false;
+
+	// optional dimensions (Z, M or ZM), the extra ordinates are ignored
+	skipWhitespaces();
+	if ( ( peek() != '(' ) && !parseKeyword( &keyword ) )
+		return false;
+
+	// empty geometry, there is nothing to import
+	skipWhitespaces();
+	if ( ( keyword == "EMPTY" )
+		|| ( ( peek() != '(' ) && parseKeyword( &keyword ) && ( keyword == "EMPTY" ) ) )
+	{
+		return isFinished();
+	}
+
+	const bool result = parseWktLines( depth ) && isFinished();
+	return result;
+}
+
+bool KCsvParser::parseKeyword( std::string_view* keyword )
+{
+	skipWhitespaces();
+	const char* begin = d_cur;
+	while ( !isEnd() && ( ( ( 'A' <= *d_cur ) && ( *d_cur <= 'Z' ) ) || ( ( 'a' <= *d_cur ) && ( *d_cur <= 'z' ) ) ) )
+		++d_cur;
+	*keyword = std::string_view( begin, d_cur - begin );
+
+	// WKT is case insensitive, but it is mostly written in upper case
+	if ( std::any_of( keyword->begin(), keyword->end(), []( const char c ) { return ( 'a' <= c ) && ( c <= 'z' ); } ) )
+	{
+		d_value.assign( keyword->begin(), keyword->end() );
+		std::transform( d_value.begin(), d_value.end(), d_value.begin(),
+			[]( const char c ) { return static_cast< char >( std::toupper( static_cast< unsigned char >( c ) ) ); } );
+		*keyword = d_value;
+	}
+
+	const bool result = !keyword->empty();
+	return result;
+}
+
+bool KCsvParser::parseWktLines( const int depth )
+{
+	if ( depth == 1 )
+		return parseWktLine();
+
+	if ( !skipChar( '(' ) )
+		return false;
+
+	do
+	{
+		if ( !parseWktLines( depth - 1 ) )
+			return false;
+	}
+	while ( skipChar( ',' ) );
+
+	const bool result = skipChar( ')' );
+	return result;
+}
+
+// positions are separated by commas, ordinates by whitespaces
+bool KCsvParser::parseWktLine()
+{
+	if ( !skipChar( '(' ) )
+		return false;
+
+	std::string_view text;
+	do
+	{
+		double x = 0.0;
+		double y = 0.0;
+		if ( !parseNumber( &x, &text ) || !parseNumber( &y, &text ) )
+			return false;
+
+		double ordinate = 0.0;
+		skipWhitespaces();
+		while ( ( peek() != ',' ) && ( peek() != ')' ) )
+		{
+			if ( !parseNumber( &ordinate, &text ) )
+				return false;
+			skipWhitespaces();
+		}
+
+		d_geometry.addPosition( x, y );
+	}
+	while ( skipChar( ',' ) );
+
+	if ( !skipChar( ')' ) )
+		return false;
+
+	d_geometry.endLine();
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+template < typename TParser >
+SParsedChunk parseLines(
+	const SParserContext& context,
+	const std::string& text )
+{
+	SParsedChunk result;
+	TParser parser( context, &result );
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+	while ( begin != end )
+	{
+		const char* lineEnd = std::find( begin, end, '\n' );
+		parser.parseLine( begin, lineEnd );
+		begin = ( lineEnd == end ) ? end : lineEnd + 1;
+	}
+	return result;
+}
+
+SParsedChunk parseChunk(
+	const SParserContext& context,
+	const std::string& text )
+{
+	SParsedChunk result = ( context.d_options.d_format == CsvImportFormat )
+		? parseLines< KCsvParser >( context, text )
+		: parseLines< KGeoJsonParser >( context, text );
+	return result;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+
+class KMapImporter
+{
+	public:
+		explicit KMapImporter( const SImporterData& data );
+
+	public:
+		void run();
+
+	private:
+		static std::size_t calcThreadsCount( const SImportOptions& options );
+
+		bool readChunk( std::string* chunk );
+		void readFeatures( std::string* chunk );
+		void readLines( std::string* chunk );
+		void readBlock( std::string* block );
+		void skipHeader( std::string* chunk );
+		void storeChunk( const SParsedChunk& chunk );
+		void putInt( int value );
+
+	private:
+		std::istream& d_input;
+		std::ostream& d_output;
+		SImportStats& d_stats;
+		SParserContext d_context;
+		const std::size_t d_threadsCount;
+
+		// GeoJSON is split into features whatever its layout is, while CSV
+		// has a row per line; the beginning of the line cut at the end of
+		// the recent chunk is kept for the next one
+		KGeoJsonSplitter d_splitter;
+		std::string d_block;
+		std::string d_lineBegin;
+		bool d_eof;
+
+};
+
+// ----------------------------------------------------------------------------
+
+KMapImporter::KMapImporter( const SImporterData& data )
+	: d_input( *data.d_input )
+	, d_output( *data.d_output )
+	, d_stats( *data.d_stats )
+	, d_context( *data.d_options )
+	, d_threadsCount( calcThreadsCount( *data.d_options ) )
+	, d_eof( false )
+{
+}
+
+/*
+	the chunks are read sequentially and parsed in parallel, at most one
+	chunk per thread is processed at once, so the memory usage is bounded;
+	the results are stored in the order of the input
+*/
+void KMapImporter::run()
+{
+	const std::ostream::pos_type segmentsCountPos = d_output.tellp();
+	putInt( 0 );
+
+	std::string chunk;
+	if ( readChunk( &chunk ) )
+		skipHeader( &chunk );
+
+	std::deque< std::future< SParsedChunk > > parsedChunks;
+	while ( !chunk.empty() )
+	{
+		if ( parsedChunks.size() == d_threadsCount )
+		{
+			storeChunk( parsedChunks.front().get() );
+			parsedChunks.pop_front();
+		}
+
+		parsedChunks.push_back( std::async(
+			std::launch::async,
+			parseChunk,
+			std::cref( d_context ),
+			std::move( chunk ) ) );
+		chunk.clear();
+		readChunk( &chunk );
+	}
+
+	while ( !parsedChunks.empty() )
+	{
+		storeChunk( parsedChunks.front().get() );
+		parsedChunks.pop_front();
+	}
+
+	if ( d_stats.d_segmentsCount == 0 )
+	{
+		// e.g. the geometries aren't lines, the road classes aren't mapped
+		// or the CSV rows are broken into lines
+		const bool isCsv = ( d_context.d_options.d_format == CsvImportFormat );
+		throw std::runtime_error( "there are no segments to import, "
+			+ std::to_string( d_stats.d_skippedCount ) + ( isCsv ? " rows" : " features" )
+			+ " skipped (only line geometries are imported"
+			+ ( isCsv ? ", one row per line" : "" ) + ")" );
+	}
+
+	d_output.seekp( segmentsCountPos );
+	putInt( static_cast< int >( d_stats.d_segmentsCount ) );
+	d_output.seekp( 0, std::ios::end );
+	if ( !d_output )
+		throw std::runtime_error( "cannot write map file" );
+}
+
+std::size_t KMapImporter::calcThreadsCount( const SImportOptions& options )
+{
+	const std::size_t hardwareThreadsCount = std::thread::hardware_concurrency();
+	const std::size_t threadsCount = ( options.d_threadsCount != 0 )
+		? options.d_threadsCount
+		: hardwareThreadsCount;
+	const std::size_t result = std::max< std::size_t >( threadsCount, 1 );
+	return result;
+}
+
+// returns the following whole features (or rows) a line each, false at the
+// end of the input
+bool KMapImporter::readChunk( std::string* chunk )
+{
+	if ( d_context.d_options.d_format == CsvImportFormat )
+		readLines( chunk );
+	else
+		readFeatures( chunk );
+	return !chunk->empty();
+}
+
+void KMapImporter::readFeatures( std::string* chunk )
+{
+	while ( !d_eof && ( chunk->size() < ChunkSize ) )
+	{
+		readBlock( &d_block );
+		d_splitter.split( d_block.data(), d_block.data() + d_block.size(), chunk );
+		if ( MaxRecordSize < d_splitter.getPendingSize() )
+		{
+			throw std::runtime_error( "a feature is larger than "
+				+ std::to_string( MaxRecordSize >> 20 ) + " MB" );
+		}
+	}
+
+	if ( d_eof )
+		d_splitter.finish( chunk );
+}
+
+void KMapImporter::readLines( std::string* chunk )
+{
+	chunk->swap( d_lineBegin );
+	d_lineBegin.clear();
+	while ( !d_eof )
+	{
+		readBlock( &d_block );
+		chunk->append( d_block );
+		if ( d_eof )
+			break;
+
+		// a line longer than the chunk is read further
+		const std::size_t lineEnd = chunk->rfind( '\n' );
+		if ( lineEnd != std::string::npos )
+		{
+			d_lineBegin.assign( *chunk, lineEnd + 1, std::string::npos );
+			chunk->resize( lineEnd + 1 );
+			break;
+		}
+
+		if ( MaxRecordSize < chunk->size() )
+		{
+			throw std::runtime_error( "a CSV row is longer than "
+				+ std::to_string( MaxRecordSize >> 20 ) + " MB, one row per line is required" );
+		}
+	}
+}
+
+void KMapImporter::readBlock( std::string* block )
+{
+	block->resize( ChunkSize );
+	d_input.read( &( *block )[ 0 ], ChunkSize );
+	const std::size_t readCount = static_cast< std::size_t >( d_input.gcount() );
+	block->resize( readCount );
+	if ( readCount < ChunkSize )
+	{
+		if ( d_input.bad() )
+			throw std::runtime_error( "cannot read input file" );
+		d_eof = true;
+	}
+}
+
+void KMapImporter::skipHeader( std::string* chunk )
+{
+	if ( chunk->compare( 0, std::strlen( Utf8Bom ), Utf8Bom ) == 0 )
+		chunk->erase( 0, std::strlen( Utf8Bom ) );
+
+	if ( d_context.d_options.d_format == CsvImportFormat )
+	{
+		const std::size_t headerEnd = std::min( chunk->find( '\n' ), chunk->size() );
+		KCsvParser::parseHeader( chunk->data(), chunk->data() + headerEnd, &d_context );
+		chunk->erase( 0, headerEnd + 1 );
+	}
+}
+
+void KMapImporter::storeChunk( const SParsedChunk& chunk )
+{
+	// the plain map file keeps the segments count as int
+	const std::size_t maxSegmentsCount = std::numeric_limits< int >::max();
+	if ( maxSegmentsCount - d_stats.d_segmentsCount < chunk.d_segmentsCount )
+		throw std::runtime_error( "too many segments for the map file" );
+
+	d_stats.d_segmentsCount += chunk.d_segmentsCount;
+	d_stats.d_pointsCount += chunk.d_pointsCount;
+	d_stats.d_skippedCount += chunk.d_skippedCount;
+
+	const ints_t& data = chunk.d_data;
+	d_output.write( reinterpret_cast< const char* >( data.data() ), data.size() * sizeof( int ) );
+	if ( !d_output )
+		throw std::runtime_error( "cannot write map file" );
+}
+
+void KMapImporter::putInt( const int value )
+{
+	d_output.write( reinterpret_cast< const char* >( &value ), sizeof( value ) );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+
+SImportOptions::SImportOptions()
+	: d_format( GeoJsonImportFormat )
+	, d_roadClassProperty( "road_class" )
+	, d_geometryColumn( "WKT" )
+	, d_defaultRoadClass( 0 )
+	, d_scale( 1.0 )
+	, d_flipY( false )
+	, d_threadsCount( 0 )
+{
+}
+
+SImportStats::SImportStats()
+	: d_segmentsCount( 0 )
+	, d_pointsCount( 0 )
+	, d_skippedCount( 0 )
+{
+}
+
+SImporterData::SImporterData(
+	std::istream* input,
+	std::ostream* output,
+	const SImportOptions* options,
+	SImportStats* stats )
+	: d_input( input )
+	, d_output( output )
+	, d_options( options )
+	, d_stats( stats )
+{
+}
+
+void importMap( const SImporterData& data )
+{
+	KMapImporter importer( data );
+	importer.run();
+}
+
+} // namespace mt
@@ -0,0 +1,88 @@
+// author: marines marinesovitch alias Darek Slusarczyk 2012-2013, 2022
+#ifndef INC_MT_MAP_IMPORTER_H
+#define INC_MT_MAP_IMPORTER_H
+
+namespace mt
+{
+
+enum EImportFormat
+{
+	GeoJsonImportFormat,
+	CsvImportFormat
+};
+
+struct SImportOptions
+{
+	SImportOptions();
+
+	EImportFormat d_format;
+
+	// name of the feature property (GeoJSON) or of the column (CSV) which
+	// holds the road class
+	std::string d_roadClassProperty;
+
+	// name of the CSV column which holds the WKT geometry
+	std::string d_geometryColumn;
+
+	// maps the values of the road class property onto road classes, if it
+	// is empty then the property has to be a number, which is rounded and
+	// clamped to 0..be::consts::MaxRoadClassIndex
+	std::map< std::string, int, std::less<> > d_roadClasses;
+
+	// road class of the features with missing or unmapped property, -1
+	// means such features are skipped
+	int d_defaultRoadClass;
+
+	// the coordinates are multiplied by the scale and rounded to ints
+	double d_scale;
+
+	// the y axis of the map points down (as on the screen), while e.g. the
+	// latitude grows northwards
+	bool d_flipY;
+
+	// 0 means as many threads as the hardware supports
+	std::size_t d_threadsCount;
+};
+
+struct SImportStats
+{
+	SImportStats();
+
+	std::size_t d_segmentsCount;
+	std::size_t d_pointsCount;
+
+	// features (or rows) which could not be imported, e.g. because of
+	// syntax errors, unmapped road class or coordinates out of range
+	std::size_t d_skippedCount;
+};
+
+struct SImporterData
+{
+	SImporterData(
+		std::istream* input,
+		std::ostream* output,
+		const SImportOptions* options,
+		SImportStats* stats );
+
+	std::istream* d_input;
+
+	// has to be seekable, the segments count is patched at the end
+	std::ostream* d_output;
+
+	const SImportOptions* d_options;
+	SImportStats* d_stats;
+};
+
+/*
+	streams polylines from GeoJSON or CSV (with WKT geometry) into the plain
+	map file (vide beMapReader.cpp), the input is read in chunks of whole
+	features (GeoJSON of any layout) or rows (CSV, a row per line) which are
+	parsed in parallel, so the memory usage depends only on the size of the
+	largest feature, not on the size of the input; throws
+	std::runtime_error on fatal errors, e.g. a feature larger than 256 MB
+*/
+void importMap( const SImporterData& data );
+
+} // namespace mt
+
+#endif